@@ -13,6 +13,10 @@
 #include "game_define.h"
 #include "game_proto.h"
 #include "res_man.h"
+#ifdef __llvm__
+#include "got_platform.h"
+#include "tile_cache.h"
+#endif
 //===========================================================================
 extern char far *bg_pics;
 extern int warp_flag;
@@ -73,6 +77,17 @@ char *item_name[]={"Enchanted Apple","Lightning Power",
 void build_screen(unsigned int pg){
 int x,y;
 
+#ifdef __llvm__
+/* Native build: a screen built before is one copy from the tile cache. */
+{
+  const uint8_t* layer=tile_cache_layer(bg_pics,scrn.bg_color,&scrn.icon[0][0],
+                                        g_episode == 2);
+  if(layer){
+    got_platform_page_put(pg,layer);
+    return;
+  }
+}
+#endif
 xfillrectangle(0,0,320,192,pg,0);
 for(y=0;y<12;y++){
    for(x=0;x<20;x++){
@@ -143,6 +158,7 @@ build_screen(draw_page);
 
 show_objects(new_level,draw_page);
 show_enemies();
+prefetch_enemies(new_level);
 
 if(scrn.icon[thor->center_y][thor->center_x]==154) thor->dir=0;
 xdisplay_actors(&actor[MAX_ACTORS-1],draw_page);
@@ -671,6 +687,9 @@ xfput(ix,iy,PAGE2,(char far *) (bg_pics+(scrn.bg_color*262)));
 xfput(ix,iy,PAGE2,(char far *) (bg_pics+(tile*262)));
 xcopyd2d(ix,iy,ix+16,iy+16,ix,iy,PAGE2,draw_page,320,320);
 xcopyd2d(ix,iy,ix+16,iy+16,ix,iy,PAGE2,display_page,320,320);
+#ifdef __llvm__
+tile_cache_set_cell(bg_pics,scrn.bg_color,&scrn.icon[0][0],g_episode == 2,x,y,tile);
+#endif
 scrn.icon[y][x]=tile;
 remove_objects(y,x);
 }
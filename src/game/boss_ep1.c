@@ -9,6 +9,9 @@
 
 #include "game_define.h"
 #include "game_proto.h"
+#ifdef __llvm__
+#include "snapshot.h"
+#endif
 //===========================================================================
 extern char *tmp_buff;
 extern int new_level,current_level;
@@ -573,11 +576,11 @@ static char exp[]={ 61, 62, 65, 66, 69, 70, 73, 74, 77, 78,
             141,142,145,146,149,150,153,154,157,158,
             161,162,165,166,169,170,173,174,177,178};
 static char expf[60];
+static int drop_flag=0;
 
 //===========================================================================
 int boss22_movement(ACTOR *actr){    //boss - skull
 int d,f,x;
-static int drop_flag=0;
 
 if(boss_dead) return boss_dead22();
 if(actr->i1){
@@ -904,3 +907,11 @@ next_frame(actr);
 boss22_set(actr->dir,actr->x,actr->y);
 return 0;
 }
+#ifdef __llvm__
+//===========================================================================
+void boss1_snapshot(void){
+
+SNAPSHOT_VAR(expf);
+SNAPSHOT_VAR(drop_flag);
+}
+#endif
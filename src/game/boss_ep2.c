@@ -8,6 +8,9 @@
 
 #include "game_define.h"
 #include "game_proto.h"
+#ifdef __llvm__
+#include "snapshot.h"
+#endif
 void boss_set_ep2(int d,int x,int y);
 int bossa_movement_ep2(ACTOR *actr);
 int bossb_movement_ep2(ACTOR *actr);
@@ -48,12 +51,12 @@ static char exp[]={ 61, 62, 65, 66, 69, 70, 73, 74, 77, 78,
             141,142,145,146,149,150,153,154,157,158,
             161,162,165,166,169,170,173,174,177,178};
 static char expf[60];
+static int drop_flag=0;
 char num_skulls;  //hehe
 char num_spikes;
 //===========================================================================
 int boss_movement_ep2(ACTOR *actr){    //boss - skull
 int d,f,x;
-static int drop_flag=0;
 
 switch(setup.skill){
    case 0:
@@ -417,3 +420,13 @@ next_frame(actr);
 boss_set_ep2(actr->dir,actr->x,actr->y);
 return 0;
 }
+#ifdef __llvm__
+//===========================================================================
+void boss2_snapshot(void){
+
+SNAPSHOT_VAR(expf);
+SNAPSHOT_VAR(drop_flag);
+SNAPSHOT_VAR(num_skulls);
+SNAPSHOT_VAR(num_spikes);
+}
+#endif
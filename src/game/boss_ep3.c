@@ -8,6 +8,9 @@
 
 #include "game_define.h"
 #include "game_proto.h"
+#ifdef __llvm__
+#include "snapshot.h"
+#endif
 
 void check_boss_hit_ep3(void);
 void boss_change_mode(void);
@@ -622,3 +625,16 @@ if(endgame>8){
 }
 return 1;
 }
+#ifdef __llvm__
+//===========================================================================
+void boss3_snapshot(void){
+
+SNAPSHOT_VAR(boss_mode);
+SNAPSHOT_VAR(num_pods);
+SNAPSHOT_VAR(num_pods1);
+SNAPSHOT_VAR(pod_speed);
+SNAPSHOT_VAR(expf);
+SNAPSHOT_VAR(exprow);
+SNAPSHOT_VAR(expcnt);
+}
+#endif
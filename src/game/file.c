@@ -15,6 +15,9 @@
 #include "res_man.h"
 #include "game_define.h"
 #include "game_proto.h"
+#ifdef __llvm__
+#include "tile_cache.h"
+#endif
 //============================================================================
 extern char far *bg_pics;
 extern char far objects[NUM_OBJECTS][262];
@@ -41,6 +44,8 @@ extern unsigned int display_page,draw_page;
 extern volatile char key_flag[100];
 extern int game_is_over;
 /* object_names accessed via ep->object_names */
+
+static char bg_pics_borrowed;   /* bg_pics points into the mapped GOTRES.DAT */
 //===========================================================================
 long file_size(char *path){
 long tmpl;
@@ -54,6 +59,19 @@ fclose(tmp_fp);
 return tmpl;
 }
 //===========================================================================
+/* Loads a resource the game modifies or keeps in a fixed array. Compressed
+   entries decode straight from the mapped archive into buff; stored ones
+   are copied once from the mapping. */
+static int load_private(char *name,char far *buff){
+const char far *p;
+long len;
+
+len=res_view(name,buff,&p);
+if(len<0) return 0;
+if(p!=buff) _fmemcpy(buff,p,(size_t)len);
+return 1;
+}
+//===========================================================================
 int load_bg_data(void){
 char s[21];
 char str[21];
@@ -68,12 +86,31 @@ if(g_episode==1){
   strcat(s,str);
 }
 
+free_bg_data();
+
+/* Tiles are only ever read: borrow them from the archive when it is mapped
+   and they are stored uncompressed. */
+if(res_view(s,(char far *)0,(const char far **)&bg_pics)>=0){
+  bg_pics_borrowed=1;
+  return 1;
+}
 bg_pics=farmalloc(60460l);
 if(!bg_pics) return 0;
 if(res_read(s,bg_pics)<0) return 0;
 return 1;
 }
 //===========================================================================
+void free_bg_data(void){
+
+#ifdef __llvm__
+/* The cached tile layers were drawn from this tile set. */
+tile_cache_flush();
+#endif
+if(bg_pics && !bg_pics_borrowed) farfree(bg_pics);
+bg_pics=(char far *) 0;
+bg_pics_borrowed=0;
+}
+//===========================================================================
 int load_sd_data(void){
 char s[21];
 char str[21];
@@ -84,14 +121,12 @@ strcat(s,str);
 
 if(!sd_data) sd_data=farmalloc(61440l);
 if(!sd_data) return 0;
-if(res_read(s,sd_data)<0) return 0;
-return 1;
+return load_private(s,sd_data);
 }
 //===========================================================================
 int load_objects(void){
 
-if(res_read("OBJECTS",(char far *)objects)<0) return 0;
-return 1;
+return load_private("OBJECTS",(char far *)objects);
 }
 //===========================================================================
 int load_actor(int file,int num){
@@ -101,11 +136,43 @@ char rs[21];
 itoa(num,s,10);
 strcpy(rs,"ACTOR");
 strcat(rs,s);
-if(res_read(rs,tmp_buff)<0) return 0;
-file=file;
+if(file==1){
+  //enemies: usually decoded already by prefetch_enemies()
+  if(res_prefetch_read(rs,tmp_buff)<0) return 0;
+}
+else if(res_read(rs,tmp_buff)<0) return 0;
 return 1;
 }
 //===========================================================================
+/* Starts decoding, in the background, the enemies of the screens Thor can
+   walk to from this one, so load_enemy() finds them ready. */
+void prefetch_enemies(int level){
+static int step[4]={-1,1,-10,10};
+char names[4*LEVEL_MAX_ACTOR][10];
+const char *list[4*LEVEL_MAX_ACTOR];
+char s[21];
+LEVEL far *lvl;
+int i,j,n,type,count;
+
+if(!sd_data) return;
+count=0;
+for(i=0;i<4;i++){
+   n=level+step[i];
+   if(n<0 || n>=120) continue;
+   lvl=(LEVEL far *) (sd_data+(n*512));
+   for(j=0;j<LEVEL_MAX_ACTOR;j++){
+      type=(unsigned char) lvl->actor_type[j];
+      if(!type) continue;
+      itoa(type,s,10);
+      strcpy(names[count],"ACTOR");
+      strcat(names[count],s);
+      list[count]=names[count];
+      count++;
+   }
+}
+res_prefetch(list,count);
+}
+//===========================================================================
 int load_speech(int index){
 int  cnt;
 char tmps[30];
@@ -66,6 +66,13 @@ void thor_spins(int flag);
 void got_pause(int delay);
 void rotate_pal(void);
 int  rnd(int max);
+#ifdef __llvm__
+void replay_start(void);
+int  game_rand(void);
+void game_srand(unsigned seed);
+#define rand()   game_rand()
+#define srand(s) game_srand(s)
+#endif
 
 /* G_GRP.C */
 void xprint(int x,int y,char *string,unsigned int page,int color);
@@ -106,9 +113,11 @@ long file_size(char *path);
 unsigned int read_file(char *filename,char far *buff,
               long offset, unsigned int amount,int key);
 int  load_bg_data(void);
+void free_bg_data(void);
 int  load_sd_data(void);
 int  load_objects(void);
 int  load_actor(int file,int num);
+void prefetch_enemies(int level);
 int  load_picture(int index,char *buff);
 void setup_filenames(int level);
 int  load_speech(int index);
@@ -242,6 +251,18 @@ int  music_is_on(void);
 
 /* G_SCRIPT.C */
 void execute_script(long index,char *pic);
+void script_run_text(void);
+void script_report(int err_num,int line_num);
+long scr_effect(int cmd,long a,long b,long c);
+int  scr_ask(char **op,char *title,int ipos);
+
+/* SCRIPT_VM.C */
+void script_run_compiled(void);
+int  script_trace_step(void);
+long script_trace_effect(int cmd,long a,long b,long c);
+int  script_trace_ask(char **op,char *title,int ipos);
+void script_trace_error(int err_num,int line_num);
+int  script_check_run(void);
 
 /* Boss functions - Episode 1 (defined in boss_ep1.c) */
 int  boss1_movement(ACTOR *actr);
@@ -8,6 +8,9 @@
 
 #include "game_define.h"
 #include "game_proto.h"
+#ifdef __llvm__
+#include "sprite_atlas.h"
+#endif
 //===========================================================================
 extern char pge;
 extern unsigned int draw_page,display_page,page3_offset;
@@ -55,49 +58,18 @@ unsigned int make_mask(MASK_IMAGE * new_image,
                       unsigned int page_start, char *Image, int image_width,
                       int image_height){
 #ifdef __llvm__
-/* Native build:
-   - Store sprite pixels as a 4-plane Mode X planar blob (same layout as xput),
-     but keep it in heap memory.
-   - Ignore the original per-alignment mask generation and display-memory
-     offsets. Actor drawing uses 0/15 as transparent. */
+/* Native build: every frame is a 16x16 actor frame. Point all four
+   alignments at its sprite atlas entry (chunky pixels plus opaque runs;
+   0/15 are transparent), added on first use. Nothing is allocated per
+   load and display-memory offsets are ignored. */
   ALIGNED_MASK_IMAGE* ami;
-  uint8_t* planes;
-  int wbytes;
-  int plane_sz;
-  int p, row, bx;
+  SpriteFrame* f;
 
   (void)page_start;
-  wbytes = (image_width + 3) / 4;
-  plane_sz = wbytes * image_height;
-
-  ami = (ALIGNED_MASK_IMAGE*)malloc(sizeof(ALIGNED_MASK_IMAGE));
-  if (!ami) {
-    return 0;
-  }
-
-  planes = (uint8_t*)malloc((size_t)plane_sz * 4);
-  if (!planes) {
-    free(ami);
-    return 0;
-  }
-
-  /* Convert chunky (row-major) -> planar blocks */
-  for (p = 0; p < 4; p++) {
-    for (row = 0; row < image_height; row++) {
-      for (bx = 0; bx < wbytes; bx++) {
-        int px = bx * 4 + p;
-        uint8_t v = 0;
-        if (px < image_width) {
-          v = (uint8_t)Image[row * image_width + px];
-        }
-        planes[p * plane_sz + row * wbytes + bx] = v;
-      }
-    }
-  }
-
-  ami->image_width = image_width;
-  ami->image_ptr = 0;
-  ami->mask_ptr = (char far*)planes; /* repurposed: points at planar pixels */
+  (void)image_width;
+  (void)image_height;
+  f = sprite_atlas_add((const uint8_t*)Image);
+  ami = f ? (ALIGNED_MASK_IMAGE*)&f->mask : (ALIGNED_MASK_IMAGE*)0;
 
   new_image->alignments[0] = ami;
   new_image->alignments[1] = ami;
@@ -13,6 +13,11 @@
 #include "res_man.h"
 #include "game_define.h"
 #include "game_proto.h"
+#ifdef __llvm__
+#include "got_replay.h"
+#include "snapshot.h"
+#include "sprite_atlas.h"
+#endif
 
 /* DEMO_LEN is now a runtime value (ep->demo_len), but the demo_key array
    needs a fixed compile-time size.  Use the maximum across all episodes. */
@@ -82,6 +87,7 @@ extern int load_game_flag;
 extern int music_flag,sound_flag,pcsound_flag;
 extern long pcsound_length[NUM_SOUNDS];
 extern int  demo_cnt;
+extern int rand1,rand2;
 extern char demo,record;
 extern char demo_enable;
 extern int exit_flag;
@@ -204,6 +210,11 @@ ami_buff=(char *) abuff;
 
 res_init(lzss_buff);
 if(res_open("GOTRES.DAT")<0) return 1;
+#ifdef __llvm__
+/* Decode every actor frame once up front; make_mask() then only looks
+   them up. */
+sprite_atlas_build();
+#endif
 
 if(res_read("RANDOM",(char far*)rnd_array)<0) return 15;
 if(res_read("DEMO",(char far*)demo_key)<0) return 16;
@@ -288,7 +299,7 @@ got_platform_video_shutdown();
 setvect(0x09,old_keyboard_int);
 #endif
 if(lzss_buff) farfree(lzss_buff);
-if(bg_pics) farfree(bg_pics);
+free_bg_data();
 if(sd_data) farfree(sd_data);
 if(mask_buff_start) farfree(mask_buff_start);
 if(tmp_buff) free(tmp_buff);
@@ -352,9 +363,57 @@ outportb(0x20,0x20);
 #endif
 }
 //===========================================================================
+#ifdef __llvm__
+static uint32_t hash_bytes(uint32_t h,const void *p,unsigned len){
+const unsigned char *b=(const unsigned char *)p;
+
+while(len--) h=(h^*b++)*16777619u;
+return h;
+}
+//===========================================================================
+/* Replay checkpoints: what the player could see go differently. Pointers
+   (object_name) would differ between runs, so THOR_INFO goes field by
+   field. */
+static uint32_t replay_state_hash(void){
+uint32_t h=2166136261u;
+int i,v[16];
+
+v[0]=current_level;
+v[1]=thor_info.magic;
+v[2]=thor_info.keys;
+v[3]=thor_info.jewels;
+v[4]=thor_info.inventory;
+v[5]=thor_info.item;
+v[6]=thor_info.level;
+v[7]=(int)thor_info.score;
+v[8]=thor_info.object;
+v[9]=thor_info.armor;
+v[10]=rand1;
+v[11]=rand2;
+h=hash_bytes(h,v,12*sizeof(int));
+for(i=0;i<MAX_ACTORS;i++){
+   if(!actor[i].used) continue;
+   v[0]=i;
+   v[1]=actor[i].x;
+   v[2]=actor[i].y;
+   v[3]=actor[i].dir;
+   v[4]=actor[i].health;
+   h=hash_bytes(h,v,5*sizeof(int));
+}
+return hash_bytes(h,&setup,sizeof(SETUP));
+}
+#endif
+//===========================================================================
 void demo_key_set(void){
 char sc,flag;
 
+#ifdef __llvm__
+if(got_replay_mode()){
+  snapshot_check_frame();
+  got_replay_frame(replay_state_hash());
+  return;
+}
+#endif
 if(demo_key[demo_cnt]){
   sc=demo_key[demo_cnt];
   if(sc & 0x80) flag=0;
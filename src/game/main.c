@@ -17,6 +17,9 @@
 #include "game_proto.h"
 
 #ifdef __llvm__
+#include "got_replay.h"
+#include "rewind.h"
+
 /* Build the original DOS entrypoint under a different name so we can provide
    our own native `main()` (raylib). */
 #define main got_game_main
@@ -310,10 +313,22 @@ if(demo || record){
   story_flag=0;
 }
 
+#ifdef __llvm__
+/* Replays start at their level with no story and no saved game. */
+if(got_replay_mode()){
+  if(got_replay_mode()==GOT_REPLAY_PLAY)
+    current_level=got_replay_start_info()->start_level;
+  story_flag=0;
+  auto_load=0;
+}
+#endif
 if(current_level!=START_LEVEL) story_flag=0;
 
 err=initialize();
 if(err) exit_code(err);
+#ifdef __llvm__
+replay_start();
+#endif
 
 if(rdemo){
   fp=fopen("demo.got","rb");
@@ -402,10 +417,22 @@ if(record) memset(demo_key,0,DEMO_LEN);
 
 //------------------------------------------------------------------------
 
+#ifdef __llvm__
+srand(got_replay_mode() ? got_replay_start_info()->seed : 1234);
+#else
 srand(1234);
+#endif
+#ifdef __llvm__
+rewind_reset();
+#endif
 main_loop=1;
 while(1){
+#ifdef __llvm__
+  if(!demo && !record) rewind_frame();
+  if(demo || record || got_replay_mode()) demo_key_set();
+#else
   if(demo || record) demo_key_set();
+#endif
   demo_cnt++;
   if(record){
       itoa(demo_cnt,s,10);
@@ -673,7 +700,13 @@ if(cheat){
     if(demo_cnt>=(DEMO_LEN-1)) break;
     if(exit_flag==5) break;
   }
+#ifdef __llvm__
+  if(got_replay_done()) break;
+#endif
 }
+#ifdef __llvm__
+got_replay_finish();
+#endif
 if(record){
  fp=fopen("demo.got","wb");
  if(fp){
@@ -683,6 +716,9 @@ if(record){
 }
 if(ret && !fast_exit && !demo && !record){
   d_restore();
+#ifdef __llvm__
+  if(got_replay_mode()!=GOT_REPLAY_PLAY)
+#endif
   save_game();
 }
 music_pause();
@@ -711,6 +747,48 @@ exit_code(0);
 #endif
 	}
 extern int SBResetCount;
+#ifdef __llvm__
+//===========================================================================
+/* Playback takes the recorded settings; recording notes them. Either way
+   the replay starts here, just after initialize(). */
+void replay_start(void){
+GOT_REPLAY_START rs;
+const GOT_REPLAY_START *p;
+
+if(got_replay_mode()==GOT_REPLAY_PLAY){
+  p=got_replay_start_info();
+  setup.skill=p->skill;
+  setup.scroll_flag=p->scroll;
+  cheat=p->cheat;
+  key_up=p->keys[0];
+  key_down=p->keys[1];
+  key_left=p->keys[2];
+  key_right=p->keys[3];
+  key_fire=p->keys[4];
+  key_magic=p->keys[5];
+  key_select=p->keys[6];
+  got_replay_begin(NULL);
+}
+else if(got_replay_mode()==GOT_REPLAY_RECORD){
+  memset(&rs,0,sizeof(rs));
+  rs.episode=g_episode;
+  rs.start_level=current_level;
+  rs.skill=setup.skill;
+  rs.scroll=setup.scroll_flag;
+  rs.cheat=cheat;
+  rs.keys[0]=key_up;
+  rs.keys[1]=key_down;
+  rs.keys[2]=key_left;
+  rs.keys[3]=key_right;
+  rs.keys[4]=key_fire;
+  rs.keys[5]=key_magic;
+  rs.keys[6]=key_select;
+  rs.seed=1234;
+  rs.checkpoint_frames=70;
+  got_replay_begin(&rs);
+}
+}
+#endif
 //===========================================================================
 void run_gotm(void){
 #ifdef __llvm__
@@ -980,3 +1058,22 @@ if(demo || rdemo || record){
 }
 return rand() % max;
 }
+#ifdef __llvm__
+//===========================================================================
+/* rand()/srand() for the game (game_proto.h maps them here). The C
+   library's generator differs from platform to platform and its state
+   can't be saved, so replays and savestates couldn't repeat it. This is
+   the ANSI C example generator: 15-bit results, like the DOS compiler's. */
+uint32_t game_rand_seed=1;
+
+int game_rand(void){
+
+game_rand_seed=game_rand_seed*1103515245u+12345u;
+return (int) ((game_rand_seed >> 16) & 0x7fff);
+}
+//===========================================================================
+void game_srand(unsigned seed){
+
+game_rand_seed=seed;
+}
+#endif
@@ -8,6 +8,9 @@
 
 #include "game_define.h"
 #include "game_proto.h"
+#ifdef __llvm__
+#include "snapshot.h"
+#endif
 
 #define HERMIT_HAS_DOLL setup.f04
 //===========================================================================
@@ -41,6 +44,7 @@ int  pixel_x[8][25];
 int  pixel_y[8][25];
 char pixel_p[8][25];
 char pixel_c[8];
+static int braapp_flag=0;      //use_item(): BRAAPP played for this press
 void throw_lightning(void);
 void not_enough_magic(void);
 void cannot_carry_more(void);
@@ -458,7 +462,6 @@ return 1;
 }
 //===========================================================================
 void use_item(void){
-static int flag=0;
 int kf,ret,mf;
 
 kf=key_flag[key_magic];
@@ -494,12 +497,12 @@ switch(thor_info.item){
 
 }
 if(kf){
-  if((!ret) && (!flag)){
+  if((!ret) && (!braapp_flag)){
     if(mf) play_sound(BRAAPP,0);
-    flag=1;
+    braapp_flag=1;
   }
 }
-else flag=0;
+else braapp_flag=0;
 }
 //===========================================================================
 void place_pixel(int dir,int num){
@@ -654,3 +657,14 @@ thor_info.inventory&=0xbf;
 thor_info.item=1;
 display_item();
 }
+#ifdef __llvm__
+//===========================================================================
+void object_snapshot(void){
+
+SNAPSHOT_VAR(pixel_x);
+SNAPSHOT_VAR(pixel_y);
+SNAPSHOT_VAR(pixel_p);
+SNAPSHOT_VAR(pixel_c);
+SNAPSHOT_VAR(braapp_flag);
+}
+#endif
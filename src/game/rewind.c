@@ -0,0 +1,443 @@
+//Source code released to the public domain on March 27th, 2020.
+//
+// Rewind.
+//
+// Each main loop frame is saved as a snapshot (snapshot.c) and kept in a
+// ring as a delta against the last keyframe: the snapshot XORed with the
+// keyframe, 8 bytes at a time, written as runs of unchanged words and
+// runs of changed ones. A run pair is two varints (words unchanged, words
+// changed) followed by the changed words XORed; words after the last pair
+// are unchanged. A keyframe is the same thing against zeros, which drops
+// the empty parts of the pages and tables. A new keyframe starts every
+// rw_keyframe frames, or sooner when a delta would take more than half a
+// snapshot.
+//
+// The ring is one byte arena of the budget's size, filled front to back
+// and wrapped, with an index of entries by sequence number. Making room
+// drops the oldest entries; a delta whose keyframe went goes with it, so
+// the oldest entry is always a keyframe. Stepping back drops the newest
+// entry and decodes the one before it: its keyframe (kept decoded in
+// rw_base while it is the one in use) plus its delta.
+
+//=========================== Include Files ===============================
+#include <stdlib.h>
+#include <stdio.h>
+#include <dos.h>
+#include <string.h>
+
+#include "game_define.h"
+#include "game_proto.h"
+#include "rewind.h"
+#include "snapshot.h"
+#include "got_clock.h"
+#include "got_platform.h"
+#include "got_replay.h"
+//============================ Externals ==================================
+extern volatile char key_flag[100];
+extern volatile char joy_flag[100];
+extern volatile char tmp_flag[100];
+//============================= Globals ==================================
+#define RW_BUDGET   (32l*1024*1024)
+#define RW_KEYFRAME 70
+
+typedef struct{
+  long off,len;                       //in rw_arena
+  long key;                           //sequence number of its keyframe
+} RW_ENTRY;
+
+static long  rw_budget=RW_BUDGET;
+static int   rw_keyframe=RW_KEYFRAME;
+static int   rw_ready;                //arena and index match the settings
+static char *rw_arena;
+static long  rw_tail;                 //where the next entry goes
+static RW_ENTRY *rw_ent;              //rw_cap entries, by sequence % rw_cap
+static long  rw_cap;
+static long  rw_first,rw_count;       //oldest sequence number, entries held
+
+static long  rw_size;                 //snapshot bytes, rounded up to 8
+static char *rw_cur;                  //this frame's snapshot
+static char *rw_base;                 //the decoded keyframe rw_base_seq
+static long  rw_base_seq;
+static unsigned char *rw_out;         //encoder output
+static long  rw_out_cap;
+
+/* --check-rewind */
+static int   chk_every;
+static long  chk_since;               //frames stored since the last jump
+static long  chk_pending;             //frames until the jump point, -1 = none
+static char *chk_tmp;                 //this frame's snapshot, to compare
+static char *chk_end;                 //the state at the jump point
+static GOT_REPLAY_MARK *chk_marks;    //by sequence % rw_cap
+static long  chk_frames,chk_keys,chk_jumps;
+static double chk_bytes,chk_key_bytes,chk_store_s,chk_step_s;
+//=========================================================================
+static unsigned char *put_varint(unsigned char *p,unsigned long v){
+
+while(v>=0x80){
+  *p++=(unsigned char) (v | 0x80);
+  v>>=7;
+}
+*p++=(unsigned char) v;
+return p;
+}
+//=========================================================================
+static const unsigned char *get_varint(const unsigned char *p,unsigned long *v){
+int shift=0;
+
+*v=0;
+do{
+  *v|=(unsigned long) (*p & 0x7f)<<shift;
+  shift+=7;
+} while(*p++ & 0x80);
+return p;
+}
+//=========================================================================
+/* cur against base (NULL = zeros) into rw_out; the length, or -1 if it
+   takes more than cap bytes. */
+static long encode(const char *cur,const char *base,long cap){
+const uint64_t *c,*b;
+unsigned char *p,*end;
+long words,i,z,l;
+uint64_t w;
+
+c=(const uint64_t *) cur;
+b=(const uint64_t *) base;
+words=rw_size/8;
+p=rw_out;
+end=rw_out+cap;
+i=0;
+while(i<words){
+  z=i;
+  if(b) while(i<words && c[i]==b[i]) i++;
+  else while(i<words && !c[i]) i++;
+  if(i==words) break;
+  l=i;
+  if(b) while(i<words && c[i]!=b[i]) i++;
+  else while(i<words && c[i]) i++;
+  if(end-p<20+(i-l)*8) return -1;
+  p=put_varint(p,(unsigned long) (l-z));
+  p=put_varint(p,(unsigned long) (i-l));
+  for(;l<i;l++){
+    w=b ? c[l]^b[l] : c[l];
+    memcpy(p,&w,8);
+    p+=8;
+  }
+}
+return (long) (p-rw_out);
+}
+//=========================================================================
+/* XORs an encoded entry into dst. */
+static void decode(char *dst,const unsigned char *p,long len){
+const unsigned char *end;
+uint64_t *d,w;
+unsigned long z,l;
+
+d=(uint64_t *) dst;
+end=p+len;
+while(p<end){
+  p=get_varint(p,&z);
+  p=get_varint(p,&l);
+  d+=z;
+  for(;l>0;l--,p+=8){
+    memcpy(&w,p,8);
+    *d++^=w;
+  }
+}
+}
+//=========================================================================
+#define RW_AT(seq) (&rw_ent[(seq)%rw_cap])
+
+static void drop_oldest(void){
+
+rw_first++;
+rw_count--;
+while(rw_count && RW_AT(rw_first)->key!=rw_first){   //orphaned deltas
+  rw_first++;
+  rw_count--;
+}
+if(!rw_count) rw_tail=0;
+}
+//=========================================================================
+/* Whether [pos, pos+len) misses every stored entry; pos is rw_tail, or 0
+   once nothing lies past the tail. */
+static int arena_free(long pos,long len){
+long head;
+
+if(!rw_count) return 1;
+head=RW_AT(rw_first)->off;
+if(head<rw_tail) return pos>=rw_tail || pos+len<=head;
+return pos+len<=head;                                 //wrapped
+}
+//=========================================================================
+/* Stores rw_out as the next entry; 0 if it can't be (too big, or a delta
+   whose keyframe had to go to make room). */
+static int put_entry(long len,int key){
+RW_ENTRY *e;
+long pos,seq;
+
+if(len>rw_budget) return 0;
+pos=rw_tail;
+if(pos+len>rw_budget){
+  //wrapping: any entries past the tail are the oldest, so they go
+  //first; the ones at the front go only as far as this entry needs
+  while(rw_count && RW_AT(rw_first)->off>=rw_tail) drop_oldest();
+  pos=0;
+}
+while(!arena_free(pos,len) || rw_count==rw_cap) drop_oldest();
+seq=rw_first+rw_count;
+if(!key && (rw_base_seq<rw_first || rw_base_seq>=seq)) return 0;
+e=RW_AT(seq);
+e->off=pos;
+e->len=len;
+e->key=key ? seq : rw_base_seq;
+memcpy(rw_arena+pos,rw_out,len);
+rw_tail=pos+len;
+rw_count++;
+if(key){
+  memcpy(rw_base,rw_cur,rw_size);
+  rw_base_seq=seq;
+}
+return 1;
+}
+//=========================================================================
+void rewind_reset(void){
+
+rw_first=0;
+rw_count=0;
+rw_tail=0;
+rw_base_seq=-1;
+}
+//=========================================================================
+void rewind_config(long budget,int keyframe_frames){
+
+if(budget>=0) rw_budget=budget;
+if(keyframe_frames>0) rw_keyframe=keyframe_frames;
+rw_ready=0;
+}
+//=========================================================================
+static void rewind_free(void){
+
+free(rw_arena);
+free(rw_ent);
+free(rw_cur);
+free(rw_base);
+free(rw_out);
+free(chk_tmp);
+free(chk_end);
+free(chk_marks);
+rw_arena=NULL;
+rw_ent=NULL;
+rw_cur=rw_base=NULL;
+rw_out=NULL;
+chk_tmp=chk_end=NULL;
+chk_marks=NULL;
+rw_size=0;
+rewind_reset();
+}
+//=========================================================================
+/* Arena and index for the budget, buffers for snapshots of size bytes. */
+static int rewind_alloc(long size){
+int ok;
+
+size=(size+7) & ~7l;
+if(rw_ready && size==rw_size) return 1;
+if(!rw_ready){
+  rewind_free();
+  rw_cap=rw_budget/1024;
+  if(rw_cap<256) rw_cap=256;
+  rw_arena=(char *) malloc(rw_budget);
+  rw_ent=(RW_ENTRY *) malloc(rw_cap*sizeof(RW_ENTRY));
+  if(chk_every) chk_marks=(GOT_REPLAY_MARK *) malloc(rw_cap*sizeof(GOT_REPLAY_MARK));
+  rw_ready=1;
+}
+free(rw_cur);
+free(rw_base);
+free(rw_out);
+rw_size=size;
+rw_out_cap=size+size/2+64;
+rw_cur=(char *) calloc(1,size);
+rw_base=(char *) calloc(1,size);
+rw_out=(unsigned char *) malloc(rw_out_cap);
+ok=rw_arena && rw_ent && rw_cur && rw_base && rw_out;
+if(chk_every){
+  free(chk_tmp);
+  free(chk_end);
+  chk_tmp=(char *) malloc(size);
+  chk_end=(char *) malloc(size);
+  chk_pending=-1;
+  chk_since=0;
+  ok=ok && chk_marks && chk_tmp && chk_end;
+}
+rewind_reset();
+if(!ok){
+  rewind_free();
+  rw_budget=0;
+  if(chk_every) got_replay_fail("rewind: out of memory");
+}
+return ok;
+}
+//=========================================================================
+/* Snapshots this frame into the ring. */
+static int rewind_store(void){
+long len,next;
+int key;
+
+if(!snapshot_save(rw_cur,rw_size)) return 0;
+next=rw_first+rw_count;
+key=!rw_count || rw_base_seq<rw_first || next-rw_base_seq>=rw_keyframe;
+if(!key){
+  len=encode(rw_cur,rw_base,rw_size/2);
+  if(len>=0 && put_entry(len,0)) return 1;
+}
+len=encode(rw_cur,NULL,rw_out_cap);
+if(len>=0 && put_entry(len,1)) return 1;
+rewind_reset();
+return 0;
+}
+//=========================================================================
+/* Decodes entry seq into rw_cur. */
+static void rewind_decode(long seq){
+RW_ENTRY *e,*k;
+
+e=RW_AT(seq);
+if(rw_base_seq!=e->key){
+  k=RW_AT(e->key);
+  memset(rw_base,0,rw_size);
+  decode(rw_base,(const unsigned char *) rw_arena+k->off,k->len);
+  rw_base_seq=e->key;
+}
+memcpy(rw_cur,rw_base,rw_size);
+if(e->key!=seq) decode(rw_cur,(const unsigned char *) rw_arena+e->off,e->len);
+}
+//=========================================================================
+/* Restores the newest entry, dropping it first when drop is set. The
+   input arrays keep their live state unless keep_input is 0. 0 if the
+   entry is from another episode or area (the ring is emptied). */
+static int rewind_step(int drop,int keep_input){
+char keys[100],joy[100],tmp[100];
+RW_ENTRY *e;
+long seq;
+int ok;
+
+if(drop) rw_count--;
+seq=rw_first+rw_count-1;
+e=RW_AT(seq);
+rw_tail=e->off+e->len;
+rewind_decode(seq);
+memcpy(keys,(const void *) key_flag,sizeof(keys));
+memcpy(joy,(const void *) joy_flag,sizeof(joy));
+memcpy(tmp,(const void *) tmp_flag,sizeof(tmp));
+ok=snapshot_restore(rw_cur,rw_size)==0;
+if(keep_input){
+  memcpy((void *) key_flag,keys,sizeof(keys));
+  memcpy((void *) joy_flag,joy,sizeof(joy));
+  memcpy((void *) tmp_flag,tmp,sizeof(tmp));
+}
+if(!ok) rewind_reset();
+return ok;
+}
+//=========================================================================
+/* Held: the frame before this one first, then one further back per 70Hz
+   frame, staying on the oldest, until let go. */
+static void rewind_hold(void){
+int first=1;
+
+while(got_platform_rewind_held() && !key_flag[ESC]){
+  if(first || rw_count>1){
+    if(!rewind_step(!first,1)) return;
+  }
+  first=0;
+  got_platform_show_paced();
+}
+}
+//=========================================================================
+// got --replay FILE --check-rewind N
+//=========================================================================
+static void check_report(void){
+
+if(!chk_every || !chk_frames) return;
+printf("rewind: %ld frames stored, %ld keyframes of %.0f bytes, deltas %.0f bytes\n",
+       chk_frames,chk_keys,chk_keys ? chk_key_bytes/chk_keys : 0.0,
+       chk_frames>chk_keys ? (chk_bytes-chk_key_bytes)/(chk_frames-chk_keys) : 0.0);
+printf("rewind: %ld frames held in %ld KB, store %.1f us, step back %.1f us\n",
+       rw_count,rw_budget/1024,chk_store_s*1e6/chk_frames,
+       chk_jumps ? chk_step_s*1e6/chk_jumps : 0.0);
+printf("rewind: %ld jumps back played again\n",chk_jumps);
+}
+//=========================================================================
+void rewind_check_every(int frames){
+
+if(frames<2) return;
+chk_every=frames;
+chk_pending=-1;
+rw_ready=0;
+atexit(check_report);
+}
+//=========================================================================
+/* After storing a frame: it must decode to the snapshot it came from,
+   and a stretch played again must end where it did the first time. */
+static void check_frame(void){
+RW_ENTRY *e;
+long seq,back;
+double t;
+
+seq=rw_first+rw_count-1;
+e=RW_AT(seq);
+chk_frames++;
+chk_bytes+=e->len;
+if(e->key==seq){
+  chk_keys++;
+  chk_key_bytes+=e->len;
+}
+got_replay_mark(&chk_marks[seq%rw_cap]);
+
+memcpy(chk_tmp,rw_cur,rw_size);
+rw_base_seq=-1;                       //decode its keyframe too
+rewind_decode(seq);
+if(memcmp(chk_tmp,rw_cur,rw_size)){
+  got_replay_fail("rewind: a stored frame decodes differently");
+  return;
+}
+if(chk_pending>0 && --chk_pending==0){
+  if(memcmp(chk_end,rw_cur,rw_size)){
+    got_replay_fail("rewind: state after stepping back differs");
+    return;
+  }
+  chk_pending=-1;
+}
+chk_since++;
+back=chk_every/2;
+if(chk_pending<0 && chk_since>=chk_every && rw_count>back){
+  memcpy(chk_end,rw_cur,rw_size);
+  t=got_clock_wall_s();
+  rw_count-=back-1;
+  if(!rewind_step(1,0)){
+    got_replay_fail("rewind: restore refused");
+    return;
+  }
+  chk_step_s+=got_clock_wall_s()-t;
+  chk_jumps++;
+  got_replay_seek(&chk_marks[(rw_first+rw_count-1)%rw_cap]);
+  chk_pending=back;
+  chk_since=0;
+}
+}
+//=========================================================================
+void rewind_frame(void){
+double t;
+
+if(!rw_budget) return;
+if(chk_every){
+  if(got_replay_mode()!=GOT_REPLAY_PLAY || got_replay_done()) return;
+}
+else if(got_replay_mode()!=GOT_REPLAY_OFF) return;
+if(!rewind_alloc(snapshot_size())) return;
+if(!chk_every && rw_count && got_platform_rewind_held()){
+  rewind_hold();
+  return;
+}
+t=got_clock_wall_s();
+if(!rewind_store()) return;
+chk_store_s+=got_clock_wall_s()-t;
+if(chk_every) check_frame();
+}
@@ -0,0 +1,37 @@
+/* rewind.h - Hold-to-rewind for God of Thunder (native build)
+ *
+ * Every main loop frame goes into a ring of snapshots (snapshot.h) kept
+ * as deltas: every keyframe_frames frames a keyframe, and in between each
+ * frame XORed against the last keyframe, with the runs of unchanged bytes
+ * squeezed out. A frame then costs what changed since the keyframe, and
+ * any frame decodes from two entries. When the memory budget is used up
+ * the oldest frames go first, a keyframe and its deltas together.
+ *
+ * While the rewind button is held (got_platform_rewind_held()) the game
+ * stops at the top of the main loop and steps back one frame per 70Hz
+ * frame of wall time, showing each; letting go carries on from there.
+ * The keyboard and pads keep their current state. Recording and playing
+ * a replay turn rewinding off.
+ */
+#ifndef GOT_REWIND_H
+#define GOT_REWIND_H
+
+/* Memory for stored frames, in bytes (0 turns rewinding off; 32 MB by
+   default), and frames between keyframes (70). Negative or 0 keeps the
+   current value. Takes effect on the next frame, dropping what was
+   stored. */
+void rewind_config(long budget, int keyframe_frames);
+
+/* Top of each main loop frame: store it, or rewind while held. */
+void rewind_frame(void);
+
+/* Forget the stored frames (a new game starts). */
+void rewind_reset(void);
+
+/* --check-rewind N with --replay: every frame decodes what was just
+   stored and compares it with the snapshot it came from; every N frames
+   steps back N/2 frames and plays them again from the replay, which must
+   pass the same checkpoints. */
+void rewind_check_every(int frames);
+
+#endif /* GOT_REWIND_H */
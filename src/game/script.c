@@ -17,6 +17,9 @@
 #include "game_define.h"
 #include "game_proto.h"
 #include "res_man.h"
+#ifdef __llvm__
+#include "script_catalog.h"
+#endif
 //====================== Functions Declarations============================
 int  read_script_file(void);
 void script_error(int err_num);
@@ -31,6 +34,7 @@ int  exec_command(int num);
 void script_entry(void);
 void script_exit(void);
 int  cmd_exec(void);
+int  script_stop(void);
 //============================ Externals ==================================
 extern ACTOR *thor;
 extern THOR_INFO thor_info;
@@ -50,6 +54,7 @@ extern char far objects[NUM_OBJECTS][262];
 extern char object_map[240];
 extern char object_index[240];
 extern int thunder_flag;
+extern int scr_tracing;
 //============================= Globals ==================================
 long  far num_var[26];        //numeric variables
 char  far str_var[26][81];    //string vars
@@ -100,7 +105,7 @@ char  far *scr_error[]={"!@#$%","Out of Memory","Can't Read Script",
 #define ERROR_MAX 10
 //============================ Functions ==================================
 void execute_script(long index,char *pic){
-int i,ret,re_execute;
+int i;
 
 
 for(i=0;i<MAX_ACTORS;i++) actor[i].show=0;
@@ -117,6 +122,17 @@ scr_pic=pic;
 _fmemset(&num_var,0,4*26);
 _fmemset(&str_var,0,81*26);
 
+#ifdef __llvm__
+script_run_compiled();
+#else
+script_run_text();
+#endif
+}
+//=========================================================================
+// Runs the script scr_index names straight from its text.
+void script_run_text(void){
+int i,ret,re_execute;
+
 re_execute=0;
 run_script:                            //jump point for RUN command
 
@@ -142,7 +158,7 @@ if(!re_execute) script_entry();
 
 buff_ptr=buffer;
 while(1){
-     if(cheat && key_flag[_B]) break;
+     if(script_stop()) break;
      ret=get_command();
      if(ret==-1) break;       //ignore NO END error
      else if(ret==-2){
@@ -163,6 +179,12 @@ script_exit();
 return;
 }
 //=========================================================================
+int script_stop(void){
+
+if(cheat && key_flag[_B]) return 1;
+return scr_tracing && script_trace_step();
+}
+//=========================================================================
 void script_entry(void){
 
 }
@@ -467,12 +489,25 @@ char tmps[255];
 char far *sb;
 char far *sbuff;
 char str[21];
+#ifdef __llvm__
+const ScriptCatalog *cat;
+const ScriptEntry *e;
+#endif
 
+sbuff=0;
 buffer=farmalloc(SCR_BUFF_SIZE);
 if(!buffer) {ret=1;goto done;};
 buff_ptr=buffer;
 _fmemset(buffer,0,SCR_BUFF_SIZE);
 
+#ifdef __llvm__
+// Native build: the catalogue has every |N of the area indexed.
+cat=script_catalog_area(area);
+if(!cat) {ret=6;goto done;}
+e=script_catalog_find(cat,scr_index);
+if(!e || !e->stopped) {ret=2;goto done;}
+sb=(char far *) cat->text+e->start;
+#else
 // Ep1 uses a larger speech buffer (25000) than ep2/ep3 (20000)
 sbuff=farmalloc(g_episode == 1 ? 25000l : 20000l);
 if(!sbuff) {ret=1;goto done;};
@@ -493,6 +528,7 @@ while(1){
   if(!strcmp(tmps,"|EOF")){ret=2;goto done;}
   if(!strcmp(tmps,temp_buff)) break;
 }
+#endif
 num_labels=0;
 while(1){
      cnt=get_line(sb,(char far *)tmps);
@@ -550,9 +586,7 @@ return ret;
 //=========================================================================
 void script_error(int err_num){
 int  line_num;
-char s[17];
 char far *tb;
-char ts[81];
 
 line_num=1;
 tb=buffer;
@@ -562,7 +596,17 @@ while(1){
   if(tb>=buff_ptr) break;
   tb++;
 }
+script_report(err_num,line_num);
+}
+//=========================================================================
+void script_report(int err_num,int line_num){
+char s[17];
+char ts[81];
 
+if(scr_tracing){
+  script_trace_error(err_num,line_num);
+  return;
+}
 if(err_num>ERROR_MAX) err_num=5;       //unknown=syntax
 
 _fstrcpy((char far *) ts,scr_error[err_num]);
@@ -682,7 +726,7 @@ int cmd_addjewels(void){
 
 if(!calc_value()) return 5;
 buff_ptr++;
-add_jewels((int) lvalue);
+scr_effect(10,lvalue,0,0);
 return 0;
 }
 //=========================================================================
@@ -690,7 +734,7 @@ int cmd_addhealth(void){
 
 if(!calc_value()) return 5;
 buff_ptr++;
-add_health((int) lvalue);
+scr_effect(11,lvalue,0,0);
 return 0;
 }
 //=========================================================================
@@ -698,7 +742,7 @@ int cmd_addmagic(void){
 
 if(!calc_value()) return 5;
 buff_ptr++;
-add_magic((int) lvalue);
+scr_effect(12,lvalue,0,0);
 return 0;
 }
 //=========================================================================
@@ -706,7 +750,7 @@ int cmd_addkeys(void){
 
 if(!calc_value()) return 5;
 buff_ptr++;
-add_keys((int) lvalue);
+scr_effect(13,lvalue,0,0);
 return 0;
 }
 //=========================================================================
@@ -714,7 +758,7 @@ int cmd_addscore(void){
 
 if(!calc_value()) return 5;
 buff_ptr++;
-add_score((int) lvalue);
+scr_effect(14,lvalue,0,0);
 return 0;
 }
 //=========================================================================
@@ -740,8 +784,7 @@ while(calc_string(0)){
      p++;
 }
 *(p-1)=0;
-display_speech(obj,(char *) scr_pic,type);
-d_restore();
+scr_effect(15,obj,type,0);
 return 0;
 }
 //=========================================================================
@@ -785,8 +828,7 @@ while(calc_string(0)){
      if(i>9) return 3;
 }
 if(p>i) p=0;
-num_var[v]=select_option(op,title,p-1);
-d_restore();
+num_var[v]=scr_ask(op,title,p-1);
 return 0;
 }
 //=========================================================================
@@ -795,13 +837,12 @@ int cmd_sound(void){
 if(!calc_value()) return 5;
 buff_ptr++;
 if(lvalue<1 || lvalue>16) return 6;
-play_sound((int) lvalue-1,1);
+scr_effect(17,lvalue,0,0);
 return 0;
 }
 //=========================================================================
 int cmd_settile(void){
 int screen,pos,tile;
-LEVEL far *lvl;
 
 if(!calc_value()) return 5;
 buff_ptr++;
@@ -814,13 +855,7 @@ tile=(int) lvalue;
 if(screen<0 || screen>119) return 6;
 if(pos<0 || pos>239) return 6;
 if(tile<0 || tile>230) return 6;
-if(screen==current_level){
-  place_tile(pos%20,pos/20,tile);
-}
-else{
-  lvl=(LEVEL far *) (sd_data+(screen*512));
-  lvl->icon[pos/20][pos%20]=tile;
-}
+scr_effect(18,screen,pos,tile);
 return 0;
 }
 //=========================================================================
@@ -832,33 +867,23 @@ buff_ptr++;
 i=(int) lvalue;
 if(i<1 || i > 15) return 6;
 
-thor_info.inventory|=64;
-thor_info.item=7;
-thor_info.object=i;
-display_item();
-thor_info.object_name=ep->object_names[thor_info.object-1];
+scr_effect(19,i,0,0);
 return 0;
 }
 //=========================================================================
 int cmd_itemtake(void){
 
-delete_object();
+scr_effect(20,0,0,0);
 return 0;
 }
 //=========================================================================
 int cmd_setflag(void){
 int i;
-char b;
-char *sp;
 
 if(!calc_value()) return 5;
 i=(int) lvalue;
 if(i<1 || i>64) return 6;
-sp=(char *) &setup;
-sp+=(i/8);
-b=1;
-b=b << (i%8);
-*sp|=b;
+scr_effect(22,i,0,0);
 return 0;
 }
 //=========================================================================
@@ -889,7 +914,7 @@ if(!calc_value()) return 5;
 buff_ptr++;
 if(lvalue<1 || lvalue>65535l) return 6;
 
-got_pause((int) lvalue);
+scr_effect(24,lvalue,0,0);
 return 0;
 }
 //=========================================================================
@@ -899,7 +924,7 @@ if(!calc_value()) return 5;
 buff_ptr++;
 if(lvalue<1 || lvalue>16) return 6;
 
-actor_visible((int) lvalue);
+scr_effect(27,lvalue,0,0);
 return 0;
 }
 //=========================================================================
@@ -919,7 +944,7 @@ buff_ptr++;
 r=(int) lvalue;
 if(r<1 || r>1000) return 6;
 
-num_var[v]=rand() % r;
+num_var[v]=scr_effect(28,r,0,0);
 return 0;
 }
 //=========================================================================
@@ -1042,13 +1067,99 @@ void (*scr_func[])(void) =
        scr_func5,
      };
 //=========================================================================
+// Everything a script does to the game goes through here, from both the
+// text interpreter and the compiled one (script_vm.c). The script check
+// records the calls instead.
+long scr_effect(int cmd,long a,long b,long c){
+long r;
+char bit;
+char *sp;
+LEVEL far *lvl;
+
+if(scr_tracing){
+  r=script_trace_effect(cmd,a,b,c);
+  if(cmd!=22) return r;               //flags are script state too
+}
+switch(cmd){
+      case 10:                        //addjewels
+        add_jewels((int) a);
+        break;
+      case 11:                        //addhealth
+        add_health((int) a);
+        break;
+      case 12:                        //addmagic
+        add_magic((int) a);
+        break;
+      case 13:                        //addkeys
+        add_keys((int) a);
+        break;
+      case 14:                        //addscore
+        add_score((int) a);
+        break;
+      case 15:                        //say, itemsay, text (tmp_buff)
+        display_speech((int) a,(char *) scr_pic,(int) b);
+        d_restore();
+        break;
+      case 17:                        //sound
+        play_sound((int) a-1,1);
+        break;
+      case 18:                        //placetile
+        if(a==current_level){
+          place_tile((int) b%20,(int) b/20,(int) c);
+        }
+        else{
+          lvl=(LEVEL far *) (sd_data+(a*512));
+          lvl->icon[b/20][b%20]=(char) c;
+        }
+        break;
+      case 19:                        //itemgive
+        thor_info.inventory|=64;
+        thor_info.item=7;
+        thor_info.object=(int) a;
+        display_item();
+        thor_info.object_name=ep->object_names[thor_info.object-1];
+        break;
+      case 20:                        //itemtake
+        delete_object();
+        break;
+      case 22:                        //setflag
+        sp=(char *) &setup;
+        sp+=(a/8);
+        bit=1;
+        bit=bit << (a%8);
+        *sp|=bit;
+        break;
+      case 24:                        //pause
+        got_pause((int) a);
+        break;
+      case 26:                        //exec
+        scr_func[(int) (a-1)]();
+        break;
+      case 27:                        //visible
+        actor_visible((int) a);
+        break;
+      case 28:                        //random
+        return rand() % a;
+}
+return 0;
+}
+//=========================================================================
+int scr_ask(char **op,char *title,int ipos){
+int ret;
+
+if(scr_tracing) return script_trace_ask(op,title,ipos);
+ret=select_option(op,title,ipos);
+d_restore();
+return ret;
+}
+//=========================================================================
 int cmd_exec(void){
 
 if(!calc_value()) return 5;
 buff_ptr++;
 if(lvalue<1 || lvalue>10) return 6;
 
-scr_func[(int) (lvalue-1)]();
+scr_effect(26,lvalue,0,0);
 return 0;
 }
 //=========================================================================
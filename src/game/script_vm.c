@@ -0,0 +1,1247 @@
+//Source code released to the public domain on March 27th, 2020.
+//
+// Compiled SPEAK scripts.
+//
+// The first time a script block runs it is read and tokenized exactly as
+// read_script_file() leaves it for the text interpreter, then translated
+// into a table of statements: command opcodes, labels resolved to statement
+// numbers and every calc_value()/calc_string() operand parsed into terms.
+// The compiled block is kept for as long as the archive entry it came from
+// is unchanged, so running it again skips the SPEAK scan, the command
+// lookups and the expression parsing.
+//
+// Nothing is cleaned up on the way: the translation walks the token buffer
+// the way get_command() and the cmd_*() parsers would, including where
+// they stop on bad input, so the same text gives the same effects, errors
+// and error line numbers. script_check_run() (got --check-scripts) runs
+// both interpreters over every script and compares what they did.
+
+//=========================== Include Files ===============================
+#include <stdlib.h>
+#include <stdio.h>
+#include <alloc.h>
+#include <ctype.h>
+#include <dos.h>
+#include <string.h>
+#include <time.h>
+
+#include "game_define.h"
+#include "game_proto.h"
+#include "res_man.h"
+//============================ Externals ==================================
+extern ACTOR *thor;
+extern THOR_INFO thor_info;
+extern int current_level;
+extern char *tmp_buff;
+extern SETUP setup;
+extern ACTOR actor[MAX_ACTORS];
+extern LEVEL scrn;
+extern char cheat;
+
+extern long  far num_var[26];
+extern char  far str_var[26][81];
+extern char  far line_label[32][9];
+extern char  far *line_ptr[32];
+extern int   num_labels;
+extern char  far *buff_ptr;
+extern char  far *buff_end;
+extern char  far *buffer;
+extern long  scr_index;
+extern char  far temps[255];
+extern char  far *scr_command[];
+extern char  far *internal_variable[];
+
+int read_script_file(void);
+//============================= Globals ==================================
+int scr_tracing;              //script check: record effects, don't do them
+
+#define SCR_BUFF_SIZE 5000
+#define VM_END        -1      //ran off the end of the block
+
+#define T_CONST    0          //expression terms
+#define T_VAR      1
+#define T_INTERNAL 2
+#define T_FLAG     3
+#define T_FAIL     4          //calc_value() gives up here
+
+#define S_NOP      0          //"!@#$%" (statements are scr_command[] numbers
+#define S_ASSIGN   29         // 1..28 plus these)
+#define S_SASSIGN  30
+#define S_SYNTAX   31
+
+typedef struct{
+  char  kind;
+  char  op;                   //0 *, 1 +, 2 -, 3 / (calc_value's exptype)
+  char  var;                  //variable or internal variable number
+  short sub;                  //@FLAG: expression giving the flag number
+  short line;                 //error line if this term fails
+  long  val;
+} VM_TERM;
+
+typedef struct{
+  short first,count;
+} VM_LIST;
+
+typedef struct{               //part of a calc_string() expression
+  short var;                  //string variable, -1 for a literal
+  short text;                 //literal: offset into the string pool
+} VM_PART;
+
+typedef struct{
+  char  op;                   //S_* or scr_command[] number
+  char  var;                  //target variable; IF: comparison
+  char  err;                  //parse error, raised after the expressions
+  char  nexpr;
+  short err_line;
+  short rline;                //line for run-time errors
+  short expr[3];
+  VM_LIST str;                //SAY/ASK strings, SASSIGN value
+  short next;                 //statement to carry on with
+  short jump;                 //GOTO/GOSUB target, IF false target
+} VM_STMT;
+
+typedef struct{
+  int   episode,area;
+  long  index;
+  unsigned long res_offset,res_length;
+  char  err;                  //read_script_file() failure
+  short err_line;
+  short entry;
+  VM_STMT *stmt;
+  VM_TERM *term;
+  VM_LIST *expr;
+  VM_PART *part;
+  VM_LIST *strs;
+  char  *pool;
+  int   nstmt,nterm,nexpr,npart,nstrs,npool;
+} VM_PROG;
+
+static VM_PROG **vm_prog;
+static int vm_nprog;
+
+// Compiler state for the block being translated.
+static VM_PROG *cp;
+static const char *cb;        //token buffer
+static int   cb_end;          //buff_end
+static short cb_stmt[SCR_BUFF_SIZE];  //statement starting at each offset
+static short cb_zeros[SCR_BUFF_SIZE]; //zero bytes in [0,offset]
+static int   cb_queue[SCR_BUFF_SIZE];
+static int   cb_nqueue;
+static int   cb_oom;
+//============================ Functions ==================================
+static void *vm_grow(void *p,int n,int size){
+void *q;
+
+if(n & (n-1)) return p;                //grow on powers of two
+q=realloc(p,(size_t) (n ? n*2 : 16)*size);
+if(!q) cb_oom=1;
+return q;
+}
+//=========================================================================
+static int at(int o){
+
+if(o<0 || o>=SCR_BUFF_SIZE) return 0;
+return (unsigned char) cb[o];
+}
+//=========================================================================
+// The line script_error() reports with buff_ptr at offset o.
+static int line_at(int o){
+
+if(o<0) o=0;
+if(o>=SCR_BUFF_SIZE) o=SCR_BUFF_SIZE-1;
+return 1+cb_zeros[o];
+}
+//=========================================================================
+// skip_colon(): first offset of the next statement, or VM_END.
+static int vm_skip(int o){
+
+while(at(o)==0 || at(o)==':'){
+  o++;
+  if(o>cb_end || o>=SCR_BUFF_SIZE) return VM_END;
+}
+return o;
+}
+//=========================================================================
+// Where skip_colon() leaves buff_ptr when it runs off the end from o.
+static int vm_past_end(int o){
+
+return o>cb_end ? o+1 : cb_end+1;
+}
+//=========================================================================
+// Statement number for the statement get_command() finds from offset o.
+static short vm_stmt_at(int o){
+void *p;
+
+o=vm_skip(o);
+if(o==VM_END) return VM_END;
+if(cb_stmt[o]<0){
+  p=vm_grow(cp->stmt,cp->nstmt,sizeof(VM_STMT));
+  if(!p) return VM_END;
+  cp->stmt=(VM_STMT *) p;
+  cb_stmt[o]=(short) cp->nstmt++;
+  cb_queue[cb_nqueue++]=o;
+}
+return cb_stmt[o];
+}
+//=========================================================================
+static int vm_add_expr(VM_TERM *t,int n){
+void *p;
+int i;
+
+for(i=0;i<n;i++){
+   p=vm_grow(cp->term,cp->nterm,sizeof(VM_TERM));
+   if(!p) return -1;
+   cp->term=(VM_TERM *) p;
+   cp->term[cp->nterm++]=t[i];
+}
+p=vm_grow(cp->expr,cp->nexpr,sizeof(VM_LIST));
+if(!p) return -1;
+cp->expr=(VM_LIST *) p;
+cp->expr[cp->nexpr].first=(short) (cp->nterm-n);
+cp->expr[cp->nexpr].count=(short) n;
+return cp->nexpr++;
+}
+//=========================================================================
+static int vm_value(int *o);
+static int vm_failed(int e);
+
+// get_next_val(): one term at *o. Returns 0 (and a T_FAIL term) where the
+// text interpreter would give up.
+static int vm_term(int *o,VM_TERM *t){
+int ch,i,len,n;
+char tmpstr[25];
+
+memset(t,0,sizeof(VM_TERM));
+ch=at(*o);
+if(ch==0 || ch==':') goto fail;
+if(ch==64){
+  for(i=0;internal_variable[i];i++){
+     len=strlen(internal_variable[i]);
+     if(!strncmp(cb+*o,internal_variable[i],len)) break;
+  }
+  if(!internal_variable[i]) goto fail;
+  *o+=len;
+  t->var=(char) i;
+  if(i!=22){
+    t->kind=T_INTERNAL;
+    return 1;
+  }
+  t->kind=T_FLAG;
+  t->sub=(short) vm_value(o);
+  t->line=(short) line_at(*o);
+  return !vm_failed(t->sub);           //nothing parses past a bad flag number
+}
+if(isalpha(ch)){
+  (*o)++;
+  t->kind=T_VAR;
+  t->var=(char) (ch-65);
+  return 1;
+}
+n=0;
+if(strchr("0123456789-",ch)){
+  tmpstr[n++]=(char) ch;
+  (*o)++;
+  while(strchr("0123456789",at(*o)) && at(*o)!=0){
+       if(n<24) tmpstr[n]=(char) at(*o);
+       (*o)++;
+       n++;
+  }
+  if(n>10) goto fail;
+  tmpstr[n]=0;
+  t->kind=T_CONST;
+  t->val=atol(tmpstr);
+  return 1;
+}
+fail:
+t->kind=T_FAIL;
+t->line=(short) line_at(*o);
+return 0;
+}
+//=========================================================================
+// calc_value() at *o; *o is left where calc_value() would leave buff_ptr.
+static int vm_value(int *o){
+VM_TERM t[128];
+int n,exptype,ok;
+
+n=0;
+exptype=1;
+while(1){
+     ok=vm_term(o,&t[n]);
+     t[n++].op=(char) exptype;
+     if(!ok || n==128) break;
+     switch(at(*o)){
+           case 42: exptype=0; break;
+           case 43: exptype=1; break;
+           case 45: exptype=2; break;
+           case 47: exptype=3; break;
+           default: return vm_add_expr(t,n);
+     }
+     (*o)++;
+}
+return vm_add_expr(t,n);
+}
+//=========================================================================
+// Whether calc_value() gives up parsing expression e.
+static int vm_failed(int e){
+VM_TERM *t;
+
+if(cb_oom || e<0) return 1;
+t=&cp->term[cp->expr[e].first+cp->expr[e].count-1];
+if(t->kind==T_FLAG) return vm_failed(t->sub);
+return t->kind==T_FAIL;
+}
+//=========================================================================
+static int vm_add_part(int var,const char *text,int len){
+void *p;
+
+p=vm_grow(cp->part,cp->npart,sizeof(VM_PART));
+if(!p) return 0;
+cp->part=(VM_PART *) p;
+cp->part[cp->npart].var=(short) var;
+cp->part[cp->npart].text=(short) cp->npool;
+cp->npart++;
+if(var<0){
+  while(len-->=0){
+       p=vm_grow(cp->pool,cp->npool,1);
+       if(!p) return 0;
+       cp->pool=(char *) p;
+       cp->pool[cp->npool++]=(char) (len>=0 ? *text++ : 0);
+  }
+}
+return 1;
+}
+//=========================================================================
+// calc_string(mode) at *o. Returns 1 and the parts in *l, or 0 where the
+// text interpreter's calc_string() returns 0.
+static int vm_string(int *o,int mode,VM_LIST *l){
+int s;
+
+l->first=(short) cp->npart;
+l->count=0;
+s=vm_skip(*o);
+if(s==VM_END){
+  *o=vm_past_end(*o);
+  return 0;
+}
+*o=s;
+while(1){
+     if(at(*o)=='"'){
+       s=++(*o);
+       while(at(*o)!='"' && at(*o)!=0) (*o)++;
+       if(!vm_add_part(-1,cb+s,*o-s)) return 0;
+       if(at(*o)=='"') (*o)++;
+     }
+     else if(isalpha(at(*o)) && at(*o+1)=='$'){
+       if(!vm_add_part(at(*o)-65,NULL,0)) return 0;
+       *o+=2;
+     }
+     else return 0;
+     l->count++;
+     if(at(*o)==0 || at(*o)==58){
+       (*o)++;
+       return 1;
+     }
+     if(at(*o)==',' && mode==1) return 1;
+     if(at(*o)!='+') return 0;
+     (*o)++;
+}
+}
+//=========================================================================
+// SAY/ASK: strings for as long as calc_string(0) finds them.
+static int vm_strings(int *o,VM_LIST *all,int max,int *over){
+VM_LIST l;
+void *p;
+int n;
+
+n=0;
+all->first=(short) cp->nstrs;
+while(vm_string(o,0,&l)){
+     p=vm_grow(cp->strs,cp->nstrs,sizeof(VM_LIST));
+     if(!p) return 0;
+     cp->strs=(VM_LIST *) p;
+     cp->strs[cp->nstrs++]=l;
+     n++;
+     if(max && n>max-1){
+       *over=1;
+       break;
+     }
+}
+all->count=(short) n;
+return 1;
+}
+//=========================================================================
+// One expression argument followed by the separator the cmd_*() function
+// steps over. Returns 0 if calc_value() fails at parse time.
+static int vm_arg(VM_STMT *st,int *o,int skip){
+int e;
+
+e=vm_value(o);
+st->expr[(int) st->nexpr++]=(short) e;
+if(vm_failed(e)) return 0;
+*o+=skip;
+return 1;
+}
+//=========================================================================
+static void vm_compile_stmt(int s,VM_STMT *st){
+int o,i,len,q,ch,over;
+char lab[255];
+char *c;
+VM_LIST l;
+void *p;
+
+memset(st,0,sizeof(VM_STMT));
+st->next=VM_END;
+st->jump=VM_END;
+o=s;
+for(i=0;scr_command[i];i++){
+   len=strlen(scr_command[i]);
+   if(!strncmp(cb+o,scr_command[i],len)) break;
+}
+if(!scr_command[i]){
+  st->rline=(short) line_at(s);
+  if(isalpha(at(o)) && at(o+1)=='='){
+    st->op=S_ASSIGN;
+    st->var=(char) (at(o)-65);
+    o+=2;
+    if(!vm_arg(st,&o,0)) return;
+    st->next=vm_stmt_at(o);
+    return;
+  }
+  if(isalpha(at(o)) && at(o+1)=='$' && at(o+2)=='='){
+    st->var=(char) (at(o)-65);
+    o+=3;
+    if(!vm_string(&o,0,&st->str)){
+      st->op=S_SYNTAX;
+      st->err_line=(short) line_at(o);
+      return;
+    }
+    st->op=S_SASSIGN;
+    st->next=vm_stmt_at(o);
+    return;
+  }
+  st->op=S_SYNTAX;
+  st->err_line=(short) line_at(s);
+  return;
+}
+st->op=(char) i;
+o+=len;
+switch(i){
+      case 2:                          //goto
+      case 3:                          //gosub
+        strcpy(lab,cb+o);
+        c=strchr(lab,':');
+        if(c) *c=0;
+        len=strlen(lab);
+        for(q=0;q<num_labels && len;q++){
+           if(!strcmp(lab,line_label[q])) break;
+        }
+        if(!len || q==num_labels){
+          st->err=8;
+          st->err_line=(short) line_at(o);
+          return;
+        }
+        st->jump=vm_stmt_at((int) (line_ptr[q]-buffer));
+        st->next=vm_stmt_at(o+len);
+        st->rline=(short) line_at(o+len);
+        return;
+      case 4:                          //return
+      case 6:                          //next
+        st->rline=(short) line_at(o);
+        break;
+      case 5:                          //for
+        st->rline=(short) line_at(o);
+        if(!isalpha(at(o))){
+          st->err=5;
+          st->err_line=st->rline;
+          return;
+        }
+        st->var=(char) (at(o)-65);
+        o+=2;
+        if(!vm_arg(st,&o,2)) return;
+        if(!vm_arg(st,&o,0)) return;
+        break;
+      case 7:                          //if
+        if(!vm_arg(st,&o,0)) return;
+        ch=at(o);
+        o++;
+        if(at(o)==60 || at(o)==61 || at(o)==62){
+          if(ch==at(o)){
+            st->err=5;
+            st->err_line=(short) line_at(o);
+            return;
+          }
+          ch+=at(o);
+          o++;
+        }
+        if(!vm_arg(st,&o,4)) return;
+        st->var=(char) ch;
+        if(ch!=60 && ch!=61 && ch!=62 && ch!=121 && ch!=122 && ch!=123){
+          st->err=5;
+          st->err_line=(short) line_at(o);
+          return;
+        }
+        q=o;
+        while(at(q)!=0) q++;
+        while(at(q)==0 && q<SCR_BUFF_SIZE) q++;
+        if(!strncmp(cb+q,"ELSE",4)) q+=4;
+        st->jump=vm_stmt_at(q);
+        break;
+      case 8:                          //else
+        while(at(o)!=0) o++;
+        break;
+      case 9:                          //run
+      case 10:                         //addjewels
+      case 11:                         //addhealth
+      case 12:                         //addmagic
+      case 13:                         //addkeys
+      case 14:                         //addscore
+      case 17:                         //sound
+      case 19:                         //itemgive
+      case 24:                         //pause
+      case 26:                         //exec
+      case 27:                         //visible
+        if(!vm_arg(st,&o,1)) return;
+        st->rline=(short) line_at(o);
+        break;
+      case 15:                         //say
+      case 21:                         //itemsay
+      case 25:                         //text
+        if(i==21){
+          if(!vm_arg(st,&o,1)) return;
+          st->rline=(short) line_at(o);
+        }
+        over=0;
+        if(!vm_strings(&o,&st->str,0,&over)) return;
+        break;
+      case 16:                         //ask
+        q=vm_skip(o);
+        if(q==VM_END){
+          st->err=5;
+          st->err_line=(short) line_at(vm_past_end(o));
+          return;
+        }
+        o=q;
+        if(!isalpha(at(o)) || at(o+1)!=','){
+          if(isalpha(at(o))) o++;
+          st->err=5;
+          st->err_line=(short) line_at(o);
+          return;
+        }
+        st->var=(char) (at(o)-65);
+        o+=2;
+        if(!vm_string(&o,1,&l) || at(o)!=','){
+          st->err=5;
+          st->err_line=(short) line_at(o);
+          return;
+        }
+        o++;
+        if(!vm_arg(st,&o,1)) return;
+        // The title goes first in the string list, then the options.
+        q=cp->nstrs;
+        p=vm_grow(cp->strs,cp->nstrs,sizeof(VM_LIST));
+        if(!p) return;
+        cp->strs=(VM_LIST *) p;
+        cp->strs[cp->nstrs++]=l;
+        over=0;
+        if(!vm_strings(&o,&st->str,10,&over)) return;
+        st->str.first=(short) q;
+        st->str.count++;
+        if(over){
+          st->err=3;
+          st->err_line=(short) line_at(o);
+          return;
+        }
+        break;
+      case 18:                         //placetile
+        if(!vm_arg(st,&o,1)) return;
+        if(!vm_arg(st,&o,1)) return;
+        if(!vm_arg(st,&o,0)) return;
+        st->rline=(short) line_at(o);
+        break;
+      case 22:                         //setflag
+        if(!vm_arg(st,&o,0)) return;
+        st->rline=(short) line_at(o);
+        break;
+      case 23:                         //ltoa
+        if(!vm_arg(st,&o,1)) return;
+        if(!isalpha(at(o)) || at(o+1)!='$'){
+          st->err=5;
+          st->err_line=(short) line_at(o);
+          return;
+        }
+        st->var=(char) (at(o)-65);
+        o+=2;
+        break;
+      case 28:                         //random
+        if(!isalpha(at(o)) || at(o+1)!=','){
+          if(isalpha(at(o))) o++;
+          st->err=5;
+          st->err_line=(short) line_at(o);
+          return;
+        }
+        st->var=(char) (at(o)-65);
+        o+=2;
+        if(!vm_arg(st,&o,1)) return;
+        st->rline=(short) line_at(o);
+        break;
+}
+st->next=vm_stmt_at(o);
+}
+//=========================================================================
+static void vm_free(VM_PROG *pr){
+
+if(!pr) return;
+free(pr->stmt);
+free(pr->term);
+free(pr->expr);
+free(pr->part);
+free(pr->strs);
+free(pr->pool);
+free(pr);
+}
+//=========================================================================
+// Reads scr_index's block with read_script_file() and translates it.
+static VM_PROG *vm_compile(void){
+VM_STMT st;
+int i,o,s;
+char far *tb;
+
+cp=(VM_PROG *) calloc(1,sizeof(VM_PROG));
+if(!cp) return NULL;
+cb_oom=0;
+num_labels=0;
+buffer=0;
+i=read_script_file();
+if(i!=0){
+  // What script_error() would report for the failed read.
+  cp->err=(char) i;
+  cp->err_line=1;
+  tb=buffer;
+  while(tb){
+    if(*tb==0) cp->err_line++;
+    if(tb>=buff_ptr) break;
+    tb++;
+  }
+  if(buffer) farfree(buffer);
+  buffer=0;
+  return cp;
+}
+cb=buffer;
+cb_end=(int) (buff_end-buffer);
+s=0;
+for(o=0;o<SCR_BUFF_SIZE;o++){
+   if(!cb[o]) s++;
+   cb_zeros[o]=(short) s;
+   cb_stmt[o]=-1;
+}
+cb_nqueue=0;
+cp->entry=vm_stmt_at(0);
+for(i=0;i<cb_nqueue && !cb_oom;i++){
+   vm_compile_stmt(cb_queue[i],&st);
+   cp->stmt[cb_stmt[cb_queue[i]]]=st;
+}
+farfree(buffer);
+buffer=0;
+if(cb_oom){
+  vm_free(cp);
+  return NULL;
+}
+return cp;
+}
+//=========================================================================
+// Compiled block for scr_index in the current area, translated on first use.
+static VM_PROG *vm_load(void){
+char name[21];
+int num,i;
+unsigned long off,len;
+VM_PROG *pr;
+void *p;
+
+sprintf(name,"SPEAK%d",area);
+num=res_find_name(name);
+off=num>=0 ? res_header[num].offset : 0;
+len=num>=0 ? res_header[num].length : 0;
+for(i=0;i<vm_nprog;i++){
+   pr=vm_prog[i];
+   if(pr->index==scr_index && pr->area==area && pr->episode==g_episode &&
+      pr->res_offset==off && pr->res_length==len) return pr;
+}
+pr=vm_compile();
+if(!pr) return NULL;
+pr->episode=g_episode;
+pr->area=area;
+pr->index=scr_index;
+pr->res_offset=off;
+pr->res_length=len;
+p=realloc(vm_prog,(vm_nprog+1)*sizeof(VM_PROG *));
+if(!p){
+  vm_free(pr);
+  return NULL;
+}
+vm_prog=(VM_PROG **) p;
+vm_prog[vm_nprog++]=pr;
+return pr;
+}
+//=========================================================================
+static long vm_internal(int i){
+long v;
+
+switch(i){
+      case 0:  v=thor_info.jewels; break;
+      case 1:  v=thor->health; break;
+      case 2:  v=thor_info.magic; break;
+      case 3:  v=thor_info.score; break;
+      case 4:  v=current_level; break;
+      case 5:  v=thor_info.keys; break;
+      case 23:
+           if(thor_info.inventory & 64) v=thor_info.object;
+           else v=0;
+           break;
+      case 24:
+           v=scrn.icon[(thor->y+8)/16][(thor->x+7)/16];
+           break;
+      case 25:
+           v=(((thor->y+8)/16)*20)+((thor->x+7)/16);
+           break;
+      default: v=(long) (i-5l);         //sound numbers
+}
+return v;
+}
+//=========================================================================
+// calc_value(): 0 and the error line if it fails.
+static int vm_eval(VM_PROG *pr,int e,long *out,int *line){
+VM_TERM *t;
+long tmpval2,v;
+int i,f;
+char b;
+char *sp;
+
+tmpval2=0;
+t=&pr->term[pr->expr[e].first];
+for(i=0;i<pr->expr[e].count;i++,t++){
+   switch(t->kind){
+         case T_CONST:
+              v=t->val;
+              break;
+         case T_VAR:
+              v=num_var[(int) t->var];
+              break;
+         case T_INTERNAL:
+              v=vm_internal(t->var);
+              break;
+         case T_FLAG:
+              if(!vm_eval(pr,t->sub,&v,line)) return 0;
+              f=(int) v;
+              if(f<1 || f>64){
+                *line=t->line;
+                return 0;
+              }
+              sp=(char *) &setup;
+              sp+=(f/8);
+              b=1;
+              b=b << (f%8);
+              v=(*sp & b) ? 1 : 0;
+              break;
+         default:
+              *line=t->line;
+              return 0;
+   }
+   switch(t->op){
+         case 0: tmpval2=tmpval2*v; break;
+         case 1: tmpval2=tmpval2+v; break;
+         case 2: tmpval2=tmpval2-v; break;
+         case 3: if(v!=0) tmpval2=tmpval2/v; break;
+   }
+}
+*out=tmpval2;
+return 1;
+}
+//=========================================================================
+// calc_string(): the string in temps.
+static void vm_str(VM_PROG *pr,VM_LIST *l){
+char varstr[255];
+const char *s;
+int i;
+
+varstr[0]=0;
+for(i=0;i<l->count;i++){
+   if(pr->part[l->first+i].var<0) s=pr->pool+pr->part[l->first+i].text;
+   else s=str_var[pr->part[l->first+i].var];
+   if(strlen(varstr)+strlen(s) < 255) strcat(varstr,s);
+}
+strcpy(temps,varstr);
+}
+//=========================================================================
+// The statement's expressions in order, then its parse error if it has one.
+static int vm_args(VM_PROG *pr,VM_STMT *st,long *v){
+int i,line;
+
+for(i=0;i<st->nexpr;i++){
+   if(!vm_eval(pr,st->expr[i],&v[i],&line)){
+     script_report(5,line);
+     return 0;
+   }
+}
+if(st->err){
+  script_report(st->err,st->err_line);
+  return 0;
+}
+return 1;
+}
+//=========================================================================
+// execute_script() for the compiled block: the same loop as
+// script_run_text(), one statement per pass.
+void script_run_compiled(void){
+VM_PROG *pr;
+VM_STMT *st;
+int pc,i,n,obj;
+long v[3];
+short gosub_stack[33];
+int  gosub_ptr;
+short for_stack[11];
+long for_val[11];
+char for_var[11];
+int  for_ptr;
+char *p;
+char title[41];
+char *op[11];
+char opts[10][41];
+char str[21];
+
+pr=vm_load();
+if(!pr){                               //out of memory: run it from text
+  script_run_text();
+  return;
+}
+run_script:
+if(pr->err){
+  script_report(pr->err,pr->err_line);
+  return;
+}
+gosub_ptr=0;
+for_ptr=0;
+pc=pr->entry;
+while(1){
+     if(script_stop()) break;
+     if(pc==VM_END) break;
+     st=&pr->stmt[pc];
+     pc=st->next;
+     switch(st->op){
+           case S_NOP:
+             break;
+           case S_SYNTAX:
+             script_report(5,st->err_line);
+             return;
+           case S_ASSIGN:
+             if(!vm_eval(pr,st->expr[0],&v[0],&i)){
+               script_report(5,i);
+               return;
+             }
+             num_var[(int) st->var]=v[0];
+             break;
+           case S_SASSIGN:
+             vm_str(pr,&st->str);
+             if(strlen(temps)<=80) strcpy(str_var[(int) st->var],temps);
+             break;
+           case 1:                     //end
+             return;
+           case 2:                     //goto
+             if(!vm_args(pr,st,v)) return;
+             pc=st->jump;
+             break;
+           case 3:                     //gosub
+             if(!vm_args(pr,st,v)) return;
+             gosub_ptr++;
+             if(gosub_ptr>31){
+               script_report(10,st->rline);
+               return;
+             }
+             gosub_stack[gosub_ptr]=st->next;
+             pc=st->jump;
+             break;
+           case 4:                     //return
+             if(!gosub_ptr){
+               script_report(9,st->rline);
+               return;
+             }
+             pc=gosub_stack[gosub_ptr--];
+             break;
+           case 5:                     //for
+             for_ptr++;
+             if(for_ptr>10){
+               script_report(10,st->rline);
+               return;
+             }
+             if(st->err){
+               script_report(st->err,st->err_line);
+               return;
+             }
+             for_var[for_ptr]=st->var;
+             if(!vm_eval(pr,st->expr[0],&v[0],&i)){
+               script_report(5,i);
+               return;
+             }
+             num_var[(int) st->var]=v[0];
+             if(!vm_eval(pr,st->expr[1],&v[1],&i)){
+               script_report(5,i);
+               return;
+             }
+             for_val[for_ptr]=v[1];
+             for_stack[for_ptr]=st->next;
+             break;
+           case 6:                     //next
+             if(!for_ptr){
+               script_report(11,st->rline);
+               return;
+             }
+             num_var[(int) for_var[for_ptr]]=num_var[(int) for_var[for_ptr]]+1;
+             if(num_var[(int) for_var[for_ptr]]<=for_val[for_ptr])
+               pc=for_stack[for_ptr];
+             else for_ptr--;
+             break;
+           case 7:                     //if
+             if(!vm_args(pr,st,v)) return;
+             switch(st->var){
+                   case 60:  i=v[0]<v[1];  break;
+                   case 61:  i=v[0]==v[1]; break;
+                   case 62:  i=v[0]>v[1];  break;
+                   case 121: i=v[0]<=v[1]; break;
+                   case 122: i=v[0]!=v[1]; break;
+                   default:  i=v[0]>=v[1]; break;
+             }
+             if(!i) pc=st->jump;
+             break;
+           case 8:                     //else
+             break;
+           case 9:                     //run
+             if(!vm_args(pr,st,v)) return;
+             scr_index=v[0];
+             pr=vm_load();
+             if(!pr) return;
+             goto run_script;
+           case 10:                    //addjewels
+           case 11:                    //addhealth
+           case 12:                    //addmagic
+           case 13:                    //addkeys
+           case 14:                    //addscore
+             if(!vm_args(pr,st,v)) return;
+             scr_effect(st->op,v[0],0,0);
+             break;
+           case 15:                    //say
+           case 21:                    //itemsay
+           case 25:                    //text
+             obj=0;
+             if(st->op==21){
+               if(!vm_args(pr,st,v)) return;
+               obj=(int) v[0];
+               if(obj<0 || obj>32){
+                 script_report(6,st->rline);
+                 return;
+               }
+               if(obj) obj+=10;
+             }
+             memset(tmp_buff,0,TMP_SIZE);
+             p=tmp_buff;
+             for(i=0;i<st->str.count;i++){
+                vm_str(pr,&pr->strs[st->str.first+i]);
+                strcpy(p,temps);
+                p+=strlen(temps);
+                *p=10;
+                p++;
+             }
+             if(p>tmp_buff) *(p-1)=0;
+             scr_effect(15,obj,st->op==25 ? 0 : 1,0);
+             break;
+           case 16:                    //ask
+             memset(tmp_buff,0,TMP_SIZE);
+             memset(opts,0,10*41);
+             if(!vm_args(pr,st,v)) return;
+             vm_str(pr,&pr->strs[st->str.first]);
+             strncpy(title,temps,41);
+             title[40]=0;
+             n=st->str.count-1;
+             for(i=0;i<n;i++){
+                vm_str(pr,&pr->strs[st->str.first+1+i]);
+                strncpy(opts[i],temps,41);
+                opts[i][40]=0;
+                op[i]=opts[i];
+             }
+             op[n]=NULL;
+             i=(int) v[0];
+             if(i>n) i=0;
+             num_var[(int) st->var]=scr_ask(op,title,i-1);
+             break;
+           case 17:                    //sound
+             if(!vm_args(pr,st,v)) return;
+             if(v[0]<1 || v[0]>16){
+               script_report(6,st->rline);
+               return;
+             }
+             scr_effect(17,v[0],0,0);
+             break;
+           case 18:                    //placetile
+             if(!vm_args(pr,st,v)) return;
+             if((int) v[0]<0 || (int) v[0]>119 || (int) v[1]<0 || (int) v[1]>239 ||
+                (int) v[2]<0 || (int) v[2]>230){
+               script_report(6,st->rline);
+               return;
+             }
+             scr_effect(18,(int) v[0],(int) v[1],(int) v[2]);
+             break;
+           case 19:                    //itemgive
+             if(!vm_args(pr,st,v)) return;
+             if((int) v[0]<1 || (int) v[0]>15){
+               script_report(6,st->rline);
+               return;
+             }
+             scr_effect(19,(int) v[0],0,0);
+             break;
+           case 20:                    //itemtake
+             scr_effect(20,0,0,0);
+             break;
+           case 22:                    //setflag
+             if(!vm_args(pr,st,v)) return;
+             if((int) v[0]<1 || (int) v[0]>64){
+               script_report(6,st->rline);
+               return;
+             }
+             scr_effect(22,(int) v[0],0,0);
+             break;
+           case 23:                    //ltoa
+             if(!vm_args(pr,st,v)) return;
+             ltoa(v[0],str,10);
+             strcpy(str_var[(int) st->var],str);
+             break;
+           case 24:                    //pause
+             if(!vm_args(pr,st,v)) return;
+             if(v[0]<1 || v[0]>65535l){
+               script_report(6,st->rline);
+               return;
+             }
+             scr_effect(24,v[0],0,0);
+             break;
+           case 26:                    //exec
+             if(!vm_args(pr,st,v)) return;
+             if(v[0]<1 || v[0]>10){
+               script_report(6,st->rline);
+               return;
+             }
+             scr_effect(26,v[0],0,0);
+             break;
+           case 27:                    //visible
+             if(!vm_args(pr,st,v)) return;
+             if(v[0]<1 || v[0]>16){
+               script_report(6,st->rline);
+               return;
+             }
+             scr_effect(27,v[0],0,0);
+             break;
+           case 28:                    //random
+             if(!vm_args(pr,st,v)) return;
+             if((int) v[0]<1 || (int) v[0]>1000){
+               script_report(6,st->rline);
+               return;
+             }
+             num_var[(int) st->var]=scr_effect(28,(int) v[0],0,0);
+             break;
+     }
+}
+}
+//=========================================================================
+// Script check: both interpreters run every script with the game effects
+// logged instead of done, and the logs and variables are compared.
+//=========================================================================
+#define TRACE_STEPS  20000            //statements before a run is cut off
+#define TRACE_SEEDS  3                //RANDOM sequences tried per script
+#define TRACE_PASSES 20               //timing passes over every script
+
+extern char *scr_pic;
+
+static char *trace_log;
+static long trace_len,trace_size;
+static long trace_steps;
+static int  trace_asks;
+
+static void trace_put(const char *s){
+long len;
+char *p;
+
+len=strlen(s);
+if(trace_len+len+1>trace_size){
+  p=(char *) realloc(trace_log,trace_size*2+len+1024);
+  if(!p) return;
+  trace_log=p;
+  trace_size=trace_size*2+len+1024;
+}
+memcpy(trace_log+trace_len,s,len+1);
+trace_len+=len;
+}
+//=========================================================================
+int script_trace_step(void){
+
+if(++trace_steps<=TRACE_STEPS) return 0;
+trace_put("stopped\n");
+return 1;
+}
+//=========================================================================
+long script_trace_effect(int cmd,long a,long b,long c){
+char s[64];
+
+sprintf(s,"%d %ld %ld %ld\n",cmd,a,b,c);
+trace_put(s);
+if(cmd==15){
+  trace_put(tmp_buff);
+  trace_put("\n");
+}
+if(cmd==28) return rand() % a;
+return 0;
+}
+//=========================================================================
+int script_trace_ask(char **op,char *title,int ipos){
+char s[32];
+int n;
+
+sprintf(s,"ask %d ",ipos);
+trace_put(s);
+trace_put(title);
+for(n=0;op[n];n++){
+   trace_put("|");
+   trace_put(op[n]);
+}
+trace_put("\n");
+return trace_asks++ % (n+1);
+}
+//=========================================================================
+void script_trace_error(int err_num,int line_num){
+char s[32];
+
+sprintf(s,"error %d line %d\n",err_num,line_num);
+trace_put(s);
+}
+//=========================================================================
+typedef struct{
+  char *log;
+  long num[26];
+  char str[26][81];
+  SETUP flags;
+} TRACE_RUN;
+
+static void trace_run(int compiled,long index,int seed,SETUP *start,TRACE_RUN *out){
+
+setup=*start;
+memset(num_var,0,sizeof(num_var));
+memset(str_var,0,sizeof(str_var));
+scr_index=index;
+scr_pic=NULL;
+trace_len=0;
+trace_put("");
+trace_steps=0;
+trace_asks=seed;
+srand(seed);
+if(compiled) script_run_compiled();
+else script_run_text();
+if(!out) return;
+out->log=strdup(trace_log ? trace_log : "");
+memcpy(out->num,num_var,sizeof(out->num));
+memcpy(out->str,str_var,sizeof(out->str));
+out->flags=setup;
+}
+//=========================================================================
+static void trace_diff(int a,long index,int seed,TRACE_RUN *t,TRACE_RUN *c){
+char *p,*q;
+int line;
+
+printf("scripts: SPEAK%d |%ld seed %d differs\n",a,index,seed);
+p=t->log;
+q=c->log;
+line=1;
+while(*p && *p==*q){
+     if(*p=='\n') line++;
+     p++;
+     q++;
+}
+if(*p || *q){
+  while(p>t->log && p[-1]!='\n'){p--; q--;}
+  printf("  log line %d\n  text:     %.60s\n  compiled: %.60s\n",line,p,q);
+}
+else printf("  variables or flags differ\n");
+}
+//=========================================================================
+// got --check-scripts: every script of the open episode, both ways.
+int script_check_run(void){
+static char lzss_buff[18000];
+static ACTOR player;
+SETUP start;
+TRACE_RUN t,c;
+char name[21];
+char *data,*p;
+long *index;
+long len,n,i,total;
+int a,seed,scripts,runs,bad,num,pass;
+clock_t t0;
+double t_text,t_vm;
+
+res_init(lzss_buff);
+if(res_open("GOTRES.DAT")<0){
+  printf("scripts: can't read GOTRES.DAT\n");
+  return 1;
+}
+if(!thor) thor=&player;
+if(!tmp_buff) tmp_buff=(char *) malloc(TMP_SIZE);
+if(!tmp_buff) return 1;
+start=setup;
+scr_tracing=1;
+scripts=runs=bad=0;
+t_text=t_vm=0;
+for(a=1;a<=3;a++){
+   sprintf(name,"SPEAK%d",a);
+   num=res_find_name(name);
+   if(num<0) continue;
+   data=(char *) res_falloc_read(name);
+   if(!data) continue;
+   len=res_header[num].original_size;
+   // The |N headers, in file order.
+   index=(long *) malloc((len/2+1)*sizeof(long));
+   n=0;
+   for(p=data;index && p<data+len;p++){
+      if(*p=='|' && (p==data || p[-1]==10) && (isdigit(p[1]) || p[1]=='-'))
+        index[n++]=atol(p+1);
+   }
+   area=(char) a;
+   for(i=0;i<n;i++){
+      for(seed=1;seed<=TRACE_SEEDS;seed++){
+         trace_run(0,index[i],seed,&start,&t);
+         trace_run(1,index[i],seed,&start,&c);
+         if(strcmp(t.log,c.log) || memcmp(t.num,c.num,sizeof(t.num)) ||
+            memcmp(t.str,c.str,sizeof(t.str)) || memcmp(&t.flags,&c.flags,sizeof(SETUP))){
+           if(++bad<=8) trace_diff(a,index[i],seed,&t,&c);
+         }
+         free(t.log);
+         free(c.log);
+         runs++;
+      }
+   }
+   for(pass=0;pass<2;pass++){
+      t0=clock();
+      for(total=0;total<TRACE_PASSES;total++){
+         for(i=0;i<n;i++) trace_run(pass,index[i],1,&start,NULL);
+      }
+      if(pass) t_vm+=(double) (clock()-t0)/CLOCKS_PER_SEC;
+      else t_text+=(double) (clock()-t0)/CLOCKS_PER_SEC;
+   }
+   scripts+=(int) n;
+   free(index);
+   free(data);
+}
+scr_tracing=0;
+setup=start;
+res_close();
+printf("scripts: episode %d, %d scripts, %d runs, %d mismatches\n",
+       g_episode,scripts,runs,bad);
+if(scripts){
+  printf("scripts: text %.1f us/run, compiled %.1f us/run (%.1fx)\n",
+         t_text*1e6/(scripts*TRACE_PASSES),t_vm*1e6/(scripts*TRACE_PASSES),
+         t_vm>0 ? t_text/t_vm : 0.0);
+}
+return bad ? 1 : 0;
+}
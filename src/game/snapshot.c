@@ -0,0 +1,526 @@
+//Source code released to the public domain on March 27th, 2020.
+//
+// Savestates.
+//
+// A snapshot is every piece of state the game carries from one main loop
+// frame to the next, copied into one flat buffer: the globals below in
+// table order, the module state of the boss and object code, then the
+// native side (clock, music sequencer, OPL registers, video pages). One
+// walk over that list sizes, saves and restores it, so the three can't
+// disagree about the layout.
+//
+// Almost all of it is plain data. The exceptions are pointers: each
+// MASK_IMAGE alignment points at a sprite atlas entry and is saved as the
+// entry's index (image_ptr) plus one, and thor_info's object names point
+// into the episode's name table and are saved as table index plus one.
+// Restoring turns them back into pointers in place. Everything else that
+// looks like a pointer (thor, hammer, scrnp, ep) never changes in a run.
+//
+// Sound effects are left alone: what plays is output, and so is the
+// priority of the one playing (sound.c), which only decides whether the
+// next one cuts in.
+//
+// Resources that follow the state are reloaded only when they differ:
+// the boss sounds (setup_boss()) and the song (music_play()). The rest is
+// copies, about 310 KB in split screen mode, so saving or restoring costs
+// tens of microseconds.
+
+//=========================== Include Files ===============================
+#include <stdlib.h>
+#include <stdio.h>
+#include <dos.h>
+#include <string.h>
+
+#include "game_define.h"
+#include "game_proto.h"
+#include "episode.h"
+#include "snapshot.h"
+#include "mu_man.h"
+#include "adlib_native.h"
+#include "got_clock.h"
+#include "got_platform.h"
+#include "got_replay.h"
+#include "sprite_atlas.h"
+//============================ Externals ==================================
+extern unsigned int display_page,draw_page;
+extern unsigned int page3_offset;
+extern char pge;
+extern int exit_flag;
+extern volatile char key_flag[100];
+extern volatile char joy_flag[100];
+extern volatile char tmp_flag[100];
+extern char break_code;
+extern char scan_code,last_scan_code;
+extern char diag;
+extern char slow_mode;
+extern char shot_ok;
+extern int thor_x1,thor_y1,thor_x2,thor_y2,thor_real_y1;
+extern int thor_pos;
+extern int max_shot;
+extern volatile unsigned int timer_cnt,vbl_cnt,magic_cnt,extra_cnt;
+extern int ox,oy,of;
+extern char object_map[240];
+extern char object_index[240];
+extern char thor_icon1,thor_icon2,thor_icon3,thor_icon4;
+extern char level_type;
+extern char music_current;
+extern char boss_loaded;
+extern char apple_drop;
+extern char area;
+extern char last_setup[32];
+extern LEVEL scrn;
+extern char eyeballs;
+extern char far *sd_data;
+extern int current_level,new_level,new_level_tile,current_area;
+extern SETUP setup;
+extern ACTOR actor[MAX_ACTORS];
+extern ACTOR enemy[MAX_ENEMIES];
+extern ACTOR shot[MAX_ENEMIES];
+extern char enemy_type[MAX_ENEMIES];
+extern int boss_intro1,boss_intro2;
+extern ACTOR magic_item[2];
+extern char magic_pic[2][1024];
+extern char warp_scroll;
+extern ACTOR explosion;
+extern ACTOR sparkle;
+extern THOR_INFO thor_info;
+extern int boss_dead;
+extern int warp_flag;
+extern int rand1,rand2;
+extern int restore_screen;
+extern int last_oracle;
+extern int hourglass_flag,thunder_flag,shield_on,lightning_used,tornado_used;
+extern int apple_flag,bomb_flag;
+extern int switch_flag;
+extern int load_game_flag;
+extern int cash1_inform,cash2_inform,door_inform,magic_inform,carry_inform;
+extern int killgg_inform;
+extern int boss_active;
+extern int demo_cnt;
+extern int rnd_index;
+extern char game_over;
+extern char end_tile;
+extern int endgame;
+extern int game_is_over;
+extern uint32_t game_rand_seed;
+
+extern int etype[MAX_ENEMIES];             //image.c
+extern unsigned int latch_mem;
+extern char slip_flag,slip_cnt,slipping;   //movpat.c
+extern char diag_flag,thor_special_flag;
+//============================= Globals ==================================
+#define SNAP_MAGIC   0x50414e53l      //"SNAP"
+#define SNAP_VERSION 1
+#define SNAP_ALIGN   8                //every region starts 8-aligned
+
+enum{SNAP_SIZE,SNAP_SAVE,SNAP_LOAD,SNAP_FIND};
+
+typedef struct{
+  long magic;
+  long version;
+  long episode;
+  long area;
+  long size;                          //whole snapshot, header included
+} SNAP_HEAD;
+
+static int   snap_mode;
+static char *snap_buf;
+static long  snap_pos;
+static long  snap_find;               //SNAP_FIND: offset looked for
+static const char *snap_found;        //and the region holding it
+
+/* State that goes through a copy rather than straight into the game. */
+static char snap_boss,snap_music;
+static GOT_CLOCK_STATE snap_clock;
+static mu_position snap_mu;
+static unsigned char snap_opl[256];
+//=========================================================================
+static char *snap_next(const char *name,long len){
+char *p;
+long end,next;
+
+p=snap_buf ? snap_buf+snap_pos : NULL;
+end=snap_pos+len;
+next=(end+SNAP_ALIGN-1) & ~(long) (SNAP_ALIGN-1);
+if(snap_mode==SNAP_SAVE) memset(snap_buf+end,0,next-end);
+if(snap_mode==SNAP_FIND && snap_find>=snap_pos && snap_find<end) snap_found=name;
+snap_pos=next;
+return p;
+}
+//=========================================================================
+void snapshot_region(const char *name,void *p,long len){
+char *b;
+
+b=snap_next(name,len);
+if(snap_mode==SNAP_SAVE) memcpy(b,p,len);
+else if(snap_mode==SNAP_LOAD) memcpy(p,b,len);
+}
+//=========================================================================
+/* Actor tables: saved with each alignment as atlas index + 1 (0 = none),
+   restored with the pointers looked up again. */
+static void snap_actors(const char *name,ACTOR *a,int n){
+ACTOR *b;
+ALIGNED_MASK_IMAGE **m,**end,*last_p;
+const SpriteFrame *f;
+size_t idx,last_i;
+long at;
+
+at=snap_pos;
+snapshot_region(name,a,(long) n*sizeof(ACTOR));
+if(snap_mode==SNAP_SAVE) b=(ACTOR *) (snap_buf+at);
+else if(snap_mode==SNAP_LOAD) b=a;
+else return;
+
+last_i=0;
+last_p=NULL;
+for(;n>0;n--,b++){
+   m=&b->pic[0][0].alignments[0];
+   end=m+16*4;
+   for(;m<end;m++){
+      if(snap_mode==SNAP_SAVE){
+        *m=(ALIGNED_MASK_IMAGE *) (size_t) (*m ? (*m)->image_ptr+1 : 0);
+        continue;
+      }
+      idx=(size_t) *m;
+      if(idx!=last_i){
+        f=idx ? sprite_atlas_frame((unsigned int) (idx-1)) : NULL;
+        last_p=f ? (ALIGNED_MASK_IMAGE *) &f->mask : NULL;
+        last_i=idx;
+      }
+      *m=idx ? last_p : NULL;
+   }
+}
+}
+//=========================================================================
+static size_t name_index(char *name){
+int i;
+
+if(!name) return 0;
+for(i=0;i<ep->num_objects;i++) if(ep->object_names[i]==name) return i+1;
+return 0;
+}
+//=========================================================================
+static char *name_pointer(char *saved){
+size_t i;
+
+i=(size_t) saved;
+if(i<1 || i>(size_t) ep->num_objects) return NULL;
+return ep->object_names[i-1];
+}
+//=========================================================================
+static void snap_thor_info(void){
+THOR_INFO *t;
+long at;
+
+at=snap_pos;
+SNAPSHOT_VAR(thor_info);
+if(snap_mode==SNAP_SAVE) t=(THOR_INFO *) (snap_buf+at);
+else if(snap_mode==SNAP_LOAD) t=&thor_info;
+else return;
+if(snap_mode==SNAP_SAVE){
+  t->object_name=(char *) name_index(t->object_name);
+  t->last_object_name=(char *) name_index(t->last_object_name);
+}
+else{
+  t->object_name=name_pointer(t->object_name);
+  t->last_object_name=name_pointer(t->last_object_name);
+}
+}
+//=========================================================================
+static void snap_native(void){
+long len;
+char *p;
+
+if(snap_mode==SNAP_SAVE){
+  got_clock_save(&snap_clock);
+  MU_GetPosition(&snap_mu);
+  got_adlib_save_regs(snap_opl);
+}
+SNAPSHOT_VAR(snap_clock);
+SNAPSHOT_VAR(snap_mu);
+SNAPSHOT_VAR(snap_opl);
+len=got_platform_video_state_size();
+p=snap_next("video",len);
+if(snap_mode==SNAP_SAVE) got_platform_video_save(p);
+if(snap_mode!=SNAP_LOAD) return;
+
+got_clock_restore(&snap_clock);
+if(snap_music!=music_current){
+  if(snap_music!=(char)-1) music_play(snap_music,0);  //char is unsigned
+  else music_pause();
+}
+if(snap_music==music_current) MU_SetPosition(&snap_mu);
+music_current=snap_music;
+got_adlib_restore_regs(snap_opl);
+got_platform_video_restore(p);
+}
+//=========================================================================
+static void snap_walk(void){
+
+//main loop and paging
+SNAPSHOT_VAR(display_page);
+SNAPSHOT_VAR(draw_page);
+SNAPSHOT_VAR(page3_offset);
+SNAPSHOT_VAR(pge);
+SNAPSHOT_VAR(exit_flag);
+SNAPSHOT_VAR(shot_ok);
+SNAPSHOT_VAR(timer_cnt);
+SNAPSHOT_VAR(vbl_cnt);
+SNAPSHOT_VAR(magic_cnt);
+SNAPSHOT_VAR(extra_cnt);
+SNAPSHOT_VAR(demo_cnt);
+SNAPSHOT_VAR(rnd_index);
+SNAPSHOT_VAR(rand1);
+SNAPSHOT_VAR(rand2);
+SNAPSHOT_VAR(game_rand_seed);
+//input as the game last saw it
+SNAPSHOT_VAR(key_flag);
+SNAPSHOT_VAR(joy_flag);
+SNAPSHOT_VAR(tmp_flag);
+SNAPSHOT_VAR(break_code);
+SNAPSHOT_VAR(scan_code);
+SNAPSHOT_VAR(last_scan_code);
+SNAPSHOT_VAR(diag);
+SNAPSHOT_VAR(slow_mode);
+//level
+SNAPSHOT_VAR(scrn);
+SNAPSHOT_VAR(current_level);
+SNAPSHOT_VAR(new_level);
+SNAPSHOT_VAR(new_level_tile);
+SNAPSHOT_VAR(current_area);
+SNAPSHOT_VAR(level_type);
+SNAPSHOT_VAR(object_map);
+SNAPSHOT_VAR(object_index);
+SNAPSHOT_VAR(ox);
+SNAPSHOT_VAR(oy);
+SNAPSHOT_VAR(of);
+SNAPSHOT_VAR(last_setup);
+SNAPSHOT_VAR(setup);
+if(sd_data) snapshot_region("sd_data",sd_data,61440l);
+//actors
+snap_actors("actor",actor,MAX_ACTORS);
+snap_actors("enemy",enemy,MAX_ENEMIES);
+snap_actors("shot",shot,MAX_ENEMIES);
+snap_actors("magic_item",magic_item,2);
+snap_actors("explosion",&explosion,1);
+snap_actors("sparkle",&sparkle,1);
+SNAPSHOT_VAR(enemy_type);
+SNAPSHOT_VAR(etype);
+SNAPSHOT_VAR(latch_mem);
+SNAPSHOT_VAR(magic_pic);
+SNAPSHOT_VAR(max_shot);
+//player
+snap_thor_info();
+SNAPSHOT_VAR(thor_x1);
+SNAPSHOT_VAR(thor_y1);
+SNAPSHOT_VAR(thor_x2);
+SNAPSHOT_VAR(thor_y2);
+SNAPSHOT_VAR(thor_real_y1);
+SNAPSHOT_VAR(thor_pos);
+SNAPSHOT_VAR(thor_icon1);
+SNAPSHOT_VAR(thor_icon2);
+SNAPSHOT_VAR(thor_icon3);
+SNAPSHOT_VAR(thor_icon4);
+SNAPSHOT_VAR(slip_flag);
+SNAPSHOT_VAR(slip_cnt);
+SNAPSHOT_VAR(slipping);
+SNAPSHOT_VAR(diag_flag);
+SNAPSHOT_VAR(thor_special_flag);
+//magic and items
+SNAPSHOT_VAR(hourglass_flag);
+SNAPSHOT_VAR(thunder_flag);
+SNAPSHOT_VAR(shield_on);
+SNAPSHOT_VAR(lightning_used);
+SNAPSHOT_VAR(tornado_used);
+SNAPSHOT_VAR(apple_flag);
+SNAPSHOT_VAR(apple_drop);
+SNAPSHOT_VAR(bomb_flag);
+SNAPSHOT_VAR(switch_flag);
+SNAPSHOT_VAR(cash1_inform);
+SNAPSHOT_VAR(cash2_inform);
+SNAPSHOT_VAR(door_inform);
+SNAPSHOT_VAR(magic_inform);
+SNAPSHOT_VAR(carry_inform);
+SNAPSHOT_VAR(killgg_inform);
+//bosses, warps and the end of the game
+SNAPSHOT_VAR(boss_dead);
+SNAPSHOT_VAR(boss_active);
+SNAPSHOT_VAR(boss_intro1);
+SNAPSHOT_VAR(boss_intro2);
+SNAPSHOT_VAR(eyeballs);
+SNAPSHOT_VAR(warp_flag);
+SNAPSHOT_VAR(warp_scroll);
+SNAPSHOT_VAR(restore_screen);
+SNAPSHOT_VAR(last_oracle);
+SNAPSHOT_VAR(load_game_flag);
+SNAPSHOT_VAR(end_tile);
+SNAPSHOT_VAR(endgame);
+SNAPSHOT_VAR(game_is_over);
+SNAPSHOT_VAR(game_over);
+boss1_snapshot();
+boss2_snapshot();
+boss3_snapshot();
+object_snapshot();
+//resources: reloaded by snap_native() / snapshot_restore() if they differ
+if(snap_mode==SNAP_SAVE){
+  snap_boss=boss_loaded;
+  snap_music=music_current;
+}
+SNAPSHOT_VAR(snap_boss);
+SNAPSHOT_VAR(snap_music);
+snap_native();
+}
+//=========================================================================
+long snapshot_size(void){
+
+snap_mode=SNAP_SIZE;
+snap_buf=NULL;
+snap_pos=sizeof(SNAP_HEAD);
+snap_walk();
+return snap_pos;
+}
+//=========================================================================
+long snapshot_save(void *buf,long size){
+SNAP_HEAD *h;
+long len;
+
+len=snapshot_size();
+if(!buf || size<len) return 0;
+h=(SNAP_HEAD *) buf;
+memset(h,0,sizeof(SNAP_HEAD));
+h->magic=SNAP_MAGIC;
+h->version=SNAP_VERSION;
+h->episode=g_episode;
+h->area=area;
+h->size=len;
+snap_mode=SNAP_SAVE;
+snap_buf=(char *) buf;
+snap_pos=sizeof(SNAP_HEAD);
+snap_walk();
+snap_buf=NULL;
+return len;
+}
+//=========================================================================
+int snapshot_restore(const void *buf,long len){
+const SNAP_HEAD *h;
+
+h=(const SNAP_HEAD *) buf;
+if(!buf || len<(long) sizeof(SNAP_HEAD)) return -1;
+if(h->magic!=SNAP_MAGIC || h->version!=SNAP_VERSION) return -1;
+if(h->episode!=g_episode || h->area!=area) return -1;
+if(h->size>len || h->size!=snapshot_size()) return -1;
+
+snap_mode=SNAP_LOAD;
+snap_buf=(char *) buf;
+snap_pos=sizeof(SNAP_HEAD);
+snap_walk();
+snap_buf=NULL;
+if(snap_boss && snap_boss!=boss_loaded) setup_boss(snap_boss);
+return 0;
+}
+//=========================================================================
+// got --replay FILE --check-snapshot N
+//=========================================================================
+static int   chk_every;
+static long  chk_frame;               //frame counter, rewound with the state
+static long  chk_start;               //frame of chk_a, -1 = none
+static int   chk_rerun;               //playing chk_start.. the second time
+static long  chk_size;
+static char *chk_a,*chk_b,*chk_c;     //segment start, end, end again
+static GOT_REPLAY_MARK chk_mark;
+static long  chk_segments,chk_saves,chk_restores;
+static double chk_save_s,chk_restore_s;
+
+static void check_report(void){
+
+if(!chk_every || !chk_saves) return;
+printf("snapshot: %ld bytes, %ld segments played twice\n",chk_size,chk_segments);
+printf("snapshot: save %.1f us, restore %.1f us\n",
+       chk_save_s*1e6/chk_saves,chk_restores ? chk_restore_s*1e6/chk_restores : 0.0);
+}
+//=========================================================================
+void snapshot_check_every(int frames){
+
+if(frames<=0) return;
+chk_every=frames;
+chk_start=-1;
+atexit(check_report);
+}
+//=========================================================================
+static int check_save(char *buf){
+double t;
+
+t=got_clock_wall_s();
+if(!snapshot_save(buf,chk_size)) return 0;
+chk_save_s+=got_clock_wall_s()-t;
+chk_saves++;
+return 1;
+}
+//=========================================================================
+static void check_differs(void){
+static char why[96];
+long i;
+
+for(i=0;i<chk_size && chk_b[i]==chk_c[i];i++);
+snap_mode=SNAP_FIND;
+snap_buf=NULL;
+snap_find=i;
+snap_found="header";
+snap_pos=sizeof(SNAP_HEAD);
+snap_walk();
+sprintf(why,"state after a snapshot restore differs, in %s",snap_found);
+got_replay_fail(why);
+}
+//=========================================================================
+void snapshot_check_frame(void){
+double t;
+
+if(!chk_every || got_replay_mode()!=GOT_REPLAY_PLAY || got_replay_done()) return;
+if(chk_start>=0 && chk_frame==chk_start+chk_every){
+  if(snapshot_size()!=chk_size){               //layout changed: start over
+    chk_start=-1;
+    chk_rerun=0;
+  }
+  else if(!chk_rerun){
+    if(!check_save(chk_b)) return;
+    t=got_clock_wall_s();
+    if(snapshot_restore(chk_a,chk_size)<0){
+      got_replay_fail("snapshot: restore refused");
+      return;
+    }
+    chk_restore_s+=got_clock_wall_s()-t;
+    chk_restores++;
+    got_replay_seek(&chk_mark);
+    chk_frame=chk_start+1;
+    chk_rerun=1;
+    return;
+  }
+  else{
+    if(!check_save(chk_c)) return;
+    if(memcmp(chk_b,chk_c,chk_size)){
+      check_differs();
+      return;
+    }
+    chk_segments++;
+    chk_rerun=0;
+  }
+}
+if(chk_frame%chk_every==0 && !chk_rerun){
+  if(snapshot_size()!=chk_size){
+    chk_size=snapshot_size();
+    free(chk_a);
+    free(chk_b);
+    free(chk_c);
+    chk_a=(char *) malloc(chk_size);
+    chk_b=(char *) malloc(chk_size);
+    chk_c=(char *) malloc(chk_size);
+  }
+  if(!chk_a || !chk_b || !chk_c || !check_save(chk_a)){
+    got_replay_fail("snapshot: out of memory");
+    return;
+  }
+  got_replay_mark(&chk_mark);
+  chk_start=chk_frame;
+}
+chk_frame++;
+}
@@ -0,0 +1,50 @@
+/* snapshot.h - In-memory savestates for God of Thunder (native build)
+ *
+ * snapshot_save() copies everything the game carries from one main loop
+ * frame to the next into one flat buffer and snapshot_restore() puts it
+ * back: the actor tables, player and level state, the screen data of the
+ * area, the module variables of the boss and object code, the game's
+ * rand() state, the virtual clock, the music sequencer position and OPL
+ * registers, and the video pages and palette. Sprite frame pointers
+ * (MASK_IMAGE) and object names are stored as sprite atlas and name table
+ * indexes and turned back into pointers on restore.
+ *
+ * Take and restore snapshots between main loop frames (where
+ * demo_key_set() runs); a snapshot only restores into the run, episode
+ * and screen layout it was taken in. Digitized sound effects are output
+ * only and play on. So does a song streamed from the music cache
+ * (music_cache.h): its position lives in the mixer's stream, not in the
+ * sequencer, so a restore into the same song leaves it where it is and
+ * one into another song starts that song from the top.
+ */
+#ifndef GOT_SNAPSHOT_H
+#define GOT_SNAPSHOT_H
+
+/* Bytes a snapshot of the current game takes. */
+long snapshot_size(void);
+
+/* Writes a snapshot into buf; the bytes written, or 0 if size is too
+   small. */
+long snapshot_save(void *buf, long size);
+
+/* Restores a snapshot. 0 on success, -1 (nothing changed) if buf doesn't
+   hold a snapshot this game can take back. */
+int snapshot_restore(const void *buf, long len);
+
+/* --check-snapshot N with --replay: every N frames save a snapshot, play
+   N frames, restore it and play them again; the second pass must end in
+   the same state and pass the same replay checkpoints. */
+void snapshot_check_every(int frames);
+void snapshot_check_frame(void);
+
+/* Module state kept in file statics: each hands its variables to
+   snapshot_region() (snapshot.c walks them in this order). */
+void snapshot_region(const char *name, void *p, long len);
+#define SNAPSHOT_VAR(v) snapshot_region(#v, (void *)&(v), (long)sizeof(v))
+
+void boss1_snapshot(void);
+void boss2_snapshot(void);
+void boss3_snapshot(void);
+void object_snapshot(void);
+
+#endif /* GOT_SNAPSHOT_H */
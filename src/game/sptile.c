@@ -8,6 +8,9 @@
 
 #include "game_define.h"
 #include "game_proto.h"
+#ifdef __llvm__
+#include "tile_cache.h"
+#endif
 //===========================================================================
 extern int new_level,current_level,new_level_tile;
 extern int warp_flag;
@@ -310,6 +313,9 @@ return 0;
 void erase_door(int x,int y){
 
 play_sound(DOOR,0);
+#ifdef __llvm__
+tile_cache_set_cell(bg_pics,scrn.bg_color,&scrn.icon[0][0],g_episode == 2,x,y,scrn.bg_color);
+#endif
 scrn.icon[y][x]=scrn.bg_color;
 x=x<<4;
 y=y<<4;
@@ -3,6 +3,9 @@
 #include "adlib_native.h"
 #include "opl2_emu.h"
 #include "mixer.h"
+#include "music_cache.h"
+
+#include <string.h>
 
 /*
   SB_ALOut / SB_AL_ResetChannels are part of the original game's AdLib layer.
@@ -12,6 +15,9 @@
 */
 
 static int g_opl2_inited = 0;
+static int g_streaming = 0;
+/* Every register as last written, for savestates. */
+static uint8_t g_regs[256];
 
 static void ensure_init(void) {
   if (!g_opl2_inited) {
@@ -22,6 +28,7 @@ static void ensure_init(void) {
 
 void SB_ALOut(unsigned char reg, unsigned char val) {
   ensure_init();
+  g_regs[reg] = (uint8_t)val;
   opl2_write((uint8_t)reg, (uint8_t)val);
 }
 
@@ -31,10 +38,10 @@ void SB_AL_ResetChannels(void) {
 
   /* Match src/utility/adlib.c semantics: disable rhythm mode and key-off
      channels 1..9 (channel 0 reserved for SFX in the original). */
-  opl2_write((uint8_t)0xBD, (uint8_t)0);
+  SB_ALOut(0xBD, 0);
 
   for (i = 0; i < 10; i++) {
-    opl2_write((uint8_t)(0xB1 + (uint8_t)i), (uint8_t)0);
+    SB_ALOut((unsigned char)(0xB1 + i), 0);
   }
 }
 
@@ -45,9 +52,40 @@ int got_adlib_sample_rate(void) {
 void got_adlib_reset(void) {
   opl2_init();
   g_opl2_inited = 1;
+  memset(g_regs, 0, sizeof(g_regs));
 }
 
 void got_adlib_generate(int16_t* buf, int samples) {
   ensure_init();
   opl2_generate(buf, samples);
 }
+
+void got_adlib_tick(void) {
+  opl2_tick();
+}
+
+int got_adlib_music_start(const char* song, long length) {
+  MusicStream* s = music_cache_lookup(song, length);
+  if (s || g_streaming) mixer_play_music(s);
+  g_streaming = s ? 1 : 0;
+  return g_streaming;
+}
+
+void got_adlib_music_pause(int paused) {
+  if (g_streaming) mixer_pause_music(paused);
+}
+
+void got_adlib_save_regs(uint8_t regs[256]) {
+  memcpy(regs, g_regs, sizeof(g_regs));
+}
+
+void got_adlib_restore_regs(const uint8_t regs[256]) {
+  int i;
+  /* Key-on bits (B0..B8) last, once the voices they start are set up. */
+  for (i = 0; i < 256; i++) {
+    if ((i < 0xB0 || i > 0xB8) && regs[i] != g_regs[i]) SB_ALOut((unsigned char)i, regs[i]);
+  }
+  for (i = 0xB0; i <= 0xB8; i++) {
+    if (regs[i] != g_regs[i]) SB_ALOut((unsigned char)i, regs[i]);
+  }
+}
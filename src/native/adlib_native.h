@@ -16,6 +16,19 @@
 int  got_adlib_sample_rate(void);
 void got_adlib_reset(void);
 void got_adlib_generate(int16_t* buf, int samples);
+/* Advance the OPL write timestamp by one 120Hz tick (game thread). */
+void got_adlib_tick(void);
+
+/* MU_StartMusic(): stream the song's pre-rendered copy (music_cache.h) if
+   there is one. Returns 1 when streaming, 0 to play it on the emulator. */
+int  got_adlib_music_start(const char* song, long length);
+/* MU_MusicOff()/MU_MusicOn() while streaming. */
+void got_adlib_music_pause(int paused);
+
+/* Savestates (game/snapshot.c): the OPL2 registers as the game last wrote
+   them, and writing back the ones that differ. */
+void got_adlib_save_regs(uint8_t regs[256]);
+void got_adlib_restore_regs(const uint8_t regs[256]);
 
 #endif /* ADLIB_NATIVE_H_ */
 
@@ -0,0 +1,354 @@
+#include "audio_stress.h"
+#include "got_clock.h"
+#include "mixer.h"
+#include "opl2_emu.h"
+#include "spsc_ring.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__EMSCRIPTEN__) || defined(_WIN32)
+
+int audio_stress_run(int seconds) {
+  (void)seconds;
+  printf("audio stress: needs POSIX threads and signals, not available here\n");
+  return 1;
+}
+
+#else
+
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
+
+enum {
+  STRESS_RING_ITEMS = 4000000,
+  STRESS_RING_CAP = 64,
+  STRESS_CB_FRAMES = 512,
+  /* Callbacks the audio thread must finish while the game thread is parked. */
+  STRESS_FREEZE_CALLBACKS = 8,
+  STRESS_FREEZE_TIMEOUT_MS = 1000
+};
+
+/* --- 1. ring ordering --- */
+
+static SpscRing g_seq_ring;
+static uint32_t g_seq_slots[STRESS_RING_CAP];
+
+static void* seq_producer(void* arg) {
+  uint32_t v;
+  (void)arg;
+  for (v = 1; v <= STRESS_RING_ITEMS; v++) {
+    while (!spsc_push(&g_seq_ring, &v)) sched_yield();
+  }
+  return NULL;
+}
+
+static int stress_ring_order(void) {
+  pthread_t th;
+  uint32_t expect = 1, v, errors = 0;
+  double t0;
+
+  spsc_init(&g_seq_ring, g_seq_slots, sizeof(uint32_t), STRESS_RING_CAP);
+  t0 = got_clock_wall_s();
+  if (pthread_create(&th, NULL, seq_producer, NULL) != 0) {
+    printf("audio stress: pthread_create failed\n");
+    return 1;
+  }
+  while (expect <= STRESS_RING_ITEMS) {
+    if (!spsc_pop(&g_seq_ring, &v)) {
+      sched_yield();
+      continue;
+    }
+    if (v != expect) errors++;
+    expect = v + 1u;
+  }
+  pthread_join(th, NULL);
+
+  printf("ring:  %lu items through a %lu-slot ring in %.0f ms, %lu out of order\n",
+         (unsigned long)STRESS_RING_ITEMS, (unsigned long)STRESS_RING_CAP,
+         (got_clock_wall_s() - t0) * 1000.0, (unsigned long)errors);
+  return errors ? 1 : 0;
+}
+
+/* --- 2. mixer under a frozen game thread --- */
+
+static volatile uint32_t g_stop;
+static volatile uint32_t g_callbacks;
+static volatile uint32_t g_frozen;
+static volatile uint32_t g_thaw;
+static double g_cb_max_s;
+static pthread_t g_game_thread;
+static unsigned long g_game_ops;
+static unsigned long g_finished_calls;
+static unsigned long g_finished_wrong_thread;
+/* Every OPL register as the game thread last wrote it. */
+static uint8_t g_opl_val[256];
+static uint8_t g_opl_set[256];
+/* The mixer controls as the game thread last set them. */
+static uint16_t g_ctl_divisor;
+static int g_ctl_opl2 = -1;
+static int g_ctl_paused = -1;
+
+static void* audio_thread(void* arg) {
+  static int16_t buf[STRESS_CB_FRAMES];
+  (void)arg;
+  while (!spsc_atomic_load(&g_stop)) {
+    double t0 = got_clock_wall_s();
+    double dt;
+    mixer_generate(buf, STRESS_CB_FRAMES);
+    dt = got_clock_wall_s() - t0;
+    if (dt > g_cb_max_s) g_cb_max_s = dt;
+    spsc_atomic_store(&g_callbacks, spsc_atomic_load(&g_callbacks) + 1u);
+  }
+  return NULL;
+}
+
+static void on_sound_finished(void) {
+  g_finished_calls++;
+  if (!pthread_equal(pthread_self(), g_game_thread)) g_finished_wrong_thread++;
+}
+
+/* Parks the game thread wherever the signal lands: mid-push, inside
+   malloc(), anywhere. */
+static void freeze_handler(int sig) {
+  struct timespec ts;
+  (void)sig;
+  ts.tv_sec = 0;
+  ts.tv_nsec = 100000;
+  spsc_atomic_store(&g_frozen, 1);
+  while (!spsc_atomic_load(&g_thaw)) nanosleep(&ts, NULL);
+  spsc_atomic_store(&g_frozen, 0);
+}
+
+static void* game_thread(void* arg) {
+  uint32_t rng = 12345u;
+  (void)arg;
+  mixer_set_sound_finished_callback(on_sound_finished);
+  while (!spsc_atomic_load(&g_stop)) {
+    uint32_t r;
+    rng = rng * 1103515245u + 12345u;
+    r = rng >> 8;
+    switch (r % 8u) {
+      case 0: {
+        uint32_t frames = 64u + (r >> 4) % 4096u;
+        int16_t* pcm = (int16_t*)malloc(frames * sizeof(int16_t));
+        if (pcm) {
+          uint32_t i;
+          for (i = 0; i < frames; i++) pcm[i] = (int16_t)(i * 97u);
+          mixer_play_pcm16(pcm, frames, 8000u + (r >> 3) % 14000u, (int)(r & 1u));
+        }
+        break;
+      }
+      case 1:
+        mixer_stop_sample((int)((r >> 5) & 1u));
+        break;
+      case 2:
+        g_ctl_divisor = (uint16_t)((r >> 4) & 0x1fffu);
+        mixer_set_pc_divisor(g_ctl_divisor);
+        break;
+      case 3:
+      case 4: {
+        uint8_t reg = (uint8_t)(0x20u + (r >> 4) % 0xd6u);
+        opl2_write(reg, (uint8_t)(r >> 12));
+        g_opl_val[reg] = (uint8_t)(r >> 12);
+        g_opl_set[reg] = 1;
+        break;
+      }
+      case 5:
+        (void)mixer_is_sample_playing();
+        (void)mixer_is_voc_playing();
+        break;
+      case 6:
+        if (r & 0x10u) {
+          g_ctl_opl2 = (int)((r >> 5) & 1u);
+          mixer_set_opl2_enabled(g_ctl_opl2);
+        } else {
+          g_ctl_paused = (int)((r >> 5) & 1u);
+          mixer_pause_music(g_ctl_paused);
+        }
+        break;
+      default:
+        mixer_service();
+        break;
+    }
+    g_game_ops++;
+  }
+  return NULL;
+}
+
+static int wait_u32(volatile uint32_t* p, uint32_t want, int timeout_ms) {
+  double until = got_clock_wall_s() + timeout_ms / 1000.0;
+  while (spsc_atomic_load(p) != want) {
+    if (got_clock_wall_s() > until) return 0;
+    sched_yield();
+  }
+  return 1;
+}
+
+/* With both threads stopped: overfill the OPL ring with nothing draining
+   it, let the held and queued writes through and count the registers the
+   chip doesn't have as last written. */
+static int opl_registers_lost(void) {
+  uint8_t applied[256];
+  int i, lost = 0;
+  for (i = 0; i < 16384; i++) {
+    uint8_t reg = (uint8_t)(0x20 + i % 0xd6);
+    opl2_write(reg, (uint8_t)(i / 0xd6));
+    g_opl_val[reg] = (uint8_t)(i / 0xd6);
+    g_opl_set[reg] = 1;
+  }
+  for (i = 0; i < 64 || (opl2_held_writes() && i < 4096); i++) {
+    opl2_tick();
+    opl2_skip(8192);
+  }
+  opl2_applied_regs(applied);
+  for (i = 0; i < 256; i++) {
+    if (g_opl_set[i] && applied[i] != g_opl_val[i]) lost++;
+  }
+  return lost;
+}
+
+/* With both threads stopped: overfill the command ring with nothing
+   draining it, let the held and queued commands through and count the
+   controls the audio side doesn't have as last set. */
+static int mixer_controls_lost(void) {
+  static int16_t buf[STRESS_CB_FRAMES];
+  MixerControls c;
+  uint32_t rng = 54321u, r;
+  int i, playing = mixer_is_sample_playing(), lost = 0;
+  for (i = 0; i < 4096; i++) {
+    rng = rng * 1103515245u + 12345u;
+    r = rng >> 8;
+    switch (r % 5u) {
+      case 0: {
+        /* Long enough to still be playing when the check runs. */
+        int16_t* pcm = (int16_t*)calloc(65536u, sizeof(int16_t));
+        if (pcm) {
+          mixer_play_pcm16(pcm, 65536u, 4000u, 0);
+          playing = 1;
+        }
+        break;
+      }
+      case 1:
+        mixer_stop_sample(0);
+        playing = 0;
+        break;
+      case 2:
+        g_ctl_divisor = (uint16_t)((r >> 4) & 0x1fffu);
+        mixer_set_pc_divisor(g_ctl_divisor);
+        break;
+      case 3:
+        g_ctl_opl2 = (int)((r >> 4) & 1u);
+        mixer_set_opl2_enabled(g_ctl_opl2);
+        break;
+      default:
+        g_ctl_paused = (int)((r >> 4) & 1u);
+        mixer_pause_music(g_ctl_paused);
+        break;
+    }
+  }
+  for (i = 0; i < 64 || (mixer_held_commands() && i < 4096); i++) {
+    mixer_service();
+    mixer_generate(buf, STRESS_CB_FRAMES);
+  }
+  mixer_get_controls(&c);
+  if (c.sample_seq != (playing ? c.play_seq : 0u)) lost++;
+  if (c.pc_divisor != g_ctl_divisor) lost++;
+  if (g_ctl_opl2 >= 0 && c.opl2_enabled != g_ctl_opl2) lost++;
+  if (g_ctl_paused >= 0 && c.music_paused != g_ctl_paused) lost++;
+  return lost;
+}
+
+static int stress_mixer(int seconds) {
+  pthread_t audio;
+  struct sigaction sa;
+  double until;
+  unsigned long freezes = 0;
+  uint32_t stalls = 0, sent = 0, coalesced = 0;
+  int err = 0, lost, dropped;
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = freeze_handler;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGUSR1, &sa, NULL);
+
+  mixer_init(44100);
+  opl2_init();
+
+  g_stop = 0;
+  g_callbacks = 0;
+  if (pthread_create(&audio, NULL, audio_thread, NULL) != 0 ||
+      pthread_create(&g_game_thread, NULL, game_thread, NULL) != 0) {
+    printf("audio stress: pthread_create failed\n");
+    return 1;
+  }
+
+  /* Let the first callbacks do their one-time setup (OPL2 output buffer). */
+  got_clock_sleep_ms(50);
+
+  until = got_clock_wall_s() + seconds;
+  while (got_clock_wall_s() < until) {
+    uint32_t c0;
+    spsc_atomic_store(&g_thaw, 0);
+    pthread_kill(g_game_thread, SIGUSR1);
+    if (!wait_u32(&g_frozen, 1, STRESS_FREEZE_TIMEOUT_MS)) {
+      printf("audio stress: game thread did not park\n");
+      err = 1;
+      break;
+    }
+    c0 = spsc_atomic_load(&g_callbacks);
+    {
+      double t_end = got_clock_wall_s() + STRESS_FREEZE_TIMEOUT_MS / 1000.0;
+      while (spsc_atomic_load(&g_callbacks) - c0 < STRESS_FREEZE_CALLBACKS) {
+        if (got_clock_wall_s() > t_end) {
+          stalls++;
+          break;
+        }
+        sched_yield();
+      }
+    }
+    spsc_atomic_store(&g_thaw, 1);
+    wait_u32(&g_frozen, 0, STRESS_FREEZE_TIMEOUT_MS);
+    freezes++;
+    got_clock_sleep_ms(20);
+  }
+
+  spsc_atomic_store(&g_thaw, 1);
+  spsc_atomic_store(&g_stop, 1);
+  pthread_join(g_game_thread, NULL);
+  pthread_join(audio, NULL);
+
+  mixer_set_sound_finished_callback(NULL);
+  lost = opl_registers_lost();
+  dropped = mixer_controls_lost();
+  mixer_get_stats(&sent, &coalesced);
+  mixer_shutdown();
+
+  printf("mixer: %lu game ops, %lu callbacks, worst callback %.3f ms\n",
+         g_game_ops, (unsigned long)g_callbacks, g_cb_max_s * 1000.0);
+  printf("       %lu commands queued, %lu coalesced while the ring was full, %d controls lost\n",
+         (unsigned long)sent, (unsigned long)coalesced, dropped);
+  printf("       %lu OPL writes coalesced while the ring was full, %d registers lost\n",
+         (unsigned long)opl2_coalesced_writes(), lost);
+  printf("       %lu finished callbacks, %lu off the game thread\n",
+         g_finished_calls, g_finished_wrong_thread);
+  printf("       %lu freezes of the game thread, %lu audio stalls\n",
+         freezes, (unsigned long)stalls);
+
+  if (stalls || g_finished_wrong_thread || lost || dropped) err = 1;
+  return err;
+}
+
+int audio_stress_run(int seconds) {
+  int err;
+  if (seconds <= 0) seconds = 5;
+  err = stress_ring_order();
+  err |= stress_mixer(seconds);
+  printf("audio stress: %s\n", err ? "FAILED" : "ok");
+  return err;
+}
+
+#endif
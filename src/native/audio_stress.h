@@ -0,0 +1,17 @@
+#ifndef AUDIO_STRESS_H
+#define AUDIO_STRESS_H
+
+/* Audio threading stress check (got --stress-audio [seconds]).
+
+   1. Pushes a counted sequence through an SpscRing between two threads and
+      checks it arrives complete and in order.
+   2. Runs mixer_generate() flat out on an "audio" thread while a "game"
+      thread hammers the mixer/OPL2 control API. Every ~20ms the game thread
+      is frozen at an arbitrary instruction (signal handler parks it) and the
+      audio thread must keep completing callbacks; if it ever waited on
+      anything the game thread holds, it would stall and the check fails.
+
+   Prints a summary to stdout. Returns 0 on success. POSIX only. */
+int audio_stress_run(int seconds);
+
+#endif
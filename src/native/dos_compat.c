@@ -1,4 +1,5 @@
 #include "dos.h"
+#include "got_clock.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -25,6 +26,10 @@ typedef long ssize_t;
 #endif
 
 void delay(unsigned ms) {
+  /* delay() is game time: it moves the virtual clock, and only sleeps when
+     the clock is pacing against the wall clock. */
+  got_clock_advance_ms(ms);
+  if (got_clock_mode() != GOT_CLOCK_REALTIME) return;
 #ifdef __EMSCRIPTEN__
   /* On the web, long busy-waits freeze the tab. Yield with emscripten_sleep()
      (requires ASYNCIFY). For very small delays keep a short spin to avoid
@@ -0,0 +1,162 @@
+#include "got_clock.h"
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#include <unistd.h>
+#endif
+
+/* Virtual time is kept in integer units of 1/42000s so a 70Hz frame (600),
+   a 120Hz tick (350) and a millisecond (42) are all exact. */
+enum {
+  CLOCK_UNITS_PER_SEC = 42000,
+  CLOCK_UNITS_PER_FRAME = CLOCK_UNITS_PER_SEC / 70,
+  CLOCK_UNITS_PER_TICK = CLOCK_UNITS_PER_SEC / 120,
+  CLOCK_UNITS_PER_MS = CLOCK_UNITS_PER_SEC / 1000
+};
+
+/* Frames of wall-clock debt tolerated before the realtime anchor is moved.
+   Large gaps happen during level loading; without this cap the following
+   scroll/transition frames would burn through the debt instantly, making the
+   animation invisible. */
+#define CLOCK_MAX_DEBT_FRAMES 2
+/* Frames without a present before got_clock_idle() starts catching up, and
+   the most it catches up in one go (matches the old 0.1s dt cap). */
+#define CLOCK_IDLE_FRAMES 4
+#define CLOCK_IDLE_MAX_S 0.1
+
+static int g_mode = GOT_CLOCK_REALTIME;
+static int64_t g_virtual_units = 0;
+static uint64_t g_ticks_delivered = 0;
+static uint64_t g_frames = 0;
+static double g_wall_anchor_s = -1.0; /* wall time of virtual time 0 */
+
+double got_clock_wall_s(void) {
+#ifdef __EMSCRIPTEN__
+  return emscripten_get_now() / 1000.0;
+#elif defined(_WIN32)
+  static LARGE_INTEGER freq;
+  LARGE_INTEGER now;
+  if (!freq.QuadPart) QueryPerformanceFrequency(&freq);
+  QueryPerformanceCounter(&now);
+  return (double)now.QuadPart / (double)freq.QuadPart;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+#endif
+}
+
+void got_clock_sleep_ms(unsigned ms) {
+#ifdef __EMSCRIPTEN__
+  emscripten_sleep(ms);
+#elif defined(_WIN32)
+  Sleep(ms);
+#else
+  usleep((useconds_t)ms * 1000);
+#endif
+}
+
+static double virtual_s(void) {
+  return (double)g_virtual_units / (double)CLOCK_UNITS_PER_SEC;
+}
+
+static void rebase_wall(double now) {
+  g_wall_anchor_s = now - virtual_s();
+}
+
+void got_clock_set_mode(int mode) {
+  g_mode = (mode == GOT_CLOCK_FREE) ? GOT_CLOCK_FREE : GOT_CLOCK_REALTIME;
+  /* Switching back to realtime must not try to sleep off the free-run lead. */
+  rebase_wall(got_clock_wall_s());
+}
+
+int got_clock_mode(void) {
+  return g_mode;
+}
+
+void got_clock_reset(void) {
+  g_virtual_units = 0;
+  g_ticks_delivered = 0;
+  g_frames = 0;
+  rebase_wall(got_clock_wall_s());
+}
+
+void got_clock_end_frame(void) {
+  g_virtual_units += CLOCK_UNITS_PER_FRAME;
+  g_frames++;
+
+  if (g_mode == GOT_CLOCK_REALTIME) {
+    const double frame_s = 1.0 / 70.0;
+    double now = got_clock_wall_s();
+    double target;
+    if (g_wall_anchor_s < 0.0) rebase_wall(now);
+    target = g_wall_anchor_s + virtual_s();
+    if (target - frame_s < now - frame_s * CLOCK_MAX_DEBT_FRAMES) {
+      /* Too far behind: drop the debt, next frame is due one frame from now. */
+      g_wall_anchor_s = now + frame_s - virtual_s();
+    }
+  }
+}
+
+void got_clock_advance_ms(unsigned ms) {
+  g_virtual_units += (int64_t)ms * CLOCK_UNITS_PER_MS;
+}
+
+double got_clock_remaining_s(void) {
+  if (g_mode != GOT_CLOCK_REALTIME || g_wall_anchor_s < 0.0) return 0.0;
+  return (g_wall_anchor_s + virtual_s()) - got_clock_wall_s();
+}
+
+unsigned got_clock_idle(void) {
+  double now, lag_s;
+  unsigned ms;
+  if (g_mode != GOT_CLOCK_REALTIME) return 0;
+  now = got_clock_wall_s();
+  if (g_wall_anchor_s < 0.0) {
+    rebase_wall(now);
+    return 0;
+  }
+  lag_s = now - (g_wall_anchor_s + virtual_s());
+  if (lag_s <= (double)CLOCK_IDLE_FRAMES / 70.0) return 0;
+  if (lag_s > CLOCK_IDLE_MAX_S) lag_s = CLOCK_IDLE_MAX_S;
+  /* Whole milliseconds, so an input replay can repeat it exactly. */
+  ms = (unsigned)(lag_s * 1000.0);
+  got_clock_advance_ms(ms);
+  rebase_wall(now);
+  return ms;
+}
+
+int got_clock_take_ticks(void) {
+  uint64_t due = (uint64_t)(g_virtual_units / CLOCK_UNITS_PER_TICK);
+  int n = 0;
+  if (due > g_ticks_delivered) {
+    n = (int)(due - g_ticks_delivered);
+    g_ticks_delivered = due;
+  }
+  return n;
+}
+
+uint64_t got_clock_ticks(void) {
+  return g_ticks_delivered;
+}
+
+uint64_t got_clock_frames(void) {
+  return g_frames;
+}
+
+void got_clock_save(GOT_CLOCK_STATE* out) {
+  out->units = g_virtual_units;
+  out->ticks = g_ticks_delivered;
+  out->frames = g_frames;
+}
+
+void got_clock_restore(const GOT_CLOCK_STATE* state) {
+  g_virtual_units = state->units;
+  g_ticks_delivered = state->ticks;
+  g_frames = state->frames;
+  rebase_wall(got_clock_wall_s());
+}
@@ -0,0 +1,67 @@
+#ifndef GOT_CLOCK_H
+#define GOT_CLOCK_H
+
+#include <stdint.h>
+
+/* Virtual game clock.
+
+   The DOS game ran its timer ISR at 120Hz and presented on the ~70Hz VGA
+   retrace. Natively both are derived from one virtual timeline instead of the
+   wall clock: every game frame (xshowpage) advances it by exactly 1/70s and
+   delay() by the requested milliseconds. 120Hz ticks fall out of that at a
+   fixed cadence (12 ticks per 7 frames), so timer_cnt/vbl_cnt/magic_cnt and
+   MU_Service() advance identically on every run.
+
+   GOT_CLOCK_REALTIME sleeps so virtual time keeps pace with the wall clock
+   (normal play). GOT_CLOCK_FREE never sleeps: the game runs as fast as the CPU
+   allows (headless replays, batch runs). */
+
+enum {
+  GOT_CLOCK_REALTIME = 0,
+  GOT_CLOCK_FREE = 1
+};
+
+void got_clock_set_mode(int mode);
+int got_clock_mode(void);
+
+/* Reset the timeline (ticks/frames back to zero, wall anchor to now). */
+void got_clock_reset(void);
+
+/* Advance virtual time by one 70Hz frame / by ms milliseconds. */
+void got_clock_end_frame(void);
+void got_clock_advance_ms(unsigned ms);
+
+/* Realtime mode: seconds of wall time until virtual time is reached
+   (<= 0 when caught up). Always 0 in free mode. */
+double got_clock_remaining_s(void);
+
+/* Realtime mode: when the game stops presenting (e.g. spinning on input in a
+   wait-for-release loop), pull virtual time up to the wall clock so music
+   keeps playing. Returns the milliseconds added; always 0 in free mode. */
+unsigned got_clock_idle(void);
+
+/* Number of 120Hz ticks that are due but not yet delivered; marks them
+   delivered. */
+int got_clock_take_ticks(void);
+
+uint64_t got_clock_ticks(void);
+uint64_t got_clock_frames(void);
+
+/* Savestates (game/snapshot.c): the timeline position. Restoring keeps the
+   mode and moves the wall anchor with it, so realtime play carries on from
+   the restored time without sleeping or catching up. */
+typedef struct {
+  int64_t units;
+  uint64_t ticks;
+  uint64_t frames;
+} GOT_CLOCK_STATE;
+
+void got_clock_save(GOT_CLOCK_STATE* out);
+void got_clock_restore(const GOT_CLOCK_STATE* state);
+
+/* Monotonic wall clock in seconds, and a plain sleep that does not touch
+   virtual time (unlike delay()). */
+double got_clock_wall_s(void);
+void got_clock_sleep_ms(unsigned ms);
+
+#endif
@@ -8,12 +8,59 @@ void got_platform_video_init(void);
 void got_platform_video_shutdown(void);
 void got_platform_set_split(int on);
 
+/* Headless mode (select before the first video/audio init): no window, GL
+   context or audio device. Nothing is presented; pair with GOT_CLOCK_FREE
+   (got_clock.h) to run the game loop uncapped. */
+void got_platform_set_headless(int on);
+int got_platform_is_headless(void);
+
+/* Presentation path (select before the first video init):
+     CPU   - expand indices to RGBA on the CPU and upload that (default).
+     GPU   - upload the 8-bit index page and a 256x1 palette texture and look
+             colours up in a fragment shader; a palette change costs 1 KB.
+     CHECK - render both every frame, show the GPU one and compare them pixel
+             for pixel; mismatches are reported on stderr.
+   Falls back to CPU if the palette shader does not compile. */
+enum {
+  GOT_PRESENT_CPU = 0,
+  GOT_PRESENT_GPU = 1,
+  GOT_PRESENT_CHECK = 2
+};
+void got_platform_set_present_mode(int mode);
+
+/* Frames presented since video init: drawn straight from the frame texture to
+   the backbuffer, or through the intermediate render target. GOT_PRESENT_STATS=1
+   prints both on shutdown. */
+void got_platform_present_stats(unsigned long* out_direct, unsigned long* out_via_rt);
+
+/* Copies a 320x192 chunky image (row stride 320) over the top of a page,
+   e.g. a composed tile layer (tile_cache.h). */
+void got_platform_page_put(unsigned int pagebase, const uint8_t* pix);
+
+/* Savestates (game/snapshot.c): the video state the game draws on and reads
+   back from frame to frame -- the pages of the current layout (split or
+   full screen), the palette with its cycling counters and the page last
+   shown -- as got_platform_video_state_size() bytes. Restoring needs a
+   state saved in the same layout and redraws everything on the next
+   present. */
+long got_platform_video_state_size(void);
+void got_platform_video_save(void* dst);
+void got_platform_video_restore(const void* src);
+
+/* Rewind (game/rewind.c): whether F12 or the left trigger is held, and
+   the page last shown presented again, paced to 70Hz of wall time without
+   moving the game clock. Never held headless. */
+int got_platform_rewind_held(void);
+void got_platform_show_paced(void);
+
 /* Called by the renderer to keep timers/input/audio moving. */
 void got_platform_pump(void);
 
 /* Audio */
 int got_platform_audio_init(void);
 void got_platform_audio_shutdown(void);
+/* Headless only: mix one 120Hz tick worth of audio into a scratch buffer. */
+void got_platform_audio_tick(void);
 
 /* Key translation: platform backend updates the game's key_flag array. */
 int got_platform_map_key_to_dos_scancode(int raylib_key);
@@ -0,0 +1,403 @@
+#include "got_replay.h"
+#include "got_clock.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* File layout, little endian:
+
+     0  "GOTREPLY"
+     8  u16 version, u16 header size
+    12  u8 episode, skill, scroll, cheat
+    16  u16 start level, u8 keys[7], u8 flags (1 = the game stopped)
+    26  u16 checkpoint frames
+    28  u32 seed, pumps, frames, checkpoints
+
+   then records up to END, each `varint empty pumps before it, u8 kind`:
+
+     PUMP   u8 n, n key bytes, s8 item cycle, varint idle ms
+     CHECK  varint frame, u32 hash */
+
+enum {
+  HEADER_SIZE = 44,
+  REC_END = 0,
+  REC_PUMP = 1,
+  REC_CHECK = 2,
+  REC_BAD = -1,
+  /* The recording ended because the game stopped (its main loop returned),
+     not because the process exited under it. */
+  FLAG_STOPPED = 1,
+  /* Pumps a finished playback keeps answering before giving up on the
+     game stopping by itself. */
+  OVERRUN_PUMPS = 10000
+};
+
+static const char g_magic[8] = {'G', 'O', 'T', 'R', 'E', 'P', 'L', 'Y'};
+
+static int g_mode;
+static int g_active, g_done, g_failed, g_finished;
+static FILE* g_out;
+static GOT_REPLAY_START g_start;
+
+static uint8_t* g_buf; /* recording: the records so far; playback: the file */
+static size_t g_len, g_cap, g_pos;
+
+static uint32_t g_pumps, g_frames, g_checks, g_empty;
+static uint32_t g_total_pumps, g_total_frames, g_total_checks;
+static int g_kind; /* playback: the record after g_empty empty pumps */
+static long g_overrun;
+static int g_exiting;  /* recording: finished from atexit */
+static int g_stopped;  /* playback: FLAG_STOPPED */
+
+static double g_wall0;
+static uint64_t g_ticks0;
+
+static void put_u16(uint8_t* p, unsigned v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t* p, uint32_t v) {
+  put_u16(p, v & 0xffff);
+  put_u16(p + 2, v >> 16);
+}
+
+static unsigned get_u16(const uint8_t* p) { return p[0] | (unsigned)p[1] << 8; }
+
+static uint32_t get_u32(const uint8_t* p) { return get_u16(p) | (uint32_t)get_u16(p + 2) << 16; }
+
+static void fail(const char* what) {
+  if (!g_failed) fprintf(stderr, "replay: %s (frame %u, pump %u)\n", what, g_frames, g_pumps);
+  g_failed = 1;
+  g_done = 1;
+}
+
+/* ---- recording ---- */
+
+static void put_byte(int b) {
+  if (g_len == g_cap) {
+    size_t cap = g_cap ? g_cap * 2 : 4096;
+    uint8_t* p = (uint8_t*)realloc(g_buf, cap);
+    if (!p) {
+      fail("out of memory, recording stopped");
+      g_active = 0;
+      return;
+    }
+    g_buf = p;
+    g_cap = cap;
+  }
+  g_buf[g_len++] = (uint8_t)b;
+}
+
+static void put_varint(uint32_t v) {
+  while (v >= 0x80) {
+    put_byte((int)(v & 0x7f) | 0x80);
+    v >>= 7;
+  }
+  put_byte((int)v);
+}
+
+static void put_record(int kind) {
+  put_varint(g_empty);
+  put_byte(kind);
+  g_empty = 0;
+}
+
+static void write_file(void) {
+  uint8_t h[HEADER_SIZE];
+  int i;
+
+  put_record(REC_END);
+  memset(h, 0, sizeof(h));
+  memcpy(h, g_magic, sizeof(g_magic));
+  put_u16(h + 8, GOT_REPLAY_VERSION);
+  put_u16(h + 10, HEADER_SIZE);
+  h[12] = (uint8_t)g_start.episode;
+  h[13] = (uint8_t)g_start.skill;
+  h[14] = (uint8_t)g_start.scroll;
+  h[15] = (uint8_t)g_start.cheat;
+  put_u16(h + 16, (unsigned)g_start.start_level);
+  for (i = 0; i < 7; i++) h[18 + i] = (uint8_t)g_start.keys[i];
+  h[25] = g_exiting ? 0 : FLAG_STOPPED;
+  put_u16(h + 26, (unsigned)g_start.checkpoint_frames);
+  put_u32(h + 28, g_start.seed);
+  put_u32(h + 32, g_pumps);
+  put_u32(h + 36, g_frames);
+  put_u32(h + 40, g_checks);
+  if (fwrite(h, 1, sizeof(h), g_out) != sizeof(h) || fwrite(g_buf, 1, g_len, g_out) != g_len) {
+    fprintf(stderr, "replay: write failed\n");
+  }
+}
+
+/* ---- playback ---- */
+
+static int get_byte(void) { return g_pos < g_len ? g_buf[g_pos++] : -1; }
+
+static int get_varint(uint32_t* v) {
+  int shift, b;
+  *v = 0;
+  for (shift = 0; shift < 35; shift += 7) {
+    if ((b = get_byte()) < 0) return 0;
+    *v |= (uint32_t)(b & 0x7f) << shift;
+    if (!(b & 0x80)) return 1;
+  }
+  return 0;
+}
+
+static void next_record(void) {
+  int kind;
+  if (!get_varint(&g_empty) || (kind = get_byte()) < 0 || kind > REC_CHECK) {
+    g_empty = 0;
+    g_kind = REC_BAD;
+    return;
+  }
+  g_kind = kind;
+}
+
+static void read_pump(GOT_REPLAY_PUMP* out) {
+  int n = get_byte(), i, item;
+  uint32_t idle;
+
+  if (n < 0 || n > GOT_REPLAY_MAX_KEYS) {
+    fail("replay file is damaged");
+    return;
+  }
+  for (i = 0; i < n; i++) {
+    int b = get_byte();
+    if (b < 0) break;
+    out->keys[out->nkeys++] = (uint8_t)b;
+  }
+  item = get_byte();
+  if (i < n || item < 0 || !get_varint(&idle)) {
+    fail("replay file is damaged");
+    return;
+  }
+  out->item_cycle = (signed char)item;
+  out->idle_ms = idle;
+}
+
+/* ---- API ---- */
+
+static void at_exit(void) {
+  g_exiting = 1;
+  got_replay_finish();
+}
+
+int got_replay_record(const char* path) {
+  g_out = fopen(path, "wb");
+  if (!g_out) {
+    fprintf(stderr, "replay: can't create %s\n", path);
+    return -1;
+  }
+  g_mode = GOT_REPLAY_RECORD;
+  atexit(at_exit);
+  return 0;
+}
+
+int got_replay_load(const char* path) {
+  FILE* fp = fopen(path, "rb");
+  long size;
+  uint8_t* h;
+  int i;
+
+  if (!fp) {
+    fprintf(stderr, "replay: can't open %s\n", path);
+    return -1;
+  }
+  fseek(fp, 0, SEEK_END);
+  size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  g_buf = size > 0 ? (uint8_t*)malloc((size_t)size) : NULL;
+  if (!g_buf || fread(g_buf, 1, (size_t)size, fp) != (size_t)size) {
+    fclose(fp);
+    fprintf(stderr, "replay: can't read %s\n", path);
+    return -1;
+  }
+  fclose(fp);
+
+  h = g_buf;
+  if (size < HEADER_SIZE || memcmp(h, g_magic, sizeof(g_magic)) != 0 ||
+      get_u16(h + 10) < HEADER_SIZE || get_u16(h + 10) > size) {
+    fprintf(stderr, "replay: %s is not a replay\n", path);
+    return -1;
+  }
+  if (get_u16(h + 8) != GOT_REPLAY_VERSION) {
+    fprintf(stderr, "replay: %s is version %u, this build reads %d\n", path, get_u16(h + 8),
+            GOT_REPLAY_VERSION);
+    return -1;
+  }
+  g_start.episode = h[12];
+  g_start.skill = h[13];
+  g_start.scroll = h[14];
+  g_start.cheat = h[15];
+  g_start.start_level = (int)get_u16(h + 16);
+  for (i = 0; i < 7; i++) g_start.keys[i] = h[18 + i];
+  g_stopped = h[25] & FLAG_STOPPED;
+  g_start.checkpoint_frames = (int)get_u16(h + 26);
+  g_start.seed = get_u32(h + 28);
+  g_total_pumps = get_u32(h + 32);
+  g_total_frames = get_u32(h + 36);
+  g_total_checks = get_u32(h + 40);
+  g_len = (size_t)size;
+  g_pos = get_u16(h + 10);
+  g_mode = GOT_REPLAY_PLAY;
+  atexit(at_exit);
+  return 0;
+}
+
+int got_replay_mode(void) { return g_mode; }
+
+const GOT_REPLAY_START* got_replay_start_info(void) { return &g_start; }
+
+void got_replay_begin(const GOT_REPLAY_START* start) {
+  if (g_mode == GOT_REPLAY_OFF || g_active || g_finished) return;
+  if (g_mode == GOT_REPLAY_RECORD) g_start = *start;
+  else next_record();
+  g_active = 1;
+  /* Both runs start from the same virtual time, whatever startup took. */
+  got_clock_reset();
+  g_wall0 = got_clock_wall_s();
+  g_ticks0 = got_clock_ticks();
+}
+
+int got_replay_next(GOT_REPLAY_PUMP* out) {
+  if (g_mode != GOT_REPLAY_PLAY || !g_active) return 0;
+  memset(out, 0, sizeof(*out));
+  if (g_done) {
+    /* Stuck in a loop that waits for input that will never come. That is
+       how a recording cut off by the process exiting ends; it only means
+       the game overran when the recorded game stopped here. */
+    if (++g_overrun > OVERRUN_PUMPS) {
+      if (!g_failed && g_stopped) fprintf(stderr, "replay: the game did not stop at the end of the replay\n");
+      got_replay_finish();
+      exit(got_replay_status());
+    }
+    return 1;
+  }
+  if (g_empty == 0 && g_kind == REC_END) {
+    g_done = 1;
+    return 1;
+  }
+  g_pumps++;
+  if (g_empty > 0) {
+    g_empty--;
+    return 1;
+  }
+  switch (g_kind) {
+    case REC_PUMP:
+      read_pump(out);
+      next_record();
+      break;
+    case REC_CHECK:
+      fail("out of step: the game read input before a checkpoint");
+      break;
+    default:
+      fail("replay file is damaged");
+      break;
+  }
+  return 1;
+}
+
+void got_replay_put(const GOT_REPLAY_PUMP* pump) {
+  int i;
+
+  if (g_mode != GOT_REPLAY_RECORD || !g_active) return;
+  g_pumps++;
+  if (pump->nkeys == 0 && pump->item_cycle == 0 && pump->idle_ms == 0) {
+    g_empty++;
+    return;
+  }
+  put_record(REC_PUMP);
+  put_byte(pump->nkeys);
+  for (i = 0; i < pump->nkeys; i++) put_byte(pump->keys[i]);
+  put_byte(pump->item_cycle & 0xff);
+  put_varint(pump->idle_ms);
+}
+
+void got_replay_frame(uint32_t hash) {
+  uint32_t frame, want;
+  int i;
+
+  if (!g_active || g_done) return;
+  g_frames++;
+  if (g_start.checkpoint_frames <= 0 || g_frames % (uint32_t)g_start.checkpoint_frames) return;
+
+  if (g_mode == GOT_REPLAY_RECORD) {
+    put_record(REC_CHECK);
+    put_varint(g_frames);
+    for (i = 0; i < 4; i++) put_byte((int)(hash >> (8 * i)) & 0xff);
+    g_checks++;
+    return;
+  }
+  if (g_empty > 0 || g_kind != REC_CHECK) {
+    fail("out of step: the game reached a checkpoint early");
+    return;
+  }
+  if (!get_varint(&frame) || g_pos + 4 > g_len) {
+    fail("replay file is damaged");
+    return;
+  }
+  want = get_u32(g_buf + g_pos);
+  g_pos += 4;
+  if (frame != g_frames || want != hash) {
+    fail("game state differs from the recording");
+    return;
+  }
+  g_checks++;
+  next_record();
+}
+
+int got_replay_done(void) { return g_done; }
+
+void got_replay_finish(void) {
+  double wall, game;
+
+  if (g_mode == GOT_REPLAY_OFF || g_finished) return;
+  g_finished = 1;
+  if (g_mode == GOT_REPLAY_RECORD) {
+    if (g_active) write_file();
+    fclose(g_out);
+    g_out = NULL;
+    printf("replay: recorded %u frames, %u pumps, %u checkpoints\n", g_frames, g_pumps, g_checks);
+  } else {
+    if (!g_active) fail("the game never started");
+    else if (!g_done && g_kind != REC_END) fail("the game stopped before the end of the replay");
+    wall = got_clock_wall_s() - g_wall0;
+    game = (double)(got_clock_ticks() - g_ticks0) / 120.0;
+    printf("replay: %s, %u/%u frames, %u/%u pumps, %u/%u checkpoints\n",
+           g_failed ? "FAILED" : "ok", g_frames, g_total_frames, g_pumps, g_total_pumps, g_checks,
+           g_total_checks);
+    printf("replay: %.1f s of game time in %.2f s (%.0fx)\n", game, wall,
+           wall > 0.0 ? game / wall : 0.0);
+  }
+  g_active = 0;
+  free(g_buf);
+  g_buf = NULL;
+  g_len = g_cap = 0;
+}
+
+int got_replay_status(void) { return g_failed ? 1 : 0; }
+
+void got_replay_mark(GOT_REPLAY_MARK* out) {
+  out->pos = g_pos;
+  out->pumps = g_pumps;
+  out->frames = g_frames;
+  out->checks = g_checks;
+  out->empty = g_empty;
+  out->kind = g_kind;
+}
+
+void got_replay_seek(const GOT_REPLAY_MARK* mark) {
+  if (g_mode != GOT_REPLAY_PLAY || !g_active || g_done) return;
+  g_pos = mark->pos;
+  g_pumps = mark->pumps;
+  g_frames = mark->frames;
+  g_checks = mark->checks;
+  g_empty = mark->empty;
+  g_kind = mark->kind;
+}
+
+void got_replay_fail(const char* why) {
+  if (g_mode == GOT_REPLAY_PLAY && g_active) fail(why);
+}
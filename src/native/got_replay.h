@@ -0,0 +1,111 @@
+#ifndef GOT_REPLAY_H
+#define GOT_REPLAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Input replays.
+
+   The old demo facility (demo_key[], DEMO.GOT) keeps one scancode per main
+   loop frame, for a fixed number of frames, from a fixed cheat start. A
+   replay file instead holds everything a run needs to come out the same:
+   a versioned header with the episode, start level, settings and rand()
+   seed, then every change the platform made to key_flag[] and the item
+   cycle buttons, one record per got_platform_pump() call, and the clock
+   time idle pumps added. Pumps that change nothing cost a counter.
+
+   Input goes by pump rather than by main loop frame so menus and wait
+   loops that poll the keyboard on their own replay exactly too. Every
+   checkpoint_frames main loop frames demo_key_set() (game/init.c) hashes
+   the game state; recording stores the hash, playback compares it and
+   stops at the first difference. With --headless and the free clock a
+   replay checks a run far faster than it was played. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+  GOT_REPLAY_OFF = 0,
+  GOT_REPLAY_RECORD = 1,
+  GOT_REPLAY_PLAY = 2,
+  GOT_REPLAY_VERSION = 2,
+  GOT_REPLAY_MAX_KEYS = 100
+};
+
+typedef struct {
+  int episode;
+  int start_level;
+  int skill;
+  int scroll;  /* setup.scroll_flag */
+  int cheat;
+  int keys[7]; /* key_up, key_down, key_left, key_right, key_fire, key_magic, key_select */
+  uint32_t seed;
+  int checkpoint_frames; /* 0 = no checkpoints */
+} GOT_REPLAY_START;
+
+/* One got_platform_pump() call. */
+typedef struct {
+  unsigned idle_ms; /* got_clock_idle() catch-up */
+  int item_cycle;   /* -1, 0, 1 */
+  int nkeys;
+  uint8_t keys[GOT_REPLAY_MAX_KEYS]; /* scancode, | 0x80 when key_flag became set */
+} GOT_REPLAY_PUMP;
+
+/* Arm recording to `path` (opened now, written by got_replay_finish()), or
+   load the replay at `path` for playback. 0 on success, -1 with a message
+   on stderr otherwise. */
+int got_replay_record(const char* path);
+int got_replay_load(const char* path);
+
+/* GOT_REPLAY_OFF/RECORD/PLAY, as armed. */
+int got_replay_mode(void);
+
+/* Playback: the header of the loaded replay. */
+const GOT_REPLAY_START* got_replay_start_info(void);
+
+/* The game is set up and about to run the first frame. Recording stores
+   *start as the header; playback passes NULL. Pumps before this call are
+   neither recorded nor replayed. */
+void got_replay_begin(const GOT_REPLAY_START* start);
+
+/* Playback: the next pump into *out. 0 when not playing back (read the
+   devices instead). */
+int got_replay_next(GOT_REPLAY_PUMP* out);
+
+/* Recording: one pump's worth of input. */
+void got_replay_put(const GOT_REPLAY_PUMP* pump);
+
+/* One main loop frame with the game state hashed. */
+void got_replay_frame(uint32_t hash);
+
+/* Playback ran out of input or went out of step; the game should stop. */
+int got_replay_done(void);
+
+/* Writes the recording / prints the playback summary. Safe to call more
+   than once. */
+void got_replay_finish(void);
+
+/* Process exit status: 1 if playback went out of step, else 0. */
+int got_replay_status(void);
+
+/* Playback: where the reader is, so a stretch of the replay can be played
+   again from a savestate taken at the same point (snapshot.c's
+   --check-snapshot). */
+typedef struct {
+  size_t pos;
+  uint32_t pumps, frames, checks, empty;
+  int kind;
+} GOT_REPLAY_MARK;
+
+void got_replay_mark(GOT_REPLAY_MARK* out);
+void got_replay_seek(const GOT_REPLAY_MARK* mark);
+
+/* Playback: stop as out of step, with `why` on stderr. */
+void got_replay_fail(const char* why);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* GOT_REPLAY_H */
@@ -5,6 +5,7 @@
  *   sub_1C8AF  (RLE    - byte-run, terminator 0)
  */
 #include "graphics_got.h"
+#include "lzss.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -25,41 +26,11 @@ static uint32_t rd32(const uint8_t *p) {
 
 /* LZSS12: flag byte (LSB first), bit=1 → literal, bit=0 → back-reference.
  * Back-ref: uint16le, lower 12 bits = offset, upper 4 bits + 2 = length.
- * Matches GOT.EXE sub_1C85A exactly. */
+ * Matches GOT.EXE sub_1C85A exactly; the decoder is shared with
+ * GOTRES.DAT (lzss_decode in src/utility/lzss.c). */
 static int decompress_lzss12(const uint8_t *src, int in_size,
                              uint8_t *dst, int out_size) {
-    int si = 0, di = 0;
-    uint8_t flags = 0;
-    int bits_left = 0;
-
-    while (di < out_size) {
-        if (bits_left == 0) {
-            if (si >= in_size) break;
-            flags = src[si++];
-            bits_left = 8;
-        }
-        if (flags & 1) {
-            /* literal byte */
-            if (si >= in_size) break;
-            dst[di++] = src[si++];
-        } else {
-            /* back-reference */
-            if (si + 2 > in_size) break;
-            uint16_t word = (uint16_t)src[si] | ((uint16_t)src[si+1] << 8);
-            si += 2;
-            int count  = ((word >> 12) & 0x0F) + 2;
-            int offset = word & 0x0FFF;
-            if (offset == 0 || offset > di) break;
-            int j;
-            for (j = 0; j < count && di < out_size; j++) {
-                dst[di] = dst[di - offset];
-                di++;
-            }
-        }
-        flags >>= 1;
-        bits_left--;
-    }
-    return di;
+    return (int)lzss_decode((const char *)src, in_size, (char *)dst, out_size);
 }
 
 /* RLE: byte-run encoding.  Matches GOT.EXE sub_1C8AF.
@@ -11,6 +11,7 @@
 #include "mu_man.h"
 #include "res_man.h"
 #include "level.h"
+#include "script_catalog.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -913,13 +914,6 @@ draw_empty:
  * 5. SCRIPT VIEWER
  * ════════════════════════════════════════════════════════════════════ */
 
-/* Script index entry */
-typedef struct {
-    int script_id;
-    int start_offset;   /* byte offset of first line after |<id>\r */
-    int end_offset;     /* byte offset of |STOP or next marker */
-} script_entry_t;
-
 /* Known script commands (from game/script.c scr_command[]) */
 static const char *scr_commands[] = {
     "END", "GOTO", "GOSUB", "RETURN", "FOR", "NEXT",
@@ -950,112 +944,37 @@ static int is_script_command(const char *word, int len) {
     return 0;
 }
 
-/* Parse SPEAK resource data into script entries.
- * Returns number of scripts found. Caller must free *out_entries. */
-static int parse_speak_scripts(const uint8_t *data, long size,
-                               script_entry_t **out_entries) {
-    int capacity = 64, count = 0;
-    script_entry_t *entries;
-    long pos = 0;
-
-    entries = (script_entry_t *)malloc(capacity * sizeof(script_entry_t));
-    if (!entries) { *out_entries = NULL; return 0; }
-
-    while (pos < size) {
-        if (data[pos] == '|') {
-            long num_start = pos + 1;
-            long p = num_start;
-            int script_id;
-
-            /* Find end of this token */
-            while (p < size && data[p] != 13 && data[p] != 10)
-                p++;
-
-            /* |EOF — end of resource */
-            if (p - num_start == 3 &&
-                strncmp((const char *)data + num_start, "EOF", 3) == 0)
-                break;
-
-            /* |STOP — closes previous script */
-            if (p - num_start == 4 &&
-                strncmp((const char *)data + num_start, "STOP", 4) == 0) {
-                if (count > 0 && entries[count - 1].end_offset == 0)
-                    entries[count - 1].end_offset = (int)pos;
-                while (pos < size && data[pos] != 13) pos++;
-                if (pos < size && data[pos] == 13) pos++;
-                if (pos < size && data[pos] == 10) pos++;
-                continue;
-            }
-
-            /* Try to parse number */
-            script_id = 0;
-            {
-                long d = num_start;
-                int got_digit = 0;
-                while (d < p) {
-                    if (data[d] >= '0' && data[d] <= '9') {
-                        script_id = script_id * 10 + (data[d] - '0');
-                        got_digit = 1;
-                    } else {
-                        got_digit = 0;
-                        break;
-                    }
-                    d++;
-                }
-                if (!got_digit) {
-                    while (pos < size && data[pos] != 13) pos++;
-                    if (pos < size && data[pos] == 13) pos++;
-                    if (pos < size && data[pos] == 10) pos++;
-                    continue;
-                }
-            }
+/* SPEAK catalogue for an area (0-2), shared with the game's script
+ * interpreter. The archive is open only while it is (re)built. */
+static const ScriptCatalog *speak_catalog(int area) {
+    const ScriptCatalog *cat;
+    char *lzss_buf;
 
-            /* Close previous script if still open */
-            if (count > 0 && entries[count - 1].end_offset == 0)
-                entries[count - 1].end_offset = (int)pos;
-
-            /* Skip past the |<number>\r\n line */
-            while (pos < size && data[pos] != 13) pos++;
-            if (pos < size && data[pos] == 13) pos++;
-            if (pos < size && data[pos] == 10) pos++;
-
-            /* Grow if needed */
-            if (count >= capacity) {
-                capacity *= 2;
-                entries = (script_entry_t *)realloc(entries,
-                            capacity * sizeof(script_entry_t));
-                if (!entries) { *out_entries = NULL; return 0; }
-            }
+    lzss_buf = (char *)malloc(18000);
+    if (!lzss_buf) return NULL;
 
-            entries[count].script_id = script_id;
-            entries[count].start_offset = (int)pos;
-            entries[count].end_offset = 0;
-            count++;
-        } else {
-            /* Skip to next line */
-            while (pos < size && data[pos] != 13) pos++;
-            if (pos < size && data[pos] == 13) pos++;
-            if (pos < size && data[pos] == 10) pos++;
-        }
+    res_init(lzss_buf);
+    if (res_open("GOTRES.DAT") < 0) {
+        free(lzss_buf);
+        return NULL;
     }
-
-    /* Close last script if still open */
-    if (count > 0 && entries[count - 1].end_offset == 0)
-        entries[count - 1].end_offset = (int)size;
-
-    *out_entries = entries;
-    return count;
+    cat = script_catalog_area(area + 1);
+    res_close();
+    free(lzss_buf);
+    return cat;
 }
 
-/* Count lines in a script (CR-delimited) */
-static int count_script_lines(const uint8_t *data, int start, int end) {
-    int lines = 0, pos = start;
-    while (pos < end) {
-        if (data[pos] == 13) lines++;
-        pos++;
+/* Label the given line of a script falls under, or NULL. */
+static const char *script_label_at(const ScriptCatalog *cat,
+                                   const ScriptEntry *e, int line) {
+    const char *name = NULL;
+    int i;
+
+    for (i = 0; i < e->labels; i++) {
+        if (cat->labels[e->first_label + i].line > line) break;
+        name = cat->labels[e->first_label + i].name;
     }
-    if (end > start && data[end - 1] != 13) lines++;
-    return lines;
+    return name;
 }
 
 /* Get byte offset of the Nth line (0-indexed) within a script */
@@ -1159,9 +1078,9 @@ static void extras_script_viewer(void) {
     int cur_script = 0, scroll_y = 0;
     int key, faded_in = 0;
 
-    uint8_t *speak_data = NULL;
-    long speak_size = 0;
-    script_entry_t *entries = NULL;
+    const ScriptCatalog *cat = NULL;
+    const uint8_t *speak_data = NULL;
+    const ScriptEntry *entries = NULL;
     int num_scripts = 0, total_lines = 0;
     int cur_area = -1, cur_loaded_script = -1;
 
@@ -1174,14 +1093,16 @@ static void extras_script_viewer(void) {
 
         /* Load SPEAK resource on area change */
         if (cur_area != area) {
-            free(speak_data); speak_data = NULL;
-            free(entries); entries = NULL;
+            speak_data = NULL;
+            entries = NULL;
             num_scripts = 0;
 
-            speak_data = res_load(speak_names[area], &speak_size);
-            if (speak_data)
-                num_scripts = parse_speak_scripts(speak_data, speak_size,
-                                                  &entries);
+            cat = speak_catalog(area);
+            if (cat) {
+                speak_data = (const uint8_t *)cat->text;
+                entries = cat->entries;
+                num_scripts = cat->count;
+            }
             cur_area = area;
             cur_script = 0;
             scroll_y = 0;
@@ -1190,9 +1111,7 @@ static void extras_script_viewer(void) {
 
         /* Recount lines on script change */
         if (cur_loaded_script != cur_script && num_scripts > 0) {
-            total_lines = count_script_lines(speak_data,
-                entries[cur_script].start_offset,
-                entries[cur_script].end_offset);
+            total_lines = entries[cur_script].lines;
             scroll_y = 0;
             cur_loaded_script = cur_script;
         }
@@ -1209,7 +1128,7 @@ static void extras_script_viewer(void) {
         if (num_scripts == 0) {
             font_center(90, "No scripts found", MENU_NORM_COLOR);
         } else {
-            int sid = entries[cur_script].script_id;
+            int sid = (int)entries[cur_script].index;
 
             /* Info line: decode script index */
             if (sid >= 1000) {
@@ -1226,8 +1145,8 @@ static void extras_script_viewer(void) {
 
             /* Render visible lines with syntax coloring */
             {
-                int start = entries[cur_script].start_offset;
-                int end = entries[cur_script].end_offset;
+                int start = (int)entries[cur_script].start;
+                int end = (int)entries[cur_script].end;
                 int line_off = get_line_offset(speak_data, start, end,
                                                scroll_y);
 
@@ -1255,8 +1174,15 @@ static void extras_script_viewer(void) {
 
             /* Bottom bar: line position */
             if (total_lines > 0) {
+                const char *label = script_label_at(cat, &entries[cur_script],
+                                                    scroll_y);
                 sprintf(buf, "Line %d/%d", scroll_y + 1, total_lines);
                 font_print(SCRIPT_TEXT_X, 176, buf, MENU_NORM_COLOR);
+                if (label) {
+                    sprintf(buf, "%s:", label);
+                    font_print(311 - 8 - font_width(buf), 176, buf,
+                               SCR_COLOR_COMMAND);
+                }
             }
         }
 
@@ -1306,8 +1232,6 @@ static void extras_script_viewer(void) {
         if (key == KEY_ESCAPE) break;
     }
 
-    free(speak_data);
-    free(entries);
     drain_keys();
 }
 
@@ -0,0 +1,382 @@
+#include "lzss_check.h"
+#include "got_clock.h"
+#include "graphics_got.h"
+#include "lzss.h"
+#include "res_man.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+  CHECK_MAX_STREAMS = RES_MAX_ENTRIES * 2,
+  CHECK_OUT_MAX = 65536,
+  /* Slack after the output so an overrun lands in bytes we compare. */
+  CHECK_GUARD = 64,
+  CHECK_TIME_PASSES = 50
+};
+
+/* A raw LZSS stream (no size header) and its expected output size. */
+typedef struct {
+  char name[16];
+  const uint8_t* src;
+  int in_size;
+  int out_size;
+} Stream;
+
+static Stream g_streams[CHECK_MAX_STREAMS];
+static int g_stream_count;
+
+/* --- the decoders lzss_decode() replaced, kept verbatim --- */
+
+/* GRAPHICS.GOT: src/native/graphics_got.c decompress_lzss12(). */
+static int ref_lzss12(const uint8_t *src, int in_size,
+                      uint8_t *dst, int out_size) {
+    int si = 0, di = 0;
+    uint8_t flags = 0;
+    int bits_left = 0;
+
+    while (di < out_size) {
+        if (bits_left == 0) {
+            if (si >= in_size) break;
+            flags = src[si++];
+            bits_left = 8;
+        }
+        if (flags & 1) {
+            /* literal byte */
+            if (si >= in_size) break;
+            dst[di++] = src[si++];
+        } else {
+            /* back-reference */
+            if (si + 2 > in_size) break;
+            uint16_t word = (uint16_t)src[si] | ((uint16_t)src[si+1] << 8);
+            si += 2;
+            int count  = ((word >> 12) & 0x0F) + 2;
+            int offset = word & 0x0FFF;
+            if (offset == 0 || offset > di) break;
+            int j;
+            for (j = 0; j < count && di < out_size; j++) {
+                dst[di] = dst[di - offset];
+                di++;
+            }
+        }
+        flags >>= 1;
+        bits_left--;
+    }
+    return di;
+}
+
+/* GOTRES.DAT: src/utility/lzss.c lzss_decompress(). It trusts its input
+   (back-references are not range checked), so it only sees real entries. */
+static int ref_read_uint16le(const char* src, long* size, unsigned int* value) {
+  if (*size < 2) {
+    return 0;
+  }
+  *value = (unsigned int)(unsigned char)src[0]
+    | ((unsigned int)(unsigned char)src[1] << 8);
+  *size -= 2;
+  return 1;
+}
+
+static long ref_decompress(char* src, char* dst, long size) {
+  char data, x;
+  unsigned int decompressed_size, ignored, written, control
+  , upper_four_bits, count, offset;
+  long remaining, b, j;
+
+  remaining = size;
+  written = 0;
+  if (!ref_read_uint16le(src, &remaining, &decompressed_size)) {
+    return 0;
+  }
+  src += 2;
+  if (!ref_read_uint16le(src, &remaining, &ignored)) {
+    return 0;
+  }
+  src += 2;
+  while (written < decompressed_size) {
+    if (remaining <= 0) {
+      break;
+    }
+    data = *src;
+    src += 1;
+    remaining -= 1;
+    for (b = 0; b < 8; b += 1) {
+      if (written >= decompressed_size) {
+        break;
+      }
+      if (((data >> b) & 0x1)) {
+        if (remaining <= 0) {
+          return 0;
+        }
+        dst[written++] = *src;
+        src += 1;
+        remaining -= 1;
+      }
+      else {
+        if (!ref_read_uint16le(src, &remaining, &control)) {
+          return 0;
+        }
+        src += 2;
+        upper_four_bits = control >> 12;
+        count = upper_four_bits + 2;
+        offset = control & 0xFFF;
+        for (j = 0; j < count; j += 1) {
+          x = dst[written - offset];
+          dst[written++] = x;
+        }
+      }
+    }
+  }
+  return (long)decompressed_size;
+}
+
+/* --- stream collection --- */
+
+static uint8_t* g_res_blob;
+static graphics_got_t g_gg;
+
+static void add_stream(const char* name, const uint8_t* src, int in_size, int out_size) {
+  Stream* s;
+  if (g_stream_count >= CHECK_MAX_STREAMS) return;
+  s = &g_streams[g_stream_count++];
+  snprintf(s->name, sizeof(s->name), "%s", name);
+  s->src = src;
+  s->in_size = in_size;
+  s->out_size = out_size;
+}
+
+/* Real GOTRES.DAT entries through both header-aware decoders. Returns the
+   number of mismatching entries, or -1 if the archive can't be read. */
+static int check_gotres(int* checked) {
+  static char lzss_buff[65000];
+  static char out_ref[CHECK_OUT_MAX + CHECK_GUARD], out[CHECK_OUT_MAX + CHECK_GUARD];
+  FILE* fp;
+  long size;
+  int i, bad = 0;
+
+  fp = fopen("GOTRES.DAT", "rb");
+  if (!fp) return -1;
+  fseek(fp, 0, SEEK_END);
+  size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  g_res_blob = (uint8_t*)malloc((size_t)size);
+  if (!g_res_blob || fread(g_res_blob, 1, (size_t)size, fp) != (size_t)size) {
+    fclose(fp);
+    return -1;
+  }
+  fclose(fp);
+
+  res_init(lzss_buff);
+  if (res_open("GOTRES.DAT") < 0) return -1;
+  for (i = 0; i < RES_MAX_ENTRIES; i++) {
+    const RES_HEADER* h = &res_header[i];
+    char* src;
+    long a, b;
+    if (!h->name[0] || !h->key || h->length < 4 || h->offset + h->length > (uint32_t)size) continue;
+    src = (char*)g_res_blob + h->offset;
+    memset(out_ref, 0xA5, sizeof(out_ref));
+    memset(out, 0xA5, sizeof(out));
+    a = ref_decompress(src, out_ref, (long)h->length);
+    b = lzss_decompress(src, out, (long)h->length);
+    /* The old decoder can run a back-reference past the end; only the
+       decompressed size is meaningful. */
+    if (a != b || memcmp(out_ref, out, (size_t)a) != 0) {
+      printf("lzss: GOTRES.DAT %s differs\n", h->name);
+      bad++;
+    }
+    (*checked)++;
+    add_stream(h->name, (const uint8_t*)src + 4, (int)h->length - 4,
+               (int)h->original_size);
+  }
+  res_close();
+  return bad;
+}
+
+static int check_stream(const Stream* s, const uint8_t* src, int in_size, int out_size) {
+  static uint8_t out_ref[CHECK_OUT_MAX + CHECK_GUARD], out[CHECK_OUT_MAX + CHECK_GUARD];
+  int a, b;
+  memset(out_ref, 0xA5, sizeof(out_ref));
+  memset(out, 0xA5, sizeof(out));
+  a = ref_lzss12(src, in_size, out_ref, out_size);
+  b = (int)lzss_decode((const char*)src, in_size, (char*)out, out_size);
+  /* Past what it returns, lzss_decode may leave scratch bytes inside the
+     buffer, but must never write beyond out_size. */
+  if (a != b || memcmp(out_ref, out, (size_t)a) != 0 ||
+      memcmp(out_ref + out_size, out + out_size, CHECK_GUARD) != 0) {
+    printf("lzss: %s (in %d, out %d): reference %d bytes, lzss_decode %d\n", s->name,
+           in_size, out_size, a, b);
+    return 1;
+  }
+  return 0;
+}
+
+int lzss_check_run(int rounds) {
+  static uint8_t fuzz[CHECK_OUT_MAX];
+  static uint8_t out[CHECK_OUT_MAX + CHECK_GUARD];
+  uint32_t seed = 0x9e3779b9u;
+  int i, r, res_checked = 0, gg_checked = 0, bad = 0, fuzz_bad = 0;
+  double t0, t_ref, t_new, mb = 0.0;
+
+  if (rounds <= 0) rounds = 100000;
+
+  i = check_gotres(&res_checked);
+  if (i < 0) {
+    printf("lzss: can't read GOTRES.DAT\n");
+    return 1;
+  }
+  bad += i;
+
+  if (gg_load(&g_gg, "GRAPHICS.GOT") == 0) {
+    for (i = 0; i < g_gg.chunk_count; i++) {
+      const gg_chunk_desc_t* d = &g_gg.descs[i];
+      char name[16];
+      if (d->comp_type != 1 || (long)d->file_offset + d->in_size > g_gg.blob_size) continue;
+      snprintf(name, sizeof(name), "GFX%d", i);
+      add_stream(name, g_gg.blob + d->file_offset, d->in_size, d->out_size);
+      gg_checked++;
+    }
+  } else {
+    printf("lzss: no GRAPHICS.GOT, skipping its chunks\n");
+  }
+
+  for (i = 0; i < g_stream_count; i++) {
+    const Stream* s = &g_streams[i];
+    bad += check_stream(s, s->src, s->in_size, s->out_size);
+  }
+
+  /* Corrupt copies: flipped bytes, truncation, odd output sizes. */
+  for (r = 0; r < rounds && g_stream_count; r++) {
+    const Stream* s;
+    int in_size, out_size, flips, k;
+    seed = seed * 1664525u + 1013904223u;
+    s = &g_streams[(seed >> 8) % (uint32_t)g_stream_count];
+    in_size = s->in_size;
+    out_size = s->out_size;
+    memcpy(fuzz, s->src, (size_t)in_size);
+    seed = seed * 1664525u + 1013904223u;
+    flips = (int)((seed >> 8) % 4u);
+    for (k = 0; k < flips; k++) {
+      seed = seed * 1664525u + 1013904223u;
+      fuzz[(seed >> 8) % (uint32_t)in_size] ^= (uint8_t)(1u << (seed & 7u));
+    }
+    seed = seed * 1664525u + 1013904223u;
+    if (seed & 0x100u) in_size = (int)((seed >> 9) % (uint32_t)(in_size + 1));
+    seed = seed * 1664525u + 1013904223u;
+    if (seed & 0x100u) out_size = (int)((seed >> 9) % (uint32_t)(out_size + 1));
+    if (check_stream(s, fuzz, in_size, out_size) && ++fuzz_bad >= 8) break;
+  }
+
+  /* Throughput over the real streams. */
+  for (i = 0; i < g_stream_count; i++) mb += g_streams[i].out_size;
+  mb = mb * CHECK_TIME_PASSES / 1e6;
+  t0 = got_clock_wall_s();
+  for (r = 0; r < CHECK_TIME_PASSES; r++) {
+    for (i = 0; i < g_stream_count; i++) {
+      const Stream* s = &g_streams[i];
+      ref_lzss12(s->src, s->in_size, out, s->out_size);
+    }
+  }
+  t_ref = got_clock_wall_s() - t0;
+  t0 = got_clock_wall_s();
+  for (r = 0; r < CHECK_TIME_PASSES; r++) {
+    for (i = 0; i < g_stream_count; i++) {
+      const Stream* s = &g_streams[i];
+      lzss_decode((const char*)s->src, s->in_size, (char*)out, s->out_size);
+    }
+  }
+  t_new = got_clock_wall_s() - t0;
+
+  printf("lzss: %d GOTRES.DAT entries, %d GRAPHICS.GOT chunks, %d corrupted streams\n",
+         res_checked, gg_checked, rounds);
+  printf("  mismatches: %d real, %d corrupted\n", bad, fuzz_bad);
+  printf("  reference    %8.2f ms  %7.1f MB/s\n", t_ref * 1000.0, mb / t_ref);
+  printf("  lzss_decode  %8.2f ms  %7.1f MB/s  (%.2fx)\n", t_new * 1000.0, mb / t_new,
+         t_ref / t_new);
+
+  gg_free(&g_gg);
+  free(g_res_blob);
+  g_res_blob = NULL;
+  g_stream_count = 0;
+  return (bad || fuzz_bad) ? 1 : 0;
+}
+
+/* --- encoder benchmark --- */
+
+typedef long (*EncodeFn)(long origsize, char* src, char* dst);
+
+typedef struct {
+  const char* name;
+  EncodeFn fn;
+  double secs;
+  long out_bytes;
+} Encoder;
+
+int lzss_bench_encode(int passes) {
+  static char lzss_buff[65000];
+  static char in[CHECK_OUT_MAX], out_ref[CHECK_OUT_MAX * 2], out[CHECK_OUT_MAX * 2];
+  static char back[CHECK_OUT_MAX + CHECK_GUARD];
+  Encoder enc[3] = {
+    { "scan", lzss_compress_scan, 0.0, 0 },
+    { "chains", lzss_compress, 0.0, 0 },
+    { "best", lzss_compress_best, 0.0, 0 }
+  };
+  char names[RES_MAX_ENTRIES][9];
+  int count = 0, bad = 0, i, e, p;
+  long in_bytes = 0;
+  double mb;
+
+  if (passes <= 0) passes = 1;
+
+  res_init(lzss_buff);
+  if (res_open("GOTRES.DAT") < 0) {
+    printf("lzss: can't read GOTRES.DAT\n");
+    return 1;
+  }
+  for (i = 0; i < RES_MAX_ENTRIES; i++) {
+    if (res_header[i].name[0] && res_header[i].original_size <= 0xFFFF) {
+      memcpy(names[count++], res_header[i].name, 9);
+    }
+  }
+
+  for (i = 0; i < count; i++) {
+    long size = res_read(names[i], in);
+    long ref_size = 0;
+    if (size <= 0) continue;
+    in_bytes += size;
+    for (e = 0; e < 3; e++) {
+      double t0 = got_clock_wall_s();
+      long n = 0;
+      for (p = 0; p < passes; p++) n = enc[e].fn(size, in, e == 0 ? out_ref : out);
+      enc[e].secs += got_clock_wall_s() - t0;
+      enc[e].out_bytes += n;
+      if (e == 0) {
+        ref_size = n;
+      } else if (e == 1) {
+        if (n != ref_size || memcmp(out, out_ref, (size_t)n) != 0) {
+          printf("lzss: %s: chains output differs from scan\n", names[i]);
+          bad++;
+        }
+      } else {
+        memset(back, 0xA5, sizeof(back));
+        if (lzss_decompress(out, back, n) != size || memcmp(back, in, (size_t)size) != 0) {
+          printf("lzss: %s: best output does not round-trip\n", names[i]);
+          bad++;
+        }
+      }
+    }
+  }
+  res_close();
+
+  mb = (double)in_bytes * passes / 1e6;
+  printf("lzss encode: %d entries, %ld bytes x %d passes\n", count, in_bytes, passes);
+  for (e = 0; e < 3; e++) {
+    printf("  %-7s %9.1f ms  %7.2f MB/s  %8ld bytes  ratio %.3f", enc[e].name,
+           enc[e].secs * 1000.0, mb / enc[e].secs, enc[e].out_bytes,
+           (double)enc[e].out_bytes / in_bytes);
+    if (e) printf("  (%.1fx scan)", enc[0].secs / enc[e].secs);
+    printf("\n");
+  }
+  printf("  mismatches: %d\n", bad);
+  return bad ? 1 : 0;
+}
@@ -0,0 +1,25 @@
+#ifndef LZSS_CHECK_H
+#define LZSS_CHECK_H
+
+/* LZSS decoder equivalence check (got --check-lzss [rounds]).
+
+   Decodes every compressed GOTRES.DAT entry and every LZSS12 GRAPHICS.GOT
+   chunk (both from the current directory) with lzss_decode() and with the
+   byte-at-a-time decoders it replaced, and requires identical output. Then
+   feeds both `rounds` randomly corrupted or truncated copies of those
+   streams, comparing return values, the bytes returned and a guard area
+   past the end of the output (so an overrun shows up), and times the two
+   on the real data. Prints a
+   summary to stdout. Returns 0 on success. */
+int lzss_check_run(int rounds);
+
+/* LZSS encoder benchmark (got --bench-lzss [passes]).
+
+   Compresses the payload of every GOTRES.DAT entry with the original
+   brute-force search (lzss_compress_scan), the hash-chain greedy encoder
+   (lzss_compress, which must produce the same bytes) and the optimal parse
+   (lzss_compress_best, which must decode back to the input), and prints
+   MB/s and compression ratio for each. Returns 0 on success. */
+int lzss_bench_encode(int passes);
+
+#endif
@@ -4,7 +4,19 @@
 
 #include "raylib.h"
 #include "emscripten_fs.h"
+#include "got_clock.h"
+#include "got_platform.h"
+#include "got_replay.h"
+#include "pal_expand.h"
+#include "audio_stress.h"
+#include "res_bench.h"
+#include "lzss_check.h"
+#include "res_man.h"
+#include "music_cache.h"
+#include "opl2_emu.h"
 #include "episode.h"
+#include "snapshot.h"
+#include "rewind.h"
 #include "launcher.h"
 
 /* Unified entrypoint. In the native build, src/game/main.c renames its
@@ -15,6 +27,9 @@ void got_game_main(int argc, char** argv);
    When set, we exit the process instead of returning to the launcher. */
 extern int got_wants_quit;
 
+/* SPEAK scripts, compiled against text interpreter (game/script_vm.c). */
+int script_check_run(void);
+
 /* Parse --episode N / -e N / bare "1"/"2"/"3" from argv.
  * Returns 0 if no episode specified (show launcher). */
 static int parse_episode(int argc, char **argv) {
@@ -32,9 +47,171 @@ static int parse_episode(int argc, char **argv) {
   return 0; /* no episode specified → show launcher */
 }
 
+/* --headless on the command line or GOT_HEADLESS=1 in the environment. */
+static int parse_headless(int argc, char **argv) {
+  const char *env = getenv("GOT_HEADLESS");
+  int i;
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--headless") == 0) return 1;
+  }
+  return (env && env[0] && strcmp(env, "0") != 0) ? 1 : 0;
+}
+
+/* --record FILE / --replay FILE. Arms the replay module; the file is opened
+   here, before the working directory changes. */
+static int parse_replay(int argc, char **argv) {
+  int i;
+  for (i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], "--record") == 0) return got_replay_record(argv[i + 1]);
+    if (strcmp(argv[i], "--replay") == 0) return got_replay_load(argv[i + 1]);
+  }
+  return 0;
+}
+
+/* --rewind-budget MB (0 turns rewinding off) and --rewind-keyframe N
+   (frames between keyframes). */
+static void parse_rewind(int argc, char **argv) {
+  long budget_mb = -1;
+  int keyframe = 0, i;
+  for (i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], "--rewind-budget") == 0) budget_mb = atol(argv[i + 1]);
+    if (strcmp(argv[i], "--rewind-keyframe") == 0) keyframe = atoi(argv[i + 1]);
+  }
+  if (budget_mb >= 0 || keyframe > 0) {
+    rewind_config(budget_mb >= 0 ? budget_mb * 1024l * 1024l : -1, keyframe);
+  }
+}
+
+/* --clock realtime|free. Returns -1 when not given. */
+static int parse_clock_mode(int argc, char **argv) {
+  int i;
+  for (i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], "--clock") == 0) {
+      if (strcmp(argv[i + 1], "free") == 0) return GOT_CLOCK_FREE;
+      if (strcmp(argv[i + 1], "realtime") == 0) return GOT_CLOCK_REALTIME;
+    }
+  }
+  return -1;
+}
+
+/* --present cpu|gpu|check or GOT_PRESENT=... Returns -1 when not given. */
+static int parse_present_mode(int argc, char **argv) {
+  const char *mode = getenv("GOT_PRESENT");
+  int i;
+  for (i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], "--present") == 0) mode = argv[i + 1];
+  }
+  if (!mode) return -1;
+  if (strcmp(mode, "cpu") == 0) return GOT_PRESENT_CPU;
+  if (strcmp(mode, "gpu") == 0) return GOT_PRESENT_GPU;
+  if (strcmp(mode, "check") == 0) return GOT_PRESENT_CHECK;
+  return -1;
+}
+
+/* --music live|cached or GOT_MUSIC=... Returns -1 when not given. */
+static int parse_music_cache(int argc, char **argv) {
+  const char *mode = getenv("GOT_MUSIC");
+  int i;
+  for (i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], "--music") == 0) mode = argv[i + 1];
+  }
+  if (!mode) return -1;
+  if (strcmp(mode, "live") == 0) return 0;
+  if (strcmp(mode, "cached") == 0) return 1;
+  return -1;
+}
+
+/* --res-cache KB or GOT_RES_CACHE_KB=...: decoded-resource cache budget
+   (0 turns it off). Returns -1 when not given. */
+static long parse_res_cache_kb(int argc, char **argv) {
+  const char *kb = getenv("GOT_RES_CACHE_KB");
+  int i;
+  for (i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], "--res-cache") == 0) kb = argv[i + 1];
+  }
+  if (!kb || !kb[0]) return -1;
+  return atol(kb);
+}
+
 int main(int argc, char** argv) {
-  int episode = parse_episode(argc, argv);
-  int from_cli = (episode != 0);
+  int episode, from_cli, clock_mode, present_mode, music_cache;
+  long res_cache_kb;
+  int i;
+
+  /* --bench-palette [frames]: index->RGBA expansion microbenchmark. */
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--bench-palette") == 0) {
+      int frames = (i + 1 < argc) ? atoi(argv[i + 1]) : 0;
+      return pal_expand_bench(frames);
+    }
+    /* --bench-res [rounds]: resource name lookup, index vs linear scan. */
+    if (strcmp(argv[i], "--bench-res") == 0) {
+      int rounds = (i + 1 < argc) ? atoi(argv[i + 1]) : 0;
+      return res_find_bench(rounds);
+    }
+    /* --check-lzss [rounds]: shared LZSS decoder against the old ones. */
+    if (strcmp(argv[i], "--check-lzss") == 0) {
+      int rounds = (i + 1 < argc) ? atoi(argv[i + 1]) : 0;
+      return lzss_check_run(rounds);
+    }
+    /* --bench-lzss [passes]: LZSS encoders, speed and ratio. */
+    if (strcmp(argv[i], "--bench-lzss") == 0) {
+      int passes = (i + 1 < argc) ? atoi(argv[i + 1]) : 0;
+      return lzss_bench_encode(passes);
+    }
+    /* --check-scripts [episode]: compiled scripts against the text ones. */
+    if (strcmp(argv[i], "--check-scripts") == 0) {
+      int ep_num = (i + 1 < argc) ? atoi(argv[i + 1]) : 0;
+      got_episode_select(ep_num ? ep_num : 1);
+      return script_check_run();
+    }
+    /* --stress-audio [seconds]: game/audio thread handoff stress check. */
+    if (strcmp(argv[i], "--stress-audio") == 0) {
+      int seconds = (i + 1 < argc) ? atoi(argv[i + 1]) : 0;
+      return audio_stress_run(seconds);
+    }
+  }
+
+  episode = parse_episode(argc, argv);
+  from_cli = (episode != 0);
+  clock_mode = parse_clock_mode(argc, argv);
+  if (parse_replay(argc, argv) < 0) return 1;
+  /* --check-snapshot N: replay each N frames twice, the second time from a
+     restored snapshot (game/snapshot.c). */
+  for (i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], "--check-snapshot") == 0) snapshot_check_every(atoi(argv[i + 1]));
+  }
+  /* --check-rewind N: every frame through the rewind ring and back, and
+     every N frames N/2 of them played again after stepping back
+     (game/rewind.c). */
+  parse_rewind(argc, argv);
+  for (i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], "--check-rewind") == 0) rewind_check_every(atoi(argv[i + 1]));
+  }
+  /* A replay plays its own episode, once. */
+  if (got_replay_mode() == GOT_REPLAY_PLAY) {
+    episode = got_replay_start_info()->episode;
+    from_cli = 1;
+  }
+
+  /* Headless runs have no launcher; default to episode 1 when none given.
+     Nobody is watching, so the clock free-runs unless asked otherwise. */
+  if (parse_headless(argc, argv)) {
+    got_platform_set_headless(1);
+    if (episode == 0) episode = 1;
+    from_cli = 1;
+    if (clock_mode < 0) clock_mode = GOT_CLOCK_FREE;
+  }
+  if (clock_mode >= 0) got_clock_set_mode(clock_mode);
+  /* Free-running, the game outruns the audio device; OPL writes can't
+     wait for their sample. */
+  opl2_set_timed(got_clock_mode() == GOT_CLOCK_REALTIME);
+  present_mode = parse_present_mode(argc, argv);
+  if (present_mode >= 0) got_platform_set_present_mode(present_mode);
+  music_cache = parse_music_cache(argc, argv);
+  if (music_cache >= 0) music_cache_set_enabled(music_cache);
+  res_cache_kb = parse_res_cache_kb(argc, argv);
+  if (res_cache_kb >= 0) res_cache_budget(res_cache_kb * 1024l);
 
   /* Change to the directory containing the executable so that data files
      (GOTRES.DAT, GRAPHICS.GOT, etc.) are found when the binary is launched
@@ -63,6 +240,10 @@ int main(int argc, char** argv) {
     got_game_main(argc, argv);
 
     /* "Quit to DOS" or CLI mode → exit the process. */
+    if (got_replay_mode() != GOT_REPLAY_OFF) {
+      got_replay_finish();
+      return got_replay_status();
+    }
     if (from_cli || got_wants_quit) return 0;
 
     /* Game ended naturally (completed, died, etc.) → return to launcher. */
@@ -1,20 +1,75 @@
 #include "mixer.h"
+#include "spsc_ring.h"
 
 #include <stdlib.h>
 #include <string.h>
 
 #if defined(__EMSCRIPTEN__)
-/* Emscripten builds may be single-threaded (no audio callback thread). Keep
-   the mixer lock-free to avoid requiring pthreads. */
+/* Emscripten builds may be single-threaded (no audio callback thread). */
 #  define MIXER_NO_THREADS 1
 #elif defined(_WIN32)
 #  include <windows.h>
 #else
-#  include <pthread.h>
+#  include <sched.h>
 #endif
 
+/* Threading model
+
+   mixer_generate() runs on the platform audio callback thread; everything
+   else is called from the game thread. The two never share a lock: the game
+   thread posts MixerCmds into a wait-free SPSC ring that mixer_generate()
+   drains before mixing, and the audio thread hands finished PCM buffers (and
+   music streams) back through a second ring so it never calls free(). The game thread keeps its
+   own view of the sample channel (play/stop sequence numbers) so
+   mixer_is_sample_playing() answers immediately, and the sound-finished
+   callback is delivered on the game thread by mixer_service().
+
+   No command is lost when the ring is full. Until it has room again, the
+   latest command for each control (the sample channel, the PC speaker
+   divisor, OPL2 output, the music stream and its pause) waits on the game
+   thread; a play or stop replaces whatever the sample channel held, and a
+   new music stream drops a held pause, as applying them in order would.
+   Every later command and every mixer_service() flushes them first. */
+
 enum { MIXER_OPL2_RATE = 49716 };
 enum { OPL2_RING_SIZE = 8192 };
+enum {
+  MIXER_CMD_RING = 256,
+  /* Every queued or playing sample/music stream can come back at most once
+     before the game thread collects, so this never fills. */
+  MIXER_FREE_RING = 512
+};
+
+typedef enum {
+  MIXER_CMD_PLAY = 0,
+  MIXER_CMD_STOP,
+  MIXER_CMD_PC_DIVISOR,
+  MIXER_CMD_OPL2_ENABLED,
+  MIXER_CMD_MUSIC,
+  MIXER_CMD_MUSIC_PAUSE
+} MixerCmdType;
+
+/* Controls a command can be held for, in the order they are flushed. */
+typedef enum {
+  MIXER_HOLD_SAMPLE = 0, /* PLAY or STOP */
+  MIXER_HOLD_PC_DIVISOR,
+  MIXER_HOLD_OPL2_ENABLED,
+  MIXER_HOLD_MUSIC,
+  MIXER_HOLD_MUSIC_PAUSE,
+  MIXER_HOLD_COUNT
+} MixerHold;
+
+typedef struct {
+  int type;
+  int16_t* pcm;
+  uint32_t frames;
+  uint32_t rate;
+  uint32_t seq;
+  int is_voc;
+  uint16_t divisor;
+  int enabled;
+  MusicStream* music;
+} MixerCmd;
 
 /* Fixed-point 16.16 resampler state. */
 typedef struct {
@@ -23,6 +78,7 @@ typedef struct {
   uint32_t rate;
   uint32_t pos_fp;
   uint32_t step_fp;
+  uint32_t seq;
   int playing;
   int is_voc;
 } SampleState;
@@ -40,6 +96,10 @@ typedef struct {
   uint32_t count;
   uint64_t base_abs; /* abs index of ring[head] */
   uint64_t gen_abs;  /* abs index of next to generate */
+
+  /* Pre-rendered music replaces opl2_generate() output while set. */
+  MusicStream* music;
+  int music_paused;
 } Opl2State;
 
 typedef struct {
@@ -49,19 +109,33 @@ typedef struct {
 } PcSpkState;
 
 typedef struct {
-#if defined(MIXER_NO_THREADS)
-  int dummy;
-#elif defined(_WIN32)
-  CRITICAL_SECTION mtx;
-#else
-  pthread_mutex_t mtx;
-#endif
+  /* Game thread. */
   int initialized;
-  int shutting_down;
   uint32_t out_rate;
-
   SoundFinishedCallback finished_cb;
-
+  uint32_t play_seq;    /* latest play request */
+  uint32_t stopped_seq; /* latest request stopped/preempted by the game side */
+  uint32_t cb_seq;      /* finished_seq already delivered to finished_cb */
+  int play_is_voc;
+  uint32_t cmds_sent;
+  uint32_t cmds_coalesced;
+  /* Commands waiting for room in cmd_ring. */
+  MixerCmd held[MIXER_HOLD_COUNT];
+  int held_set[MIXER_HOLD_COUNT];
+  int held_count;
+
+  /* Game thread -> audio thread. */
+  SpscRing cmd_ring;
+  MixerCmd cmd_slots[MIXER_CMD_RING];
+  /* Audio thread -> game thread: PCM buffers and music streams to free(). */
+  SpscRing free_ring;
+  void* free_slots[MIXER_FREE_RING];
+
+  volatile uint32_t running;      /* audio thread may mix */
+  volatile uint32_t in_generate;  /* audio thread is inside mixer_generate() */
+  volatile uint32_t finished_seq; /* last sample that played to its end */
+
+  /* Audio thread (after init). */
   SampleState sfx;
   Opl2State opl2;
   PcSpkState pc;
@@ -69,41 +143,27 @@ typedef struct {
 
 static MixerState g_m;
 
-static void mixer_lock(void) {
-#if defined(MIXER_NO_THREADS)
-  /* no-op */
-#elif defined(_WIN32)
-  EnterCriticalSection(&g_m.mtx);
-#else
-  pthread_mutex_lock(&g_m.mtx);
-#endif
-}
-
-static void mixer_unlock(void) {
+static void mixer_yield(void) {
 #if defined(MIXER_NO_THREADS)
   /* no-op */
 #elif defined(_WIN32)
-  LeaveCriticalSection(&g_m.mtx);
+  Sleep(0);
 #else
-  pthread_mutex_unlock(&g_m.mtx);
+  sched_yield();
 #endif
 }
 
-void mixer_lock_state(void) {
-  if (!g_m.initialized) return;
-  mixer_lock();
-}
-
-void mixer_unlock_state(void) {
-  if (!g_m.initialized) return;
-  mixer_unlock();
+/* Audio thread: hand a buffer back to the game thread to free(). */
+static void mixer_release(void* p) {
+  if (p && !spsc_push(&g_m.free_ring, &p)) {
+    free(p); /* unreachable, see MIXER_FREE_RING */
+  }
 }
 
+/* Audio thread: hand the sample's PCM back to the game thread and clear it. */
 static void sample_reset(SampleState* s) {
   if (!s) return;
-  if (s->pcm) {
-    free(s->pcm);
-  }
+  mixer_release(s->pcm);
   memset(s, 0, sizeof(*s));
 }
 
@@ -247,7 +307,16 @@ static void opl2_ensure_available(Opl2State* o, uint64_t need_abs_inclusive) {
     gen = (uint32_t)free_slots;
     if (gen > 512u) gen = 512u;
 
-    opl2_generate(tmp, (int)gen);
+    if (o->music) {
+      if (o->music_paused) {
+        memset(tmp, 0, gen * sizeof(int16_t));
+      } else {
+        music_stream_read(o->music, tmp, (int)gen);
+      }
+      opl2_skip((int)gen);
+    } else {
+      opl2_generate(tmp, (int)gen);
+    }
     opl2_ring_push(o, tmp, gen);
   }
 }
@@ -321,95 +390,183 @@ void mixer_init(int sample_rate) {
 
   memset(&g_m, 0, sizeof(g_m));
 
-#if defined(MIXER_NO_THREADS)
-  /* no-op */
-#elif defined(_WIN32)
-  InitializeCriticalSection(&g_m.mtx);
-#else
-  pthread_mutex_init(&g_m.mtx, NULL);
-#endif
-
   g_m.initialized = 1;
-  g_m.shutting_down = 0;
   g_m.out_rate = (uint32_t)sample_rate;
   g_m.finished_cb = NULL;
 
+  spsc_init(&g_m.cmd_ring, g_m.cmd_slots, sizeof(MixerCmd), MIXER_CMD_RING);
+  spsc_init(&g_m.free_ring, g_m.free_slots, sizeof(void*), MIXER_FREE_RING);
+
   sample_reset(&g_m.sfx);
   opl2_reset(&g_m.opl2, g_m.out_rate);
 
   g_m.pc.divisor = 0;
   g_m.pc.phase01 = 0.0;
   g_m.pc.step01 = 0.0;
+
+  /* Publish last: the audio thread may start mixing right after this. */
+  spsc_atomic_store(&g_m.running, 1);
+}
+
+/* Game thread: free buffers the audio thread is done with. */
+static void mixer_collect(void) {
+  void* p;
+  while (spsc_pop(&g_m.free_ring, &p)) {
+    free(p);
+  }
+}
+
+static int mixer_push(const MixerCmd* cmd) {
+  if (!spsc_push(&g_m.cmd_ring, cmd)) return 0;
+  g_m.cmds_sent++;
+  return 1;
+}
+
+static MixerHold mixer_hold_of(int type) {
+  switch (type) {
+    case MIXER_CMD_PC_DIVISOR: return MIXER_HOLD_PC_DIVISOR;
+    case MIXER_CMD_OPL2_ENABLED: return MIXER_HOLD_OPL2_ENABLED;
+    case MIXER_CMD_MUSIC: return MIXER_HOLD_MUSIC;
+    case MIXER_CMD_MUSIC_PAUSE: return MIXER_HOLD_MUSIC_PAUSE;
+    default: return MIXER_HOLD_SAMPLE;
+  }
+}
+
+/* Game thread: forgets a held command, freeing what it carried. */
+static void mixer_unhold(int h) {
+  if (!g_m.held_set[h]) return;
+  if (g_m.held[h].type == MIXER_CMD_PLAY && g_m.held[h].pcm) free(g_m.held[h].pcm);
+  if (g_m.held[h].type == MIXER_CMD_MUSIC && g_m.held[h].music) free(g_m.held[h].music);
+  g_m.held_set[h] = 0;
+  g_m.held_count--;
+}
+
+/* Game thread: moves held commands into the ring while it has room. */
+static void mixer_flush_held(void) {
+  int h;
+  for (h = 0; h < MIXER_HOLD_COUNT && g_m.held_count; h++) {
+    if (!g_m.held_set[h]) continue;
+    if (!mixer_push(&g_m.held[h])) return;
+    g_m.held_set[h] = 0;
+    g_m.held_count--;
+  }
+}
+
+static void mixer_post(const MixerCmd* cmd) {
+  MixerHold h;
+  mixer_flush_held();
+  if (!g_m.held_count && mixer_push(cmd)) return;
+  /* Ring full, or earlier commands still held: hold this one too. */
+  h = mixer_hold_of(cmd->type);
+  if (g_m.held_set[h]) {
+    mixer_unhold(h);
+    g_m.cmds_coalesced++;
+  }
+  if (h == MIXER_HOLD_MUSIC && g_m.held_set[MIXER_HOLD_MUSIC_PAUSE]) {
+    mixer_unhold(MIXER_HOLD_MUSIC_PAUSE);
+    g_m.cmds_coalesced++;
+  }
+  g_m.held[h] = *cmd;
+  g_m.held_set[h] = 1;
+  g_m.held_count++;
 }
 
 void mixer_shutdown(void) {
+  MixerCmd cmd;
+  int h;
+
   if (!g_m.initialized) {
     return;
   }
 
-  mixer_lock();
-  g_m.shutting_down = 1;
-  sample_reset(&g_m.sfx);
-  g_m.opl2.count = 0;
-  g_m.opl2.head = 0;
-  g_m.opl2.base_abs = 0;
-  g_m.opl2.gen_abs = 0;
-  g_m.pc.divisor = 0;
-  g_m.pc.step01 = 0.0;
-  g_m.pc.phase01 = 0.0;
-  g_m.finished_cb = NULL;
-  mixer_unlock();
+  /* Stop the audio thread from entering and wait out a callback already in
+     flight; after that it never touches g_m again, so its state is ours. */
+  spsc_atomic_store(&g_m.running, 0);
+  while (spsc_atomic_load(&g_m.in_generate)) {
+    mixer_yield();
+  }
 
-#if defined(MIXER_NO_THREADS)
-  /* no-op */
-#elif defined(_WIN32)
-  DeleteCriticalSection(&g_m.mtx);
-#else
-  pthread_mutex_destroy(&g_m.mtx);
-#endif
+  if (g_m.sfx.pcm) free(g_m.sfx.pcm);
+  if (g_m.opl2.music) free(g_m.opl2.music);
+  for (h = 0; h < MIXER_HOLD_COUNT; h++) mixer_unhold(h);
+  while (spsc_pop(&g_m.cmd_ring, &cmd)) {
+    if (cmd.type == MIXER_CMD_PLAY && cmd.pcm) free(cmd.pcm);
+    if (cmd.type == MIXER_CMD_MUSIC && cmd.music) free(cmd.music);
+  }
+  mixer_collect();
 
   memset(&g_m, 0, sizeof(g_m));
 }
 
 void mixer_set_sound_finished_callback(SoundFinishedCallback cb) {
   if (!g_m.initialized) return;
-  mixer_lock();
   g_m.finished_cb = cb;
-  mixer_unlock();
 }
 
 void mixer_set_opl2_enabled(int enabled) {
+  MixerCmd cmd;
   if (!g_m.initialized) return;
-  mixer_lock();
-  g_m.opl2.enabled = enabled ? 1 : 0;
-  mixer_unlock();
+  memset(&cmd, 0, sizeof(cmd));
+  cmd.type = MIXER_CMD_OPL2_ENABLED;
+  cmd.enabled = enabled ? 1 : 0;
+  mixer_post(&cmd);
 }
 
 void mixer_set_pc_divisor(uint16_t divisor) {
-  /* Frequency = 1193182 / divisor (PIT input clock). */
+  MixerCmd cmd;
   if (!g_m.initialized) return;
+  memset(&cmd, 0, sizeof(cmd));
+  cmd.type = MIXER_CMD_PC_DIVISOR;
+  cmd.divisor = divisor;
+  mixer_post(&cmd);
+}
 
-  mixer_lock();
-  g_m.pc.divisor = divisor;
-  if (divisor == 0) {
-    g_m.pc.step01 = 0.0;
-  } else {
-    double pit = 1193182.0;
-    double freq = pit / (double)divisor;
-    g_m.pc.step01 = freq / (double)g_m.out_rate;
+void mixer_play_music(MusicStream* s) {
+  MixerCmd cmd;
+  if (!g_m.initialized) {
+    free(s);
+    return;
   }
-  mixer_unlock();
+  mixer_collect();
+  memset(&cmd, 0, sizeof(cmd));
+  cmd.type = MIXER_CMD_MUSIC;
+  cmd.music = s;
+  mixer_post(&cmd);
+}
+
+void mixer_pause_music(int paused) {
+  MixerCmd cmd;
+  if (!g_m.initialized) return;
+  memset(&cmd, 0, sizeof(cmd));
+  cmd.type = MIXER_CMD_MUSIC_PAUSE;
+  cmd.enabled = paused ? 1 : 0;
+  mixer_post(&cmd);
 }
 
 void mixer_play_pcm16(int16_t* pcm16, uint32_t frames, uint32_t src_rate, int is_voc) {
+  MixerCmd cmd;
+
   if (!g_m.initialized) {
     if (pcm16) free(pcm16);
     return;
   }
 
-  mixer_lock();
-  sample_start(&g_m.sfx, pcm16, frames, src_rate, is_voc, g_m.out_rate);
-  mixer_unlock();
+  mixer_collect();
+
+  memset(&cmd, 0, sizeof(cmd));
+  cmd.type = MIXER_CMD_PLAY;
+  cmd.pcm = pcm16;
+  cmd.frames = frames;
+  cmd.rate = src_rate;
+  cmd.is_voc = is_voc ? 1 : 0;
+  cmd.seq = ++g_m.play_seq;
+  g_m.play_is_voc = cmd.is_voc;
+
+  /* The request preempts whatever is playing even if it is empty. */
+  if (!(pcm16 && frames && src_rate)) {
+    g_m.stopped_seq = cmd.seq;
+  }
+  mixer_post(&cmd);
 }
 
 void mixer_play_u8_pcm(const uint8_t* pcm_u8, uint32_t bytes, uint32_t src_rate, int is_voc) {
@@ -441,55 +598,132 @@ void mixer_play_silence(uint32_t frames, uint32_t src_rate) {
   mixer_play_pcm16(pcm16, frames, src_rate, 0);
 }
 
+int mixer_is_sample_playing(void) {
+  uint32_t finished;
+  if (!g_m.initialized) return 0;
+  if (g_m.play_seq == 0 || g_m.play_seq == g_m.stopped_seq) return 0;
+  finished = spsc_atomic_load(&g_m.finished_seq);
+  return (finished != g_m.play_seq) ? 1 : 0;
+}
+
+int mixer_is_voc_playing(void) {
+  return (mixer_is_sample_playing() && g_m.play_is_voc) ? 1 : 0;
+}
+
 void mixer_stop_sample(int call_finished_callback) {
   SoundFinishedCallback cb = NULL;
+  MixerCmd cmd;
 
   if (!g_m.initialized) return;
 
-  mixer_lock();
-  if (g_m.sfx.playing) {
-    sample_reset(&g_m.sfx);
+  mixer_collect();
+  if (mixer_is_sample_playing()) {
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.type = MIXER_CMD_STOP;
+    mixer_post(&cmd);
+    g_m.stopped_seq = g_m.play_seq;
+    /* If it races to its natural end, don't report it again. */
+    g_m.cb_seq = g_m.play_seq;
     if (call_finished_callback) {
       cb = g_m.finished_cb;
     }
   }
-  mixer_unlock();
 
   if (cb) {
     cb();
   }
 }
 
-int mixer_is_sample_playing(void) {
-  int playing;
-  if (!g_m.initialized) return 0;
-  mixer_lock();
-  playing = g_m.sfx.playing ? 1 : 0;
-  mixer_unlock();
-  return playing;
+void mixer_service(void) {
+  uint32_t finished;
+
+  if (!g_m.initialized) return;
+
+  mixer_collect();
+  mixer_flush_held();
+
+  finished = spsc_atomic_load(&g_m.finished_seq);
+  if (finished != g_m.cb_seq) {
+    g_m.cb_seq = finished;
+    if (finished > g_m.stopped_seq && g_m.finished_cb) {
+      g_m.finished_cb();
+    }
+  }
 }
 
-int mixer_is_voc_playing(void) {
-  int playing;
-  if (!g_m.initialized) return 0;
-  mixer_lock();
-  playing = (g_m.sfx.playing && g_m.sfx.is_voc) ? 1 : 0;
-  mixer_unlock();
-  return playing;
+void mixer_get_stats(uint32_t* out_sent, uint32_t* out_coalesced) {
+  if (out_sent) *out_sent = g_m.cmds_sent;
+  if (out_coalesced) *out_coalesced = g_m.cmds_coalesced;
+}
+
+int mixer_held_commands(void) {
+  return g_m.held_count;
+}
+
+void mixer_get_controls(MixerControls* out) {
+  out->play_seq = g_m.play_seq;
+  out->sample_seq = g_m.sfx.playing ? g_m.sfx.seq : 0;
+  out->pc_divisor = g_m.pc.divisor;
+  out->opl2_enabled = g_m.opl2.enabled;
+  out->music = g_m.opl2.music;
+  out->music_paused = g_m.opl2.music_paused;
+}
+
+/* Audio thread: apply everything the game thread queued since last time. */
+static void mixer_apply_commands(void) {
+  MixerCmd cmd;
+  while (spsc_pop(&g_m.cmd_ring, &cmd)) {
+    switch (cmd.type) {
+      case MIXER_CMD_PLAY:
+        sample_start(&g_m.sfx, cmd.pcm, cmd.frames, cmd.rate, cmd.is_voc, g_m.out_rate);
+        g_m.sfx.seq = cmd.seq;
+        break;
+      case MIXER_CMD_STOP:
+        sample_reset(&g_m.sfx);
+        break;
+      case MIXER_CMD_PC_DIVISOR:
+        /* Frequency = 1193182 / divisor (PIT input clock). */
+        g_m.pc.divisor = cmd.divisor;
+        if (cmd.divisor == 0) {
+          g_m.pc.step01 = 0.0;
+        } else {
+          double pit = 1193182.0;
+          double freq = pit / (double)cmd.divisor;
+          g_m.pc.step01 = freq / (double)g_m.out_rate;
+        }
+        break;
+      case MIXER_CMD_OPL2_ENABLED:
+        g_m.opl2.enabled = cmd.enabled;
+        break;
+      case MIXER_CMD_MUSIC:
+        mixer_release(g_m.opl2.music);
+        g_m.opl2.music = cmd.music;
+        g_m.opl2.music_paused = 0;
+        break;
+      case MIXER_CMD_MUSIC_PAUSE:
+        g_m.opl2.music_paused = cmd.enabled;
+        break;
+      default:
+        break;
+    }
+  }
 }
 
 void mixer_generate(int16_t* buf, int frames) {
   int i;
-  SoundFinishedCallback cb_to_call = NULL;
 
   if (!buf || frames <= 0) return;
 
-  if (!g_m.initialized) {
+  /* Pairs with mixer_shutdown(): either it sees us inside, or we see it has
+     stopped us. */
+  spsc_atomic_store(&g_m.in_generate, 1);
+  if (!spsc_atomic_load(&g_m.running)) {
+    spsc_atomic_store(&g_m.in_generate, 0);
     memset(buf, 0, (size_t)frames * sizeof(int16_t));
     return;
   }
 
-  mixer_lock();
+  mixer_apply_commands();
 
   /* Simple fixed volumes (Q8.8). */
   {
@@ -510,18 +744,11 @@ void mixer_generate(int16_t* buf, int frames) {
         int16_t s = sample_resample_next(&g_m.sfx, &finished);
         acc += ((int32_t)s * (int32_t)vol_sfx) >> 8;
         if (finished) {
-          /* Free PCM now to release memory quickly. */
-          if (g_m.sfx.pcm) {
-            free(g_m.sfx.pcm);
-            g_m.sfx.pcm = NULL;
-          }
-          g_m.sfx.frames = 0;
-          g_m.sfx.rate = 0;
-          g_m.sfx.pos_fp = 0;
-          g_m.sfx.step_fp = 0;
-          g_m.sfx.playing = 0;
-          g_m.sfx.is_voc = 0;
-          cb_to_call = g_m.finished_cb;
+          /* Release PCM now to free memory quickly; mixer_service() reports
+             the completion on the game thread. */
+          uint32_t seq = g_m.sfx.seq;
+          sample_reset(&g_m.sfx);
+          spsc_atomic_store(&g_m.finished_seq, seq);
         }
       }
 
@@ -534,12 +761,7 @@ void mixer_generate(int16_t* buf, int frames) {
     }
   }
 
-  mixer_unlock();
-
-  /* Call without holding the mutex to avoid deadlocks/re-entrancy issues. */
-  if (cb_to_call) {
-    cb_to_call();
-  }
+  spsc_atomic_store(&g_m.in_generate, 0);
 }
 
 /* Weak fallback so native builds link even if the OPL2 emulator isn't wired up
@@ -553,4 +775,9 @@ void opl2_generate(int16_t* out, int frames) {
   if (!out || frames <= 0) return;
   memset(out, 0, (size_t)frames * sizeof(int16_t));
 }
+
+__attribute__((weak))
+void opl2_skip(int frames) {
+  (void)frames;
+}
 #endif
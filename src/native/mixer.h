@@ -4,6 +4,7 @@
 #include <stdint.h>
 
 #include "digisnd.h"
+#include "music_cache.h"
 
 /* Mixer output format: 16-bit signed PCM, mono. */
 
@@ -17,17 +18,35 @@
  * emulator isn't wired up yet.
  */
 void opl2_generate(int16_t* out, int frames);
+/* Keeps the emulator's register-write timeline in step while its output is
+ * replaced by pre-rendered music; same weak fallback.
+ */
+void opl2_skip(int frames);
 
 void mixer_init(int sample_rate);
 void mixer_shutdown(void);
 
-/* Called by the platform audio callback. */
+/* Called by the platform audio callback. Lock-free: control calls below are
+ * queued from the game thread and applied at the start of the next call.
+ */
 void mixer_generate(int16_t* buf, int frames);
 
+/* Game thread, at the 120Hz service rate: frees PCM the audio thread is done
+ * with and delivers the sound-finished callback.
+ */
+void mixer_service(void);
+
 /* Control of sources. */
 void mixer_set_opl2_enabled(int enabled);
 void mixer_set_pc_divisor(uint16_t divisor);
 
+/* Pre-rendered music in place of the OPL2 emulator's output. Ownership of
+ * `s` is transferred to the mixer (it will free() it); NULL goes back to
+ * live emulation. Paused music outputs silence and resumes where it was.
+ */
+void mixer_play_music(MusicStream* s);
+void mixer_pause_music(int paused);
+
 /* Sample/VOC playback (single channel, preemptive). `pcm16` ownership is
  * transferred to the mixer (it will free() it).
  */
@@ -39,15 +58,30 @@ void mixer_stop_sample(int call_finished_callback);
 int mixer_is_sample_playing(void);
 int mixer_is_voc_playing(void);
 
+/* The callback runs on the game thread, from mixer_service() or
+ * mixer_stop_sample(1).
+ */
 void mixer_set_sound_finished_callback(SoundFinishedCallback cb);
 
-/* Optional external synchronization hook.
- *
- * If another subsystem (e.g. OPL2 register writes) needs to synchronize with
- * mixer generation on platforms where audio runs on a separate thread, it can
- * take this lock around its state mutation.
+/* Commands queued to the audio thread / replaced by a later one for the
+ * same control while its queue was full.
+ */
+void mixer_get_stats(uint32_t* out_sent, uint32_t* out_coalesced);
+
+/* Commands waiting on the game thread for room in the queue. */
+int mixer_held_commands(void);
+
+/* For tests, with the audio thread stopped: the latest play request and
+ * the state the audio side is in.
  */
-void mixer_lock_state(void);
-void mixer_unlock_state(void);
+typedef struct {
+  uint32_t play_seq;   /* game side */
+  uint32_t sample_seq; /* sample playing, 0 = none */
+  uint16_t pc_divisor;
+  int opl2_enabled;
+  const MusicStream* music;
+  int music_paused;
+} MixerControls;
+void mixer_get_controls(MixerControls* out);
 
 #endif /* MIXER_H */
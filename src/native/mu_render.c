@@ -0,0 +1,329 @@
+/*
+  Offline AdLib music renderer.
+
+    got_mu_render [GOTRES.DAT] [-o dir] [-j threads] [--cache] [SONG ...]
+
+  Loads every song from the resource file (or the named ones), replays the
+  MU_Service() note stream against its own ymfm YM3812 instance as fast as
+  the CPU allows (music_render_song()), and writes one 16-bit mono WAV per
+  song at the chip's native rate (OPL2_EMU_SAMPLE_RATE).
+
+  Each WAV holds the song from the top, then the loop body once more, with a
+  RIFF `smpl` loop over that second pass: [end of first pass, end of file).
+  Rendering the body twice means the loop start already carries the release
+  tails of the previous pass, so looping the region is seamless.
+
+  --cache writes music cache entries (see music_cache.h) instead, into
+  -o dir or the default cache directory.
+
+  Songs render in parallel, one chip per worker thread. Resource reads stay
+  on the main thread (res_* is not reentrant).
+*/
+
+#include "got_clock.h"
+#include "music_cache.h"
+#include "opl2_emu.h"
+#include "res_man.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+enum {
+  RENDER_MAX_THREADS = 64
+};
+
+typedef struct {
+  char name[9];
+  char far* data;
+  long length;
+
+  MusicRender r;
+  double render_s;
+  const char* err;
+} Track;
+
+static Track g_tracks[RES_MAX_ENTRIES];
+static int g_track_count;
+static volatile long g_next_track;
+
+static long take_next_track(void) {
+#ifdef _WIN32
+  return InterlockedIncrement(&g_next_track) - 1;
+#else
+  return __atomic_fetch_add(&g_next_track, 1, __ATOMIC_RELAXED);
+#endif
+}
+
+static int is_song_name(const char* name) {
+  return strstr(name, "SONG") != NULL;
+}
+
+static void render_track(Track* t) {
+  double t0 = got_clock_wall_s();
+  t->err = music_render_song(t->data, t->length, &t->r);
+  t->render_s = got_clock_wall_s() - t0;
+}
+
+#ifdef _WIN32
+static DWORD WINAPI render_worker(LPVOID arg)
+#else
+static void* render_worker(void* arg)
+#endif
+{
+  long i;
+  (void)arg;
+  while ((i = take_next_track()) < g_track_count) {
+    render_track(&g_tracks[i]);
+  }
+  return 0;
+}
+
+static int cpu_count(void) {
+#ifdef _WIN32
+  SYSTEM_INFO si;
+  GetSystemInfo(&si);
+  return (int)si.dwNumberOfProcessors;
+#else
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (int)n : 1;
+#endif
+}
+
+static void render_all(int threads) {
+  int i;
+  g_next_track = 0;
+  if (threads <= 1) {
+    render_worker(NULL);
+    return;
+  }
+#ifdef _WIN32
+  {
+    HANDLE th[RENDER_MAX_THREADS];
+    for (i = 0; i < threads; i++) th[i] = CreateThread(NULL, 0, render_worker, NULL, 0, NULL);
+    for (i = 0; i < threads; i++) {
+      if (th[i]) {
+        WaitForSingleObject(th[i], INFINITE);
+        CloseHandle(th[i]);
+      }
+    }
+  }
+#else
+  {
+    pthread_t th[RENDER_MAX_THREADS];
+    int ok[RENDER_MAX_THREADS];
+    for (i = 0; i < threads; i++) ok[i] = pthread_create(&th[i], NULL, render_worker, NULL) == 0;
+    for (i = 0; i < threads; i++) {
+      if (ok[i]) pthread_join(th[i], NULL);
+    }
+  }
+#endif
+  /* Any track a failed thread would have taken is picked up here. */
+  render_worker(NULL);
+}
+
+/* --- WAV output --- */
+
+static void put_u16(FILE* fp, uint32_t v) {
+  fputc((int)(v & 0xffu), fp);
+  fputc((int)((v >> 8) & 0xffu), fp);
+}
+
+static void put_u32(FILE* fp, uint32_t v) {
+  put_u16(fp, v & 0xffffu);
+  put_u16(fp, v >> 16);
+}
+
+static int write_wav(const char* path, const MusicRender* t) {
+  const uint32_t rate = OPL2_EMU_SAMPLE_RATE;
+  const uint32_t data_bytes = t->frames * 2u;
+  const uint32_t smpl_bytes = 36u + 24u;
+  FILE* fp = fopen(path, "wb");
+  uint32_t i;
+
+  if (!fp) return 0;
+  fwrite("RIFF", 1, 4, fp);
+  put_u32(fp, 4u + (8u + 16u) + (8u + data_bytes) + (8u + smpl_bytes));
+  fwrite("WAVE", 1, 4, fp);
+
+  fwrite("fmt ", 1, 4, fp);
+  put_u32(fp, 16u);
+  put_u16(fp, 1u);          /* PCM */
+  put_u16(fp, 1u);          /* mono */
+  put_u32(fp, rate);
+  put_u32(fp, rate * 2u);   /* bytes per second */
+  put_u16(fp, 2u);          /* block align */
+  put_u16(fp, 16u);         /* bits per sample */
+
+  fwrite("data", 1, 4, fp);
+  put_u32(fp, data_bytes);
+  for (i = 0; i < t->frames; i++) put_u16(fp, (uint16_t)t->pcm[i]);
+
+  /* Sampler chunk with a single forward loop; the end sample is inclusive. */
+  fwrite("smpl", 1, 4, fp);
+  put_u32(fp, smpl_bytes);
+  put_u32(fp, 0u);                          /* manufacturer */
+  put_u32(fp, 0u);                          /* product */
+  put_u32(fp, (uint32_t)(1000000000.0 / rate + 0.5)); /* ns per sample */
+  put_u32(fp, 60u);                         /* MIDI unity note */
+  put_u32(fp, 0u);                          /* pitch fraction */
+  put_u32(fp, 0u);                          /* SMPTE format */
+  put_u32(fp, 0u);                          /* SMPTE offset */
+  put_u32(fp, 1u);                          /* loop count */
+  put_u32(fp, 0u);                          /* sampler data */
+  put_u32(fp, 0u);                          /* cue point id */
+  put_u32(fp, 0u);                          /* forward loop */
+  put_u32(fp, t->loop_start);
+  put_u32(fp, t->loop_end - 1u);
+  put_u32(fp, 0u);                          /* fraction */
+  put_u32(fp, 0u);                          /* play forever */
+
+  if (fclose(fp) != 0) return 0;
+  return 1;
+}
+
+/* --- main --- */
+
+static void usage(void) {
+  printf("usage: got_mu_render [GOTRES.DAT] [-o dir] [-j threads] [--cache] [SONG ...]\n");
+  printf("  Renders AdLib songs to WAV (%d Hz, 16-bit mono, smpl loop).\n",
+         OPL2_EMU_SAMPLE_RATE);
+  printf("  --cache writes music cache entries instead (default dir %s).\n",
+         music_cache_dir());
+  printf("  Default: every *SONG* entry, all cores, current directory.\n");
+}
+
+static int add_track(const char* name) {
+  int idx = res_find_name(name);
+  Track* t;
+  if (idx < 0) {
+    fprintf(stderr, "%s: %s\n", name, res_error(idx));
+    return 0;
+  }
+  t = &g_tracks[g_track_count];
+  memset(t, 0, sizeof(*t));
+  strncpy(t->name, res_header[idx].name, 8);
+  t->name[8] = 0;
+  t->length = (long)res_header[idx].original_size;
+  t->data = (char far*)res_falloc_read(t->name);
+  if (!t->data) {
+    fprintf(stderr, "%s: can't read\n", t->name);
+    return 0;
+  }
+  g_track_count++;
+  return 1;
+}
+
+int main(int argc, char** argv) {
+  static char lzss_buff[65000];
+  const char* res_file = "GOTRES.DAT";
+  const char* out_dir = NULL;
+  const char* names[RES_MAX_ENTRIES];
+  int name_count = 0;
+  int cache = 0;
+  int threads = 0;
+  int i, ret, err = 0;
+  double t0, wall_s, audio_s = 0.0, cpu_s = 0.0;
+
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      out_dir = argv[++i];
+    } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      threads = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--cache") == 0) {
+      cache = 1;
+    } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+      usage();
+      return 0;
+    } else if (strchr(argv[i], '.') || strchr(argv[i], '/') || strchr(argv[i], '\\')) {
+      res_file = argv[i];
+    } else if (name_count < RES_MAX_ENTRIES) {
+      names[name_count++] = argv[i];
+    }
+  }
+  if (!out_dir) out_dir = cache ? music_cache_dir() : ".";
+  if (threads <= 0) threads = cpu_count();
+  if (threads > RENDER_MAX_THREADS) threads = RENDER_MAX_THREADS;
+
+  res_init(lzss_buff);
+  ret = res_open(res_file);
+  if (ret < 0) {
+    fprintf(stderr, "%s: %s\n", res_file, res_error(ret));
+    return 1;
+  }
+  if (name_count) {
+    for (i = 0; i < name_count; i++) {
+      if (!add_track(names[i])) err = 1;
+    }
+  } else {
+    for (i = 0; i < RES_MAX_ENTRIES; i++) {
+      if (res_header[i].length && is_song_name(res_header[i].name)) {
+        if (!add_track(res_header[i].name)) err = 1;
+      }
+    }
+  }
+  res_abort();
+  if (g_track_count == 0) {
+    fprintf(stderr, "no songs to render\n");
+    return 1;
+  }
+  if (threads > g_track_count) threads = g_track_count;
+
+  t0 = got_clock_wall_s();
+  render_all(threads);
+  wall_s = got_clock_wall_s() - t0;
+
+  for (i = 0; i < g_track_count; i++) {
+    Track* t = &g_tracks[i];
+    char path[512];
+    double secs = (double)t->r.frames / OPL2_EMU_SAMPLE_RATE;
+    if (t->err) {
+      fprintf(stderr, "%-8s  %s\n", t->name, t->err);
+      err = 1;
+      continue;
+    }
+    if (cache) {
+      uint64_t hash = music_song_hash(t->data, t->length);
+      long size = music_cache_write(out_dir, hash, &t->r);
+      if (!size) {
+        fprintf(stderr, "%s: can't write cache entry\n", t->name);
+        err = 1;
+        continue;
+      }
+      printf("%-8s  %7.2f s  %08lx%08lx.gmc  %6ld KB  %7.1fx realtime\n", t->name,
+             secs, (unsigned long)(hash >> 32), (unsigned long)(hash & 0xffffffffu),
+             size / 1024, t->render_s > 0.0 ? secs / t->render_s : 0.0);
+    } else {
+      snprintf(path, sizeof(path), "%s/%s.wav", out_dir, t->name);
+      if (!write_wav(path, &t->r)) {
+        fprintf(stderr, "%s: can't write\n", path);
+        err = 1;
+        continue;
+      }
+      printf("%-8s  %7.2f s  loop %9lu..%-9lu  %7.1fx realtime\n", t->name, secs,
+             (unsigned long)t->r.loop_start, (unsigned long)t->r.loop_end,
+             t->render_s > 0.0 ? secs / t->render_s : 0.0);
+    }
+    audio_s += secs;
+    cpu_s += t->render_s;
+  }
+
+  printf("%d songs, %.1f s of audio in %.2f s on %d threads: %.1fx realtime"
+         " (%.1fx per thread)\n",
+         g_track_count, audio_s, wall_s, threads,
+         wall_s > 0.0 ? audio_s / wall_s : 0.0,
+         cpu_s > 0.0 ? audio_s / cpu_s : 0.0);
+
+  for (i = 0; i < g_track_count; i++) {
+    music_render_free(&g_tracks[i].r);
+    farfree(g_tracks[i].data);
+  }
+  return err;
+}
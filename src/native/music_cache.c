@@ -0,0 +1,481 @@
+#include "music_cache.h"
+#include "mu_man.h"
+#include "opl2_emu.h"
+#include "spsc_ring.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <direct.h>
+#include <windows.h>
+#elif !defined(__EMSCRIPTEN__)
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+/* Emscripten builds have no threads to render on; they rely on a cache made
+   by got_mu_render at build time. */
+#if !defined(__EMSCRIPTEN__)
+#define MUSIC_CACHE_BACKGROUND 1
+#endif
+
+enum {
+  MUSIC_TICK_HZ = 120,
+  /* Guard against a song whose loop never comes round. */
+  MUSIC_MAX_TICKS = MUSIC_TICK_HZ * 60 * 30,
+  MUSIC_HEADER_BYTES = 40
+};
+
+/* File layout (little-endian):
+     "GMC1"  rate  frames  loop_start  loop_end  hash_lo  hash_hi
+     loop_pred  loop_index  reserved
+   then (frames + 1) / 2 bytes of IMA ADPCM, low nibble first. loop_pred and
+   loop_index are the decoder state at loop_start, so a loop is a plain jump.
+   Starting state is (0, 0). */
+static const char k_magic[4] = { 'G', 'M', 'C', '1' };
+
+struct MusicStream {
+  uint32_t frames;
+  uint32_t loop_start;
+  uint32_t loop_end;
+  int32_t loop_pred;
+  int32_t loop_index;
+  /* Decoder, audio thread. */
+  uint32_t pos;
+  int32_t pred;
+  int32_t index;
+  const uint8_t* data; /* follows the struct in the same allocation */
+};
+
+/* --- IMA ADPCM --- */
+
+static const int16_t k_step[89] = {
+  7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41,
+  45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209,
+  230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876,
+  963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749,
+  3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630,
+  9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385,
+  24623, 27086, 29794, 32767
+};
+
+static const int8_t k_index_adj[16] = {
+  -1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+/* Shared by encoder and decoder so both track the same prediction. */
+static void adpcm_step(int32_t* pred, int32_t* index, int nib) {
+  int32_t step = k_step[*index];
+  int32_t diff = step >> 3;
+  if (nib & 1) diff += step >> 2;
+  if (nib & 2) diff += step >> 1;
+  if (nib & 4) diff += step;
+  if (nib & 8) diff = -diff;
+  *pred += diff;
+  if (*pred > 32767) *pred = 32767;
+  if (*pred < -32768) *pred = -32768;
+  *index += k_index_adj[nib];
+  if (*index < 0) *index = 0;
+  if (*index > 88) *index = 88;
+}
+
+static int adpcm_encode_one(int32_t* pred, int32_t* index, int32_t sample) {
+  int32_t step = k_step[*index];
+  int32_t diff = sample - *pred;
+  int nib = 0;
+  if (diff < 0) {
+    nib = 8;
+    diff = -diff;
+  }
+  if (diff >= step) {
+    nib |= 4;
+    diff -= step;
+  }
+  step >>= 1;
+  if (diff >= step) {
+    nib |= 2;
+    diff -= step;
+  }
+  step >>= 1;
+  if (diff >= step) nib |= 1;
+  adpcm_step(pred, index, nib);
+  return nib;
+}
+
+/* --- rendering --- */
+
+uint64_t music_song_hash(const void* song, long length) {
+  const uint8_t* p = (const uint8_t*)song;
+  uint64_t h = 14695981039346656037ull;
+  long i;
+  for (i = 0; i < length; i++) {
+    h ^= p[i];
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+/* First OPL sample of 120Hz tick `tick`, the same mapping opl2_tick() uses. */
+static uint32_t tick_sample(uint32_t tick) {
+  return (uint32_t)((uint64_t)tick * OPL2_EMU_SAMPLE_RATE / MUSIC_TICK_HZ);
+}
+
+static int grow_pcm(MusicRender* r, uint32_t* cap, uint32_t frames) {
+  if (frames > *cap) {
+    uint32_t n = *cap ? *cap : OPL2_EMU_SAMPLE_RATE * 60u;
+    int16_t* p;
+    while (n < frames) n *= 2u;
+    p = (int16_t*)realloc(r->pcm, (size_t)n * sizeof(int16_t));
+    if (!p) return 0;
+    r->pcm = p;
+    *cap = n;
+  }
+  return 1;
+}
+
+/* One 120Hz tick at a time, exactly like MU_Service(): issue every note that
+   is due, advance the tick, wrap to loop_offset when the data runs out. The
+   tick's audio follows its writes. */
+const char* music_render_song(const char* song, long length, MusicRender* out) {
+  fm_music* m;
+  Opl2Chip* chip;
+  fm_music_note far* note;
+  long left, loop_left, next_event = 0, elapsed = 0;
+  uint32_t tick = 0, cap = 0;
+  int pass = 0;
+  const char* err = NULL;
+
+  memset(out, 0, sizeof(*out));
+  if (length < 2 + (long)sizeof(fm_music_note)) return "too short";
+  m = MU_ConvertOpl((char far*)song, length);
+  chip = opl2_chip_new();
+  if (!m || !chip) {
+    MU_FreeFMMusic(m);
+    opl2_chip_free(chip);
+    return "out of memory";
+  }
+  /* MU_Service() restarts with the full length (see its TODO); count only
+     what is left after the loop point so a non-zero offset can't overrun. */
+  loop_left = m->length - (long)((char far*)m->loop_offset - (char far*)m->notes);
+  if (loop_left < 0 || loop_left > m->length) {
+    MU_FreeFMMusic(m);
+    opl2_chip_free(chip);
+    return "bad loop offset";
+  }
+
+  note = m->notes;
+  left = m->length;
+  while (pass < 2) {
+    uint32_t from, to;
+
+    if (tick >= MUSIC_MAX_TICKS) {
+      err = "song never loops";
+      break;
+    }
+    while (left > 3 && next_event <= elapsed) {
+      opl2_chip_write(chip, note->opl_register, note->opl_value);
+      next_event = elapsed + note->delay;
+      note++;
+      left -= (long)sizeof(fm_music_note);
+    }
+    elapsed++;
+
+    from = tick_sample(tick);
+    to = tick_sample(tick + 1u);
+    if (!grow_pcm(out, &cap, to)) {
+      err = "out of memory";
+      break;
+    }
+    opl2_chip_generate(chip, out->pcm + from, (int)(to - from));
+    out->frames = to;
+    tick++;
+
+    if (left < 3) {
+      if (pass == 0) out->loop_start = to;
+      else out->loop_end = to;
+      pass++;
+      note = m->loop_offset;
+      left = loop_left;
+      elapsed = next_event = 0;
+    }
+  }
+
+  MU_FreeFMMusic(m);
+  opl2_chip_free(chip);
+  if (err) music_render_free(out);
+  return err;
+}
+
+void music_render_free(MusicRender* r) {
+  if (!r) return;
+  free(r->pcm);
+  memset(r, 0, sizeof(*r));
+}
+
+/* --- cache files --- */
+
+static void cache_path(char* path, size_t size, const char* dir, uint64_t hash, const char* ext) {
+  snprintf(path, size, "%s/%08lx%08lx%s", dir, (unsigned long)(hash >> 32),
+           (unsigned long)(hash & 0xffffffffu), ext);
+}
+
+static void put_u32(uint8_t* p, uint32_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t get_u32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void make_dir(const char* dir) {
+#if defined(_WIN32)
+  _mkdir(dir);
+#elif !defined(__EMSCRIPTEN__)
+  mkdir(dir, 0755);
+#else
+  (void)dir;
+#endif
+}
+
+long music_cache_write(const char* dir, uint64_t hash, const MusicRender* r) {
+  char path[512], tmp[512];
+  uint32_t bytes = (r->frames + 1u) / 2u;
+  uint8_t* buf;
+  int32_t pred = 0, index = 0, loop_pred = 0, loop_index = 0;
+  uint32_t i;
+  FILE* fp;
+  int ok;
+
+  if (!r->pcm || r->loop_start >= r->loop_end || r->loop_end > r->frames) return 0;
+  buf = (uint8_t*)calloc((size_t)MUSIC_HEADER_BYTES + bytes, 1);
+  if (!buf) return 0;
+
+  for (i = 0; i < r->frames; i++) {
+    int nib;
+    if (i == r->loop_start) {
+      loop_pred = pred;
+      loop_index = index;
+    }
+    nib = adpcm_encode_one(&pred, &index, r->pcm[i]);
+    buf[MUSIC_HEADER_BYTES + (i >> 1)] |= (uint8_t)(nib << ((i & 1u) * 4u));
+  }
+
+  memcpy(buf, k_magic, 4);
+  put_u32(buf + 4, OPL2_EMU_SAMPLE_RATE);
+  put_u32(buf + 8, r->frames);
+  put_u32(buf + 12, r->loop_start);
+  put_u32(buf + 16, r->loop_end);
+  put_u32(buf + 20, (uint32_t)(hash & 0xffffffffu));
+  put_u32(buf + 24, (uint32_t)(hash >> 32));
+  put_u32(buf + 28, (uint32_t)loop_pred);
+  put_u32(buf + 32, (uint32_t)loop_index);
+  put_u32(buf + 36, 0u);
+
+  /* Write then rename, so a reader never sees a partial file. */
+  make_dir(dir);
+  cache_path(path, sizeof(path), dir, hash, ".gmc");
+  cache_path(tmp, sizeof(tmp), dir, hash, ".tmp");
+  fp = fopen(tmp, "wb");
+  if (!fp) {
+    free(buf);
+    return 0;
+  }
+  ok = fwrite(buf, 1, (size_t)MUSIC_HEADER_BYTES + bytes, fp) == (size_t)MUSIC_HEADER_BYTES + bytes;
+  ok = (fclose(fp) == 0) && ok;
+  free(buf);
+  if (ok) {
+    remove(path);
+    ok = rename(tmp, path) == 0;
+  }
+  if (!ok) {
+    remove(tmp);
+    return 0;
+  }
+  return (long)MUSIC_HEADER_BYTES + (long)bytes;
+}
+
+MusicStream* music_cache_load(const char* dir, uint64_t hash) {
+  char path[512];
+  uint8_t hdr[MUSIC_HEADER_BYTES];
+  uint32_t frames, loop_start, loop_end, bytes, loop_index;
+  MusicStream* s;
+  FILE* fp;
+  long size;
+
+  cache_path(path, sizeof(path), dir, hash, ".gmc");
+  fp = fopen(path, "rb");
+  if (!fp) return NULL;
+  if (fread(hdr, 1, sizeof(hdr), fp) != sizeof(hdr) || memcmp(hdr, k_magic, 4) != 0 ||
+      get_u32(hdr + 4) != OPL2_EMU_SAMPLE_RATE || get_u32(hdr + 20) != (uint32_t)(hash & 0xffffffffu) ||
+      get_u32(hdr + 24) != (uint32_t)(hash >> 32)) {
+    fclose(fp);
+    return NULL;
+  }
+  frames = get_u32(hdr + 8);
+  loop_start = get_u32(hdr + 12);
+  loop_end = get_u32(hdr + 16);
+  loop_index = get_u32(hdr + 32);
+  bytes = (frames + 1u) / 2u;
+  fseek(fp, 0, SEEK_END);
+  size = ftell(fp);
+  if (loop_start >= loop_end || loop_end > frames || loop_index > 88u ||
+      size != (long)MUSIC_HEADER_BYTES + (long)bytes) {
+    fclose(fp);
+    return NULL;
+  }
+
+  s = (MusicStream*)malloc(sizeof(*s) + bytes);
+  if (!s) {
+    fclose(fp);
+    return NULL;
+  }
+  fseek(fp, MUSIC_HEADER_BYTES, SEEK_SET);
+  if (fread(s + 1, 1, bytes, fp) != bytes) {
+    fclose(fp);
+    free(s);
+    return NULL;
+  }
+  fclose(fp);
+
+  s->frames = frames;
+  s->loop_start = loop_start;
+  s->loop_end = loop_end;
+  s->loop_pred = (int32_t)get_u32(hdr + 28);
+  s->loop_index = (int32_t)loop_index;
+  s->pos = 0;
+  s->pred = 0;
+  s->index = 0;
+  s->data = (const uint8_t*)(s + 1);
+  return s;
+}
+
+void music_stream_read(MusicStream* s, int16_t* buf, int samples) {
+  const uint8_t* data = s->data;
+  uint32_t pos = s->pos;
+  int32_t pred = s->pred, index = s->index;
+  int i;
+  for (i = 0; i < samples; i++) {
+    if (pos >= s->loop_end) {
+      pos = s->loop_start;
+      pred = s->loop_pred;
+      index = s->loop_index;
+    }
+    adpcm_step(&pred, &index, (data[pos >> 1] >> ((pos & 1u) * 4u)) & 15);
+    buf[i] = (int16_t)pred;
+    pos++;
+  }
+  s->pos = pos;
+  s->pred = pred;
+  s->index = index;
+}
+
+/* --- game side --- */
+
+#ifdef __EMSCRIPTEN__
+static int g_enabled = 1;
+#else
+static int g_enabled = 0;
+#endif
+
+void music_cache_set_enabled(int enabled) {
+  g_enabled = enabled ? 1 : 0;
+}
+
+int music_cache_enabled(void) {
+  return g_enabled;
+}
+
+const char* music_cache_dir(void) {
+  const char* env = getenv("GOT_MUSIC_CACHE_DIR");
+  return (env && env[0]) ? env : "musiccache";
+}
+
+#ifdef MUSIC_CACHE_BACKGROUND
+
+/* One render at a time; a song asked for while busy is simply asked for
+   again the next time it plays. */
+typedef struct {
+  uint64_t hash;
+  long length;
+  char dir[256];
+  /* song bytes follow */
+} BuildJob;
+
+static volatile uint32_t g_build_busy;
+
+static void build_job(BuildJob* job) {
+  MusicRender r;
+  if (!music_render_song((const char*)(job + 1), job->length, &r)) {
+    if (!music_cache_write(job->dir, job->hash, &r)) {
+      fprintf(stderr, "music cache: can't write to %s\n", job->dir);
+    }
+    music_render_free(&r);
+  }
+  free(job);
+  spsc_atomic_store(&g_build_busy, 0);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI build_thread(LPVOID arg) {
+  build_job((BuildJob*)arg);
+  return 0;
+}
+#else
+static void* build_thread(void* arg) {
+  build_job((BuildJob*)arg);
+  return NULL;
+}
+#endif
+
+static void build_in_background(const char* song, long length, uint64_t hash) {
+  BuildJob* job;
+  int started;
+
+  if (spsc_atomic_load(&g_build_busy)) return;
+  job = (BuildJob*)malloc(sizeof(*job) + (size_t)length);
+  if (!job) return;
+  job->hash = hash;
+  job->length = length;
+  snprintf(job->dir, sizeof(job->dir), "%s", music_cache_dir());
+  memcpy(job + 1, song, (size_t)length);
+
+  spsc_atomic_store(&g_build_busy, 1);
+#ifdef _WIN32
+  {
+    HANDLE th = CreateThread(NULL, 0, build_thread, job, 0, NULL);
+    started = th != NULL;
+    if (th) CloseHandle(th);
+  }
+#else
+  {
+    pthread_t th;
+    started = pthread_create(&th, NULL, build_thread, job) == 0;
+    if (started) pthread_detach(th);
+  }
+#endif
+  if (!started) {
+    free(job);
+    spsc_atomic_store(&g_build_busy, 0);
+  }
+}
+
+#endif /* MUSIC_CACHE_BACKGROUND */
+
+MusicStream* music_cache_lookup(const char* song, long length) {
+  uint64_t hash;
+  MusicStream* s;
+
+  if (!g_enabled || !song || length <= 0) return NULL;
+  hash = music_song_hash(song, length);
+  s = music_cache_load(music_cache_dir(), hash);
+#ifdef MUSIC_CACHE_BACKGROUND
+  if (!s) build_in_background(song, length, hash);
+#endif
+  return s;
+}
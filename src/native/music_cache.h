@@ -0,0 +1,66 @@
+#ifndef MUSIC_CACHE_H
+#define MUSIC_CACHE_H
+
+#include <stdint.h>
+
+/* Pre-rendered AdLib music.
+
+   A song (the byte stream MU_StartMusic() plays) can be rendered offline to
+   PCM at the OPL2 rate and stored as 4-bit IMA ADPCM, keyed and validated by
+   a hash of the song bytes. With the cache enabled, MU_StartMusic() streams
+   the cached copy through the mixer instead of MU_Service() driving the live
+   emulator. A missing or stale entry falls back to live emulation and, where
+   threads are available, is rendered in the background for next time.
+   got_mu_render --cache fills the cache ahead of time (the web build
+   preloads it).
+
+   Files are <dir>/<16 hex digit hash>.gmc; dir is "musiccache" unless
+   GOT_MUSIC_CACHE_DIR says otherwise. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A rendered song: the song from the top, then its loop body once more.
+   [loop_start, loop_end) is the second pass. */
+typedef struct {
+  int16_t* pcm;
+  uint32_t frames;
+  uint32_t loop_start;
+  uint32_t loop_end;
+} MusicRender;
+
+typedef struct MusicStream MusicStream;
+
+/* 64-bit FNV-1a over the song bytes. */
+uint64_t music_song_hash(const void* song, long length);
+
+/* Plays the song the way MU_Service() does, against a private OPL2 chip.
+   Returns NULL on success or a short error text. */
+const char* music_render_song(const char* song, long length, MusicRender* out);
+void music_render_free(MusicRender* r);
+
+/* Writes the cache entry for `hash`. Returns the file size, 0 on failure. */
+long music_cache_write(const char* dir, uint64_t hash, const MusicRender* r);
+
+/* Loads and validates a cache entry; NULL if missing or stale. The stream is
+   a single allocation: release it with free(). */
+MusicStream* music_cache_load(const char* dir, uint64_t hash);
+
+/* Audio thread: decodes the next `samples` at the OPL2 rate, looping. */
+void music_stream_read(MusicStream* s, int16_t* buf, int samples);
+
+/* Game side. */
+void music_cache_set_enabled(int enabled);
+int music_cache_enabled(void);
+const char* music_cache_dir(void);
+
+/* Cached stream for this song, or NULL (and a background render is queued
+   when possible). */
+MusicStream* music_cache_lookup(const char* song, long length);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* MUSIC_CACHE_H */
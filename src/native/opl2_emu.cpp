@@ -5,8 +5,14 @@
 
   The rest of the native port expects a tiny API:
     - opl2_init()
+    - opl2_tick()
     - opl2_write(reg, val)
     - opl2_generate(buf, samples)
+    - opl2_skip(samples), which keeps the write timeline moving without
+      rendering while the mixer streams pre-rendered music instead
+
+  plus independent Opl2Chip instances (opl2_chip_*) for rendering songs
+  offline, one per thread.
 
   MU_Service() runs at 120Hz and drives music by writing raw OPL registers via
   SB_ALOut(), which calls opl2_write(). The mixer pulls audio by calling
@@ -16,12 +22,44 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
+#include <new>
 #include <vector>
-#include <mutex>
 
+#include "spsc_ring.h"
 #include "ymfm_opl.h"
 
+/*
+  Threading: opl2_init()/opl2_write() run on the game thread (MU_Service at
+  120Hz), opl2_generate() on the audio callback thread via the mixer. Writes
+  go through a wait-free SPSC ring, so the chip is only ever touched by the
+  audio thread and neither side takes a lock.
+
+  No write is lost when the ring is full. Until it has room again, writes
+  collect in a per-register table on the game thread (the last value of
+  each register wins, a reset empties it), which every later write and
+  every tick tries to flush in order. Key-on registers go after the rest,
+  so a note never starts on an old frequency or instrument.
+
+  Timing: every write is stamped with the OPL sample at which its 120Hz tick
+  starts (opl2_tick() advances the stamp by 49716/120 samples). The audio
+  thread maps stamps onto its own render position with a fixed lead and
+  applies each write exactly at its sample, splitting ymfm's render there. So
+  note spacing is exact no matter how the game thread's ticks bunch up around
+  frame presents or how large the audio callbacks are. If a write arrives
+  after its sample was already rendered (game thread stalled, callbacks
+  longer than the lead), the lead grows by the miss and the mapping is
+  re-anchored; if the game thread runs far ahead, it is re-anchored too.
+
+  That only works while the game keeps pace with the wall clock. On the
+  free-running clock (--clock free) the game makes ticks far faster than
+  the device plays them, so writes would wait in the ring for their
+  sample ever longer and fill it. opl2_set_timed(0) sends them unstamped
+  instead: the audio thread applies each one as soon as it sees it, and
+  the next stamped write anchors the mapping afresh.
+*/
+
 namespace {
 
 /* OPL2 commonly derives from a 14.31818 MHz master clock (NTSC crystal),
@@ -30,48 +68,250 @@ namespace {
    output sample rate. */
 static constexpr uint32_t kOpl2ClockHz = 14318180u;
 
+/* A song start writes a few hundred registers at once; the audio thread
+   drains every ~20ms. */
+static constexpr uint32_t kWriteRingSize = 4096;
+
+/* OPL samples per 120Hz tick, rounded down (the stamp itself is exact). */
+static constexpr int64_t kTickSamples = OPL2_EMU_SAMPLE_RATE / 120;
+/* Distance between a write's stamp and the render position when it is
+   anchored: covers the ticks delivered together at a frame present plus one
+   audio callback. Grows up to kLeadMax when writes keep arriving late. */
+static constexpr int64_t kLeadMin = 6 * kTickSamples;
+static constexpr int64_t kLeadMax = 24 * kTickSamples;
+/* Writes stamped further ahead than this re-anchor the mapping. */
+static constexpr int64_t kAheadMax = 2 * kLeadMax;
+/* Stamp of a write to apply as soon as the audio thread sees it. */
+static constexpr uint64_t kStampNow = ~(uint64_t)0;
+
+enum : uint8_t {
+  OPL_OP_WRITE = 0,
+  OPL_OP_RESET = 1
+};
+
+struct OplWrite {
+  uint64_t stamp; /* OPL sample on the game thread's tick timeline */
+  uint8_t op;
+  uint8_t reg;
+  uint8_t val;
+};
+
 class GotYmfmInterface : public ymfm::ymfm_interface {
   // Default no-op implementations are sufficient: we don't use OPL timers/IRQs.
 };
 
 static GotYmfmInterface g_intf;
 static ymfm::ym3812 g_chip(g_intf);
-static int g_inited = 0;
+static int g_inited = 0;   /* audio thread */
 static uint32_t g_rate = 0;
-static std::mutex g_mu;
-
-static void ensure_init(void) {
-  if (!g_inited) {
-    std::lock_guard<std::mutex> lock(g_mu);
-    g_chip.reset();
-    g_rate = g_chip.sample_rate(kOpl2ClockHz);
-    g_inited = 1;
+
+static OplWrite g_write_slots[kWriteRingSize];
+
+/* Game thread. */
+static uint64_t g_ticks = 0;
+static uint64_t g_stamp = 0;
+static int g_timed = 1;
+/* Writes waiting for room in the ring. */
+static uint8_t g_held_val[256];
+static uint8_t g_held_set[256];
+static uint8_t g_held_order[256];
+static int g_held_count = 0;
+static int g_held_reset = 0;
+static uint32_t g_writes_coalesced = 0;
+
+/* Audio thread: every register as applied to the chip. */
+static uint8_t g_applied[256];
+
+/* Audio thread. */
+static uint64_t g_render_pos = 0; /* OPL samples rendered so far */
+static int64_t g_offset = 0;      /* render position = stamp + g_offset */
+static int64_t g_lead = kLeadMin;
+static int g_anchored = 0;
+static OplWrite g_pending;        /* popped but not yet due */
+static int g_have_pending = 0;
+
+/* Set up during static init, before either thread can touch it. */
+struct WriteRing {
+  SpscRing ring;
+  WriteRing() { spsc_init(&ring, g_write_slots, sizeof(OplWrite), kWriteRingSize); }
+};
+static WriteRing g_writes;
+
+static void chip_reset(void) {
+  g_chip.reset();
+  g_rate = g_chip.sample_rate(kOpl2ClockHz);
+  g_inited = 1;
+}
+
+static int push(uint8_t op, uint8_t reg, uint8_t val) {
+  OplWrite w;
+  w.stamp = g_timed ? g_stamp : kStampNow;
+  w.op = op;
+  w.reg = reg;
+  w.val = val;
+  return spsc_push(&g_writes.ring, &w);
+}
+
+/* Key-on and block/F-number high bits of channels 0-8. */
+static int is_key_reg(uint8_t reg) {
+  return reg >= 0xB0 && reg <= 0xB8;
+}
+
+/* Moves held writes into the ring while it has room. */
+static void flush_held(void) {
+  int pass, i, n;
+  if (g_held_reset) {
+    if (!push(OPL_OP_RESET, 0, 0)) return;
+    g_held_reset = 0;
+  }
+  if (!g_held_count) return;
+  for (pass = 0; pass < 2; pass++) {
+    for (i = 0; i < g_held_count; i++) {
+      uint8_t reg = g_held_order[i];
+      if (!g_held_set[reg] || is_key_reg(reg) != (pass == 1)) continue;
+      if (!push(OPL_OP_WRITE, reg, g_held_val[reg])) break;
+      g_held_set[reg] = 0;
+    }
+    if (i < g_held_count) break;
+  }
+  for (i = n = 0; i < g_held_count; i++) {
+    if (g_held_set[g_held_order[i]]) g_held_order[n++] = g_held_order[i];
+  }
+  g_held_count = n;
+}
+
+static void post(uint8_t op, uint8_t reg, uint8_t val) {
+  flush_held();
+  if (!g_held_reset && !g_held_count && push(op, reg, val)) return;
+  /* Ring full, or earlier writes still held: hold this one too. */
+  if (op == OPL_OP_RESET) {
+    memset(g_held_set, 0, sizeof(g_held_set));
+    g_held_count = 0;
+    g_held_reset = 1;
+    return;
+  }
+  if (g_held_set[reg]) {
+    g_writes_coalesced++;
+  } else {
+    g_held_set[reg] = 1;
+    g_held_order[g_held_count++] = reg;
+  }
+  g_held_val[reg] = val;
+}
+
+static void anchor(uint64_t stamp) {
+  g_offset = (int64_t)g_render_pos + g_lead - (int64_t)stamp;
+  g_anchored = 1;
+}
+
+/* Render position at which a write stamped `stamp` is applied. */
+static int64_t schedule(uint64_t stamp) {
+  int64_t at;
+  int64_t now = (int64_t)g_render_pos;
+  if (!g_anchored) anchor(stamp);
+  at = (int64_t)stamp + g_offset;
+  if (at < now) {
+    g_lead += now - at;
+    if (g_lead > kLeadMax) g_lead = kLeadMax;
+    anchor(stamp);
+    at = (int64_t)stamp + g_offset;
+  } else if (at > now + kAheadMax) {
+    anchor(stamp);
+    at = (int64_t)stamp + g_offset;
+  }
+  return at;
+}
+
+static void clamp_out(const ymfm::ym3812::output_data* out, int16_t* buf, int samples) {
+  for (int i = 0; i < samples; i++) {
+    int32_t v = out[i].data[0];
+    if (v < -32768) v = -32768;
+    if (v > 32767) v = 32767;
+    buf[i] = (int16_t)v;
+  }
+}
+
+static void apply(const OplWrite& w) {
+  if (w.op == OPL_OP_RESET) {
+    chip_reset();
+    memset(g_applied, 0, sizeof(g_applied));
+  } else {
+    g_chip.write_address(w.reg);
+    g_chip.write_data(w.val);
+    g_applied[w.reg] = w.val;
+  }
+}
+
+/* Render up to each due write, apply it, carry on. A write due after this
+   block stays pending for the next call. With out == nullptr the chip isn't
+   clocked at all; writes are still applied on time. */
+static void advance(ymfm::ym3812::output_data* out, int samples) {
+  int done = 0;
+  for (;;) {
+    int64_t at;
+    if (!g_have_pending) g_have_pending = spsc_pop(&g_writes.ring, &g_pending);
+    if (!g_have_pending) break;
+    if (g_pending.stamp == kStampNow) {
+      g_anchored = 0;
+      apply(g_pending);
+      g_have_pending = 0;
+      continue;
+    }
+    at = schedule(g_pending.stamp);
+    if (at >= (int64_t)g_render_pos + (samples - done)) break;
+    if (at > (int64_t)g_render_pos) {
+      int n = (int)(at - (int64_t)g_render_pos);
+      if (out) g_chip.generate(out + done, (uint32_t)n);
+      done += n;
+      g_render_pos += (uint64_t)n;
+    }
+    apply(g_pending);
+    g_have_pending = 0;
+  }
+  if (done < samples) {
+    if (out) g_chip.generate(out + done, (uint32_t)(samples - done));
+    g_render_pos += (uint64_t)(samples - done);
   }
 }
 
 } // namespace
 
 void opl2_init(void) {
-  std::lock_guard<std::mutex> lock(g_mu);
-  g_chip.reset();
-  g_rate = g_chip.sample_rate(kOpl2ClockHz);
-  g_inited = 1;
+  post(OPL_OP_RESET, 0, 0);
 }
 
 void opl2_write(uint8_t reg, uint8_t val) {
-  ensure_init();
-  std::lock_guard<std::mutex> lock(g_mu);
-  g_chip.write_address(reg);
-  g_chip.write_data(val);
+  post(OPL_OP_WRITE, reg, val);
+}
+
+void opl2_set_timed(int timed) {
+  g_timed = timed ? 1 : 0;
+}
+
+void opl2_tick(void) {
+  flush_held();
+  g_ticks++;
+  g_stamp = g_ticks * (uint64_t)OPL2_EMU_SAMPLE_RATE / 120u;
+}
+
+uint32_t opl2_coalesced_writes(void) {
+  return g_writes_coalesced;
+}
+
+int opl2_held_writes(void) {
+  return g_held_count + g_held_reset;
+}
+
+void opl2_applied_regs(uint8_t regs[256]) {
+  memcpy(regs, g_applied, sizeof(g_applied));
 }
 
 void opl2_generate(int16_t* buf, int samples) {
   if (!buf || samples <= 0) return;
-  ensure_init();
-  std::lock_guard<std::mutex> lock(g_mu);
+  if (!g_inited) chip_reset();
 
   /* ymfm generates int32-ish outputs; clamp to int16.
-     IMPORTANT: avoid allocations here; this runs under the mixer's lock and
+     IMPORTANT: avoid allocations here; this runs on the audio thread and
      can cause audio underruns if it stalls. */
   static std::vector<ymfm::ym3812::output_data> out;
   if (out.capacity() < (size_t)samples) {
@@ -83,12 +323,44 @@ void opl2_generate(int16_t* buf, int samples) {
   // If this ever differs, tempo/pitch will be off but it's still better to
   // output something than to crash.
   (void)g_rate;
-  g_chip.generate(out.data(), (uint32_t)samples);
 
-  for (int i = 0; i < samples; i++) {
-    int32_t v = out[(size_t)i].data[0];
-    if (v < -32768) v = -32768;
-    if (v > 32767) v = 32767;
-    buf[i] = (int16_t)v;
+  advance(out.data(), samples);
+  clamp_out(out.data(), buf, samples);
+}
+
+void opl2_skip(int samples) {
+  if (samples <= 0) return;
+  if (!g_inited) chip_reset();
+  advance(nullptr, samples);
+}
+
+/* Standalone chips: no ring and no timestamps, writes apply immediately. */
+struct Opl2Chip {
+  GotYmfmInterface intf;
+  ymfm::ym3812 chip;
+  std::vector<ymfm::ym3812::output_data> out;
+  Opl2Chip() : chip(intf) {
+    chip.reset();
+    (void)chip.sample_rate(kOpl2ClockHz);
   }
+};
+
+Opl2Chip* opl2_chip_new(void) {
+  return new (std::nothrow) Opl2Chip();
+}
+
+void opl2_chip_free(Opl2Chip* c) {
+  delete c;
+}
+
+void opl2_chip_write(Opl2Chip* c, uint8_t reg, uint8_t val) {
+  c->chip.write_address(reg);
+  c->chip.write_data(val);
+}
+
+void opl2_chip_generate(Opl2Chip* c, int16_t* buf, int samples) {
+  if (!buf || samples <= 0) return;
+  c->out.resize((size_t)samples);
+  c->chip.generate(c->out.data(), (uint32_t)samples);
+  clamp_out(c->out.data(), buf, samples);
 }
@@ -26,8 +26,35 @@ extern "C" {
 #endif
 
 void opl2_init(void);
+/* Start the next 120Hz tick: writes issued after this are stamped with the
+   tick's first OPL sample and applied by opl2_generate() at exactly that
+   point of the output, a fixed lead behind the game thread. */
+void opl2_tick(void);
+/* 0: the game clock doesn't follow the wall clock, so apply writes as soon
+   as the audio thread gets them rather than at their tick's sample. */
+void opl2_set_timed(int timed);
 void opl2_write(uint8_t reg, uint8_t val);
 void opl2_generate(int16_t* buf, int samples);
+/* Advance like opl2_generate() but without clocking the chip: due writes are
+   applied, no audio is produced. */
+void opl2_skip(int samples);
+/* Writes are never dropped: while the ring to the audio thread is full
+   they are held per register and sent when it has room (at the latest on
+   the next opl2_tick()). Held writes that a later one to the same
+   register replaced, and writes held right now. */
+uint32_t opl2_coalesced_writes(void);
+int opl2_held_writes(void);
+/* Audio thread, or once it has stopped: every register as the chip last
+   had it written. */
+void opl2_applied_regs(uint8_t regs[256]);
+
+/* Independent chip instances for offline rendering. Each one is used from a
+   single thread; writes take effect at the next generated sample. */
+typedef struct Opl2Chip Opl2Chip;
+Opl2Chip* opl2_chip_new(void);
+void opl2_chip_free(Opl2Chip* c);
+void opl2_chip_write(Opl2Chip* c, uint8_t reg, uint8_t val);
+void opl2_chip_generate(Opl2Chip* c, int16_t* buf, int samples);
 
 #ifdef __cplusplus
 } /* extern "C" */
@@ -0,0 +1,297 @@
+#include "pal_expand.h"
+#include "got_clock.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PAL_X86 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define PAL_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(__wasm_simd128__)
+#define PAL_WASM 1
+#include <wasm_simd128.h>
+#endif
+
+/* GCC/Clang need the target attribute to emit AVX2 in an otherwise baseline
+   build; MSVC accepts the intrinsics anywhere. */
+#if defined(PAL_X86) && (defined(__GNUC__) || defined(__clang__))
+#define PAL_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define PAL_TARGET_AVX2
+#endif
+
+typedef void (*ExpandFn)(uint32_t* dst, const uint8_t* src, int n);
+
+static uint32_t g_pal[256];
+#ifdef PAL_NEON
+/* Planar r/g/b/a tables, 4 x 64 bytes each, for vqtbl4q/vqtbx4q. */
+static uint8_t g_pal_planar[4][256];
+#endif
+
+static ExpandFn g_expand = NULL;
+static const char* g_expand_name = "scalar";
+
+/* --- kernels --- */
+
+static void expand_scalar(uint32_t* dst, const uint8_t* src, int n) {
+  int i;
+  for (i = 0; i < n; i++) {
+    dst[i] = g_pal[src[i]];
+  }
+}
+
+#ifdef PAL_X86
+static void expand_sse2(uint32_t* dst, const uint8_t* src, int n) {
+  const uint32_t* p = g_pal;
+  int i = 0;
+  /* No gather in SSE2: four scalar loads per vector, one 16-byte store. */
+  for (; i + 8 <= n; i += 8) {
+    __m128i a = _mm_set_epi32((int)p[src[i + 3]], (int)p[src[i + 2]],
+                              (int)p[src[i + 1]], (int)p[src[i + 0]]);
+    __m128i b = _mm_set_epi32((int)p[src[i + 7]], (int)p[src[i + 6]],
+                              (int)p[src[i + 5]], (int)p[src[i + 4]]);
+    _mm_storeu_si128((__m128i*)(dst + i), a);
+    _mm_storeu_si128((__m128i*)(dst + i + 4), b);
+  }
+  for (; i < n; i++) dst[i] = p[src[i]];
+}
+
+PAL_TARGET_AVX2
+static void expand_avx2(uint32_t* dst, const uint8_t* src, int n) {
+  const int* p = (const int*)g_pal;
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m256i i0 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + i)));
+    __m256i i1 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + i + 8)));
+    _mm256_storeu_si256((__m256i*)(dst + i), _mm256_i32gather_epi32(p, i0, 4));
+    _mm256_storeu_si256((__m256i*)(dst + i + 8), _mm256_i32gather_epi32(p, i1, 4));
+  }
+  for (; i < n; i++) dst[i] = g_pal[src[i]];
+}
+
+static int cpu_has_avx2(void) {
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") ? 1 : 0;
+#elif defined(_MSC_VER)
+  int r[4];
+  __cpuid(r, 0);
+  if (r[0] < 7) return 0;
+  __cpuid(r, 1);
+  /* OSXSAVE + AVX, and the OS must save YMM state. */
+  if ((r[2] & (1 << 27)) == 0 || (r[2] & (1 << 28)) == 0) return 0;
+  if ((_xgetbv(0) & 6) != 6) return 0;
+  __cpuidex(r, 7, 0);
+  return (r[1] & (1 << 5)) ? 1 : 0;
+#else
+  return 0;
+#endif
+}
+#endif /* PAL_X86 */
+
+#ifdef PAL_NEON
+static void expand_neon(uint32_t* dst, const uint8_t* src, int n) {
+  uint8x16x4_t t[4][4]; /* [channel][quarter] */
+  const uint8x16_t k64 = vdupq_n_u8(64);
+  int c, q, i = 0;
+
+  for (c = 0; c < 4; c++) {
+    for (q = 0; q < 4; q++) {
+      const uint8_t* p = &g_pal_planar[c][q * 64];
+      t[c][q].val[0] = vld1q_u8(p);
+      t[c][q].val[1] = vld1q_u8(p + 16);
+      t[c][q].val[2] = vld1q_u8(p + 32);
+      t[c][q].val[3] = vld1q_u8(p + 48);
+    }
+  }
+
+  for (; i + 16 <= n; i += 16) {
+    uint8x16_t i0 = vld1q_u8(src + i);
+    uint8x16_t i1 = vsubq_u8(i0, k64);
+    uint8x16_t i2 = vsubq_u8(i1, k64);
+    uint8x16_t i3 = vsubq_u8(i2, k64);
+    uint8x16x4_t out;
+    /* Out-of-range lanes are left untouched by vqtbx4q, so the four 64-entry
+       quarters combine into a full 256-entry lookup. */
+    for (c = 0; c < 4; c++) {
+      uint8x16_t v = vqtbl4q_u8(t[c][0], i0);
+      v = vqtbx4q_u8(v, t[c][1], i1);
+      v = vqtbx4q_u8(v, t[c][2], i2);
+      v = vqtbx4q_u8(v, t[c][3], i3);
+      out.val[c] = v;
+    }
+    vst4q_u8((uint8_t*)(dst + i), out);
+  }
+  for (; i < n; i++) dst[i] = g_pal[src[i]];
+}
+#endif
+
+#ifdef PAL_WASM
+static void expand_simd128(uint32_t* dst, const uint8_t* src, int n) {
+  const uint32_t* p = g_pal;
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    v128_t a = wasm_u32x4_make(p[src[i + 0]], p[src[i + 1]],
+                               p[src[i + 2]], p[src[i + 3]]);
+    v128_t b = wasm_u32x4_make(p[src[i + 4]], p[src[i + 5]],
+                               p[src[i + 6]], p[src[i + 7]]);
+    wasm_v128_store(dst + i, a);
+    wasm_v128_store(dst + i + 4, b);
+  }
+  for (; i < n; i++) dst[i] = p[src[i]];
+}
+#endif
+
+static void select_kernel(void) {
+  g_expand = expand_scalar;
+  g_expand_name = "scalar";
+#if defined(PAL_X86)
+  g_expand = expand_sse2;
+  g_expand_name = "sse2";
+  if (cpu_has_avx2()) {
+    g_expand = expand_avx2;
+    g_expand_name = "avx2";
+  }
+#elif defined(PAL_NEON)
+  g_expand = expand_neon;
+  g_expand_name = "neon";
+#elif defined(PAL_WASM)
+  g_expand = expand_simd128;
+  g_expand_name = "simd128";
+#endif
+  /* GOT_PAL_SCALAR=1 forces the portable loop (for comparisons). */
+  {
+    const char* env = getenv("GOT_PAL_SCALAR");
+    if (env && env[0] == '1') {
+      g_expand = expand_scalar;
+      g_expand_name = "scalar";
+    }
+  }
+}
+
+/* --- public API --- */
+
+void pal_expand_set_palette(const uint32_t* pal) {
+  memcpy(g_pal, pal, sizeof(g_pal));
+#ifdef PAL_NEON
+  {
+    int i, c;
+    for (i = 0; i < 256; i++) {
+      uint8_t b[4];
+      memcpy(b, &g_pal[i], 4);
+      for (c = 0; c < 4; c++) g_pal_planar[c][i] = b[c];
+    }
+  }
+#endif
+}
+
+void pal_expand(uint32_t* dst, const uint8_t* src, int n) {
+  if (!g_expand) select_kernel();
+  if (n > 0) g_expand(dst, src, n);
+}
+
+const char* pal_expand_kernel_name(void) {
+  if (!g_expand) select_kernel();
+  return g_expand_name;
+}
+
+/* --- microbenchmark --- */
+
+enum { BENCH_W = 320, BENCH_H = 240 };
+
+/* The original expand loop from platform_raylib.c, kept verbatim for
+   comparison: byte-wise lookups into a [256][4] table, four stores. */
+static void expand_legacy(uint8_t* outp, const uint8_t* inrow, int n,
+                          uint8_t (*pal_rgba)[4]) {
+  int x;
+  for (x = 0; x < n; x++) {
+    uint8_t idx = inrow[x];
+    *outp++ = pal_rgba[idx][0];
+    *outp++ = pal_rgba[idx][1];
+    *outp++ = pal_rgba[idx][2];
+    *outp++ = 255;
+  }
+}
+
+int pal_expand_bench(int frames) {
+  static uint8_t page[BENCH_W * BENCH_H];
+  static uint32_t out_ref[BENCH_W * BENCH_H];
+  static uint32_t out[BENCH_W * BENCH_H];
+  static uint8_t pal_rgba[256][4];
+  uint32_t pal[256];
+  uint32_t seed = 0x1234567u;
+  double t0, t_legacy, t_scalar, t_kernel, mpx;
+  int i, f, y;
+  ExpandFn kernel;
+
+  if (frames <= 0) frames = 1000;
+
+  for (i = 0; i < 256; i++) {
+    pal_rgba[i][0] = (uint8_t)(i * 7);
+    pal_rgba[i][1] = (uint8_t)(i * 13);
+    pal_rgba[i][2] = (uint8_t)(i * 29);
+    pal_rgba[i][3] = 255;
+    memcpy(&pal[i], pal_rgba[i], 4);
+  }
+  for (i = 0; i < BENCH_W * BENCH_H; i++) {
+    seed = seed * 1103515245u + 12345u;
+    page[i] = (uint8_t)(seed >> 16);
+  }
+  pal_expand_set_palette(pal);
+  if (!g_expand) select_kernel();
+  kernel = g_expand;
+
+  t0 = got_clock_wall_s();
+  for (f = 0; f < frames; f++) {
+    for (y = 0; y < BENCH_H; y++) {
+      expand_legacy((uint8_t*)(out_ref + y * BENCH_W), page + y * BENCH_W,
+                    BENCH_W, pal_rgba);
+    }
+  }
+  t_legacy = got_clock_wall_s() - t0;
+
+  t0 = got_clock_wall_s();
+  for (f = 0; f < frames; f++) {
+    for (y = 0; y < BENCH_H; y++) {
+      expand_scalar(out + y * BENCH_W, page + y * BENCH_W, BENCH_W);
+    }
+  }
+  t_scalar = got_clock_wall_s() - t0;
+  if (memcmp(out, out_ref, sizeof(out)) != 0) {
+    printf("pal_expand: scalar output mismatch\n");
+    return 1;
+  }
+
+  memset(out, 0, sizeof(out));
+  t0 = got_clock_wall_s();
+  for (f = 0; f < frames; f++) {
+    for (y = 0; y < BENCH_H; y++) {
+      kernel(out + y * BENCH_W, page + y * BENCH_W, BENCH_W);
+    }
+  }
+  t_kernel = got_clock_wall_s() - t0;
+  if (memcmp(out, out_ref, sizeof(out)) != 0) {
+    printf("pal_expand: %s output mismatch\n", g_expand_name);
+    return 1;
+  }
+
+  mpx = (double)BENCH_W * BENCH_H * frames / 1e6;
+  printf("pal_expand: %d frames of %dx%d\n", frames, BENCH_W, BENCH_H);
+  printf("  legacy  %8.2f ms  %8.1f Mpx/s\n", t_legacy * 1000.0, mpx / t_legacy);
+  printf("  scalar  %8.2f ms  %8.1f Mpx/s\n", t_scalar * 1000.0, mpx / t_scalar);
+  printf("  %-7s %8.2f ms  %8.1f Mpx/s  (%.2fx legacy)\n", g_expand_name,
+         t_kernel * 1000.0, mpx / t_kernel, t_legacy / t_kernel);
+  return 0;
+}
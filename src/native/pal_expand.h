@@ -0,0 +1,27 @@
+#ifndef PAL_EXPAND_H
+#define PAL_EXPAND_H
+
+#include <stdint.h>
+
+/* 8bpp index -> RGBA32 expansion used when composing frames for upload.
+
+   The palette is a 256-entry uint32_t table whose bytes are r,g,b,a in memory
+   order (i.e. ready for an RGBA8 texture). The kernel is picked once at first
+   use: AVX2 gather or SSE2 on x86 (runtime dispatch), NEON table lookups on
+   AArch64, SIMD128 on WebAssembly builds with -msimd128, scalar otherwise. */
+
+/* Load the table used by pal_expand(). */
+void pal_expand_set_palette(const uint32_t* pal);
+
+/* dst[i] = pal[src[i]] for n pixels. */
+void pal_expand(uint32_t* dst, const uint8_t* src, int n);
+
+/* Name of the selected kernel ("avx2", "sse2", "neon", "simd128", "scalar"). */
+const char* pal_expand_kernel_name(void);
+
+/* Microbenchmark: time the original byte-by-byte loop, the scalar uint32_t
+   loop and the selected kernel over full 320x240 frames, check they agree,
+   and print the results to stdout. Returns 0 on success. */
+int pal_expand_bench(int frames);
+
+#endif
@@ -1,5 +1,10 @@
 #include "got_platform.h"
+#include "got_clock.h"
+#include "got_replay.h"
 #include "gui.h"
+#include "pal_expand.h"
+#include "sprite_atlas.h"
+#include "tile_cache.h"
 
 #include "raylib.h"
 
@@ -22,6 +27,7 @@ float got_web_gamepad_button_value(int pad, int btn);
 
 #include <dos.h>
 #include "modern.h"
+#include "res_man.h"
 #if defined(GOT_EPISODE) && GOT_EPISODE == 2
 #include "2_define.h"
 #include "2_proto.h"
@@ -48,6 +54,7 @@ int xsetpal(unsigned char color, unsigned char R,unsigned char G,unsigned char B
 /* Sound/mus tick services (native build provides FX_*, MU_* stubs/impls). */
 void FX_ServicePC(void);
 void MU_Service(void);
+void got_adlib_tick(void);
 
 enum {
   GOT_W = 320,
@@ -56,11 +63,23 @@ enum {
   GOT_STAT_H = 48
 };
 
+/* Dirty tracking works on 16x16 cells: one uint32_t bitmask per cell row
+   (20 cells across 320px). */
+enum {
+  DIRTY_CELL = 16,
+  DIRTY_COLS = GOT_W / DIRTY_CELL,
+  DIRTY_ROWS_FULL = GOT_H / DIRTY_CELL,
+  DIRTY_ROWS_PLAY = GOT_PLAY_H / DIRTY_CELL,
+  DIRTY_ROWS_STAT = GOT_STAT_H / DIRTY_CELL
+};
+#define DIRTY_ROW_ALL ((1u << DIRTY_COLS) - 1u)
+
 typedef struct {
   int w;
   int h;
   int stride;
   uint8_t* pix;
+  uint32_t* dirty; /* h / DIRTY_CELL row masks */
 } Surf8;
 
 static int g_split_mode = 0;
@@ -69,17 +88,31 @@ static uint8_t g_full_pages[3][GOT_W * GOT_H];
 static uint8_t g_play_pages[3][GOT_W * GOT_PLAY_H];
 static uint8_t g_stat_page[GOT_W * GOT_STAT_H];
 
+/* Per-surface cells that may differ from what g_frame_tex currently shows for
+   that surface's screen region. Presenting surface X uploads only X's dirty
+   cells; any other surface of the same kind then may differ from the texture
+   wherever X did, so X's mask is OR'ed into theirs before X's is cleared.
+   This keeps page flipping (PAGE0/PAGE1) correct without comparing pages. */
+static uint32_t g_dirty_full[3][DIRTY_ROWS_FULL];
+static uint32_t g_dirty_play[3][DIRTY_ROWS_PLAY];
+static uint32_t g_dirty_stat[DIRTY_ROWS_STAT];
+static int g_tex_layout = -1;   /* -1 unknown, 0 full page, 1 split */
+static int g_pal_dirty = 1;     /* palette changed since last upload */
+
 static uint8_t g_pal6[256][3];         /* 0..63 */
 static uint8_t g_pal8[256][3];         /* 0..255 */
-static uint8_t g_pal_rgba[256][4];     /* r,g,b,a */
+static uint32_t g_pal32[256];          /* r,g,b,a bytes, see pal_expand.h */
 
 static unsigned g_last_show_pagebase = 0;
 
-static double g_last_time_s = 0.0;
-static double g_tick_accum_s = 0.0;
-static double g_frame_next_s = 0.0;
 static double g_present_next_s = 0.0; /* web: 60Hz present schedule */
 
+/* Headless mode: no window, GL context or input devices. Frames are composed
+   into the page surfaces as usual but never presented. Timing comes from the
+   virtual clock (got_clock.c) like it always does; headless runs normally pair
+   this with GOT_CLOCK_FREE so the game runs as fast as the CPU allows. */
+static int g_headless = 0;
+
 /* Palette-cycling state ported from src/utility/g_asm.asm xshowpage.
    DOS animates a handful of palette entries as part of page-flip/vblank.
    In the native renderer palette changes must occur before index->RGBA
@@ -159,9 +192,58 @@ static void maybe_palette_cycle_for_frame(void) {
 }
 
 static int g_video_ready = 0;
+/* Intermediate 320x240 target. Plain presentation draws the frame texture
+   straight to the backbuffer; g_rt only exists for paths that need the
+   composed frame as a texture first (see present_needs_rt()). */
 static RenderTexture2D g_rt;
+static unsigned long g_present_direct = 0;
+static unsigned long g_present_via_rt = 0;
 static Texture2D g_frame_tex;
-static uint8_t g_frame_rgba[GOT_W * GOT_H * 4];
+static uint32_t g_frame_px[GOT_W * GOT_H]; /* RGBA8 */
+
+static int g_present_mode = GOT_PRESENT_CPU;
+
+/* GPU palette path: the shown page as a one-channel index texture plus the
+   palette as a 256x1 RGBA texture, resolved by g_pal_shader. */
+static Texture2D g_idx_tex;
+static Texture2D g_pal_tex;
+static Shader g_pal_shader;
+static int g_pal_shader_loc = -1;
+static uint8_t g_frame_idx[GOT_W * GOT_H];
+
+/* GOT_PRESENT_CHECK: the CPU path renders into g_rt_check and is compared
+   against the GPU path in g_rt after every present. */
+static RenderTexture2D g_rt_check;
+static unsigned long g_check_frames = 0;
+static unsigned long g_check_bad = 0;
+
+#ifdef __EMSCRIPTEN__
+static const char* g_pal_fs =
+  "#version 100\n"
+  "#ifdef GL_FRAGMENT_PRECISION_HIGH\n"
+  "precision highp float;\n"
+  "#else\n"
+  "precision mediump float;\n"
+  "#endif\n"
+  "varying vec2 fragTexCoord;\n"
+  "uniform sampler2D texture0;\n"
+  "uniform sampler2D palette;\n"
+  "void main() {\n"
+  "  float i = floor(texture2D(texture0, fragTexCoord).r * 255.0 + 0.5);\n"
+  "  gl_FragColor = texture2D(palette, vec2((i + 0.5) / 256.0, 0.5));\n"
+  "}\n";
+#else
+static const char* g_pal_fs =
+  "#version 330\n"
+  "in vec2 fragTexCoord;\n"
+  "uniform sampler2D texture0;\n"
+  "uniform sampler2D palette;\n"
+  "out vec4 finalColor;\n"
+  "void main() {\n"
+  "  int i = int(texture(texture0, fragTexCoord).r * 255.0 + 0.5);\n"
+  "  finalColor = texelFetch(palette, ivec2(i, 0), 0);\n"
+  "}\n";
+#endif
 
 /* Mouse state, in 320x240 "game pixels". */
 static int g_mouse_x = 0;
@@ -176,6 +258,7 @@ static Surf8 surf_full_idx(int idx) {
   s.h = GOT_H;
   s.stride = GOT_W;
   s.pix = &g_full_pages[idx][0];
+  s.dirty = &g_dirty_full[idx][0];
   return s;
 }
 
@@ -187,6 +270,7 @@ static Surf8 surf_play_idx(int idx) {
   s.h = GOT_PLAY_H;
   s.stride = GOT_W;
   s.pix = &g_play_pages[idx][0];
+  s.dirty = &g_dirty_play[idx][0];
   return s;
 }
 
@@ -196,6 +280,7 @@ static Surf8 surf_stat(void) {
   s.h = GOT_STAT_H;
   s.stride = GOT_W;
   s.pix = &g_stat_page[0];
+  s.dirty = &g_dirty_stat[0];
   return s;
 }
 
@@ -241,16 +326,44 @@ static Surf8 resolve_surf(unsigned int pagebase) {
   return surf_full_idx(nearest_full_page_idx(pagebase));
 }
 
+/* Mark [x0,x1) x [y0,y1) dirty. */
+static void mark_dirty(Surf8 s, int x0, int y0, int x1, int y1) {
+  uint32_t bits;
+  int cy;
+  if (x0 < 0) x0 = 0;
+  if (y0 < 0) y0 = 0;
+  if (x1 > s.w) x1 = s.w;
+  if (y1 > s.h) y1 = s.h;
+  if (x1 <= x0 || y1 <= y0) return;
+  x0 /= DIRTY_CELL;
+  x1 = (x1 - 1) / DIRTY_CELL;
+  bits = (DIRTY_ROW_ALL >> (DIRTY_COLS - 1 - x1)) & ~((1u << x0) - 1u);
+  for (cy = y0 / DIRTY_CELL; cy <= (y1 - 1) / DIRTY_CELL; cy++) {
+    s.dirty[cy] |= bits;
+  }
+}
+
+static void mark_all_dirty(void) {
+  int i, r;
+  for (i = 0; i < 3; i++) {
+    for (r = 0; r < DIRTY_ROWS_FULL; r++) g_dirty_full[i][r] = DIRTY_ROW_ALL;
+    for (r = 0; r < DIRTY_ROWS_PLAY; r++) g_dirty_play[i][r] = DIRTY_ROW_ALL;
+  }
+  for (r = 0; r < DIRTY_ROWS_STAT; r++) g_dirty_stat[r] = DIRTY_ROW_ALL;
+}
+
 static void clear_surf(Surf8 s, uint8_t color) {
   int y;
   for (y = 0; y < s.h; y++) {
     memset(s.pix + y * s.stride, color, (size_t)s.w);
   }
+  mark_dirty(s, 0, 0, s.w, s.h);
 }
 
 static void put_pixel(Surf8 s, int x, int y, uint8_t c) {
   if ((unsigned)x >= (unsigned)s.w || (unsigned)y >= (unsigned)s.h) return;
   s.pix[y * s.stride + x] = c;
+  s.dirty[y / DIRTY_CELL] |= 1u << (x / DIRTY_CELL);
 }
 
 static uint8_t get_pixel(Surf8 s, int x, int y) {
@@ -282,6 +395,7 @@ static void blit_rect(Surf8 src, int sx, int sy, int ex, int ey,
             src.pix + (sy + row) * src.stride + sx,
             (size_t)w);
   }
+  mark_dirty(dst, dx, dy, dx + w, dy + h);
 }
 
 static void draw_planar_to_surf(Surf8 dst, int x, int y,
@@ -309,25 +423,107 @@ static void draw_planar_masked_to_surf(Surf8 dst, int x, int y,
                                        const uint8_t* planes, int w_bytes, int h) {
   /* Actor/sprite convention in original asm: treat 0 and 15 as transparent. */
   int plane_sz = w_bytes * h;
-  int p, row, bx;
+  int p, row, bx, r0 = 0, r1 = h;
+
+  /* Clip once: rows here, then the on-surface byte range of each plane. */
+  if (y < 0) r0 = -y;
+  if (y + h > dst.h) r1 = dst.h - y;
+  if (r0 >= r1 || x >= dst.w || x + w_bytes * 4 <= 0) return;
   for (p = 0; p < 4; p++) {
     const uint8_t* plane = planes + p * plane_sz;
-    for (row = 0; row < h; row++) {
-      for (bx = 0; bx < w_bytes; bx++) {
-        uint8_t v = plane[row * w_bytes + bx];
-        int px = x + (bx * 4) + p;
-        int py = y + row;
-        if (v == 0 || v == 15) continue;
-        put_pixel(dst, px, py, v);
+    int b0 = 0, b1 = w_bytes;
+    if (x + p < 0) b0 = (3 - x - p) / 4;
+    if (x + p + (w_bytes - 1) * 4 >= dst.w) b1 = (dst.w - x - p + 3) / 4;
+    for (row = r0; row < r1; row++) {
+      const uint8_t* src = plane + row * w_bytes;
+      uint8_t* d = dst.pix + (y + row) * dst.stride + x + p;
+      for (bx = b0; bx < b1; bx++) {
+        uint8_t v = src[bx];
+        if (v != 0 && v != 15) d[bx * 4] = v;
       }
     }
   }
+  mark_dirty(dst, x, y + r0, x + w_bytes * 4, y + r1);
+}
+
+/* Atlas frame: copy each row's opaque runs; clipping is worked out once per
+   sprite, and only the frame's opaque box is marked dirty. */
+static void draw_sprite_to_surf(Surf8 dst, int x, int y, const SpriteFrame* f) {
+  int row, i, y0, y1;
+
+  if (f->x0 == f->x1) return;
+  y0 = f->y0;
+  y1 = f->y1;
+  if (y + y0 < 0) y0 = -y;
+  if (y + y1 > dst.h) y1 = dst.h - y;
+  if (y0 >= y1 || x + f->x1 <= 0 || x + f->x0 >= dst.w) return;
+
+  if (x + f->x0 >= 0 && x + f->x1 <= dst.w) {
+    for (row = y0; row < y1; row++) {
+      uint8_t* d = dst.pix + (y + row) * dst.stride + x;
+      const SpriteRun* r = f->run[row];
+      for (i = 0; i < f->runs[row]; i++) {
+        memcpy(d + r[i].x, &f->pix[row][r[i].x], r[i].len);
+      }
+    }
+  }
+  else {
+    int cx0 = -x, cx1 = dst.w - x;
+    for (row = y0; row < y1; row++) {
+      uint8_t* d = dst.pix + (y + row) * dst.stride + x;
+      const SpriteRun* r = f->run[row];
+      for (i = 0; i < f->runs[row]; i++) {
+        int s0 = r[i].x, s1 = r[i].x + r[i].len;
+        if (s0 < cx0) s0 = cx0;
+        if (s1 > cx1) s1 = cx1;
+        if (s0 < s1) memcpy(d + s0, &f->pix[row][s0], (size_t)(s1 - s0));
+      }
+    }
+  }
+  mark_dirty(dst, x + f->x0, y + y0, x + f->x1, y + y1);
 }
 
 void got_platform_set_split(int on) {
   g_split_mode = on ? 1 : 0;
 }
 
+void got_platform_set_headless(int on) {
+  /* Only meaningful before the first video init. */
+  if (g_video_ready) return;
+  g_headless = on ? 1 : 0;
+}
+
+int got_platform_is_headless(void) {
+  return g_headless;
+}
+
+void got_platform_set_present_mode(int mode) {
+  /* Textures and shader are created with the window. */
+  if (g_video_ready) return;
+  if (mode != GOT_PRESENT_GPU && mode != GOT_PRESENT_CHECK) mode = GOT_PRESENT_CPU;
+  g_present_mode = mode;
+}
+
+static int present_uses_cpu(void) {
+  return g_present_mode != GOT_PRESENT_GPU;
+}
+
+static int present_uses_gpu(void) {
+  return g_present_mode != GOT_PRESENT_CPU;
+}
+
+/* Integer scaling straight from the frame texture is exact, so g_rt is only
+   needed when the frame is read back or post-processed. Today that is the
+   CHECK comparison; a filter or non-integer scaling would be added here. */
+static int present_needs_rt(void) {
+  return g_present_mode == GOT_PRESENT_CHECK;
+}
+
+void got_platform_present_stats(unsigned long* out_direct, unsigned long* out_via_rt) {
+  if (out_direct) *out_direct = g_present_direct;
+  if (out_via_rt) *out_via_rt = g_present_via_rt;
+}
+
 static void compute_viewport(int* out_dx, int* out_dy, int* out_scale) {
   int sw = GetScreenWidth();
   int sh = GetScreenHeight();
@@ -378,6 +574,7 @@ int got_platform_mouse_button_down(int button) {
 }
 
 int got_platform_gamepad_is_available(int gamepad) {
+  if (g_headless) return 0;
 #ifdef __EMSCRIPTEN__
   return got_web_gamepad_is_connected(gamepad);
 #else
@@ -401,6 +598,8 @@ static int raylib_button_from_custom(int custom) {
     case 12: return GAMEPAD_BUTTON_LEFT_FACE_DOWN;   /* D-Down */
     case 13: return GAMEPAD_BUTTON_LEFT_FACE_LEFT;   /* D-Left */
     case 14: return GAMEPAD_BUTTON_LEFT_FACE_RIGHT;  /* D-Right */
+    case 15: return GAMEPAD_BUTTON_LEFT_TRIGGER_2;   /* LT */
+    case 16: return GAMEPAD_BUTTON_RIGHT_TRIGGER_2;  /* RT */
     case 17: return GAMEPAD_BUTTON_MIDDLE;           /* Guide */
     default: return GAMEPAD_BUTTON_UNKNOWN;
   }
@@ -433,11 +632,58 @@ float got_platform_gamepad_axis_movement(int gamepad, int axis) {
 #endif
 }
 
-void got_platform_video_init(void) {
-  int i;
+static void video_load_palette_shader(void) {
   Image img;
 
-  if (g_video_ready) return;
+  img.data = g_frame_idx;
+  img.width = GOT_W;
+  img.height = GOT_H;
+  img.mipmaps = 1;
+  img.format = PIXELFORMAT_UNCOMPRESSED_GRAYSCALE;
+  g_idx_tex = LoadTextureFromImage(img);
+  SetTextureFilter(g_idx_tex, TEXTURE_FILTER_POINT);
+
+  img.data = g_pal32;
+  img.width = 256;
+  img.height = 1;
+  img.format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8;
+  g_pal_tex = LoadTextureFromImage(img);
+  SetTextureFilter(g_pal_tex, TEXTURE_FILTER_POINT);
+
+  g_pal_shader = LoadShaderFromMemory(NULL, g_pal_fs);
+  g_pal_shader_loc = GetShaderLocation(g_pal_shader, "palette");
+  if (g_pal_shader_loc < 0) {
+    /* A failed compile leaves raylib's default shader, which has no palette
+       sampler. */
+    fprintf(stderr, "Palette shader unavailable, presenting on the CPU\n");
+    UnloadShader(g_pal_shader);
+    UnloadTexture(g_pal_tex);
+    UnloadTexture(g_idx_tex);
+    g_present_mode = GOT_PRESENT_CPU;
+    return;
+  }
+
+  if (g_present_mode == GOT_PRESENT_CHECK) {
+    g_rt_check = LoadRenderTexture(GOT_W, GOT_H);
+    SetTextureFilter(g_rt_check.texture, TEXTURE_FILTER_POINT);
+    g_check_frames = 0;
+    g_check_bad = 0;
+  }
+}
+
+static void video_unload_palette_shader(void) {
+  if (g_present_mode == GOT_PRESENT_CHECK) {
+    fprintf(stderr, "Present check: %lu frames, %lu mismatched\n",
+            g_check_frames, g_check_bad);
+    UnloadRenderTexture(g_rt_check);
+  }
+  UnloadShader(g_pal_shader);
+  UnloadTexture(g_pal_tex);
+  UnloadTexture(g_idx_tex);
+}
+
+static void video_open_window(void) {
+  Image img;
 
   /* The DOS build presents around the VGA retrace cadence (~70Hz) and game
      logic is effectively coupled to page-flips. Avoid monitor-refresh vsync
@@ -448,9 +694,6 @@ void got_platform_video_init(void) {
   }
   SetWindowTitle("God of Thunder");
 
-  g_rt = LoadRenderTexture(GOT_W, GOT_H);
-  SetTextureFilter(g_rt.texture, TEXTURE_FILTER_POINT);
-
   /* Avoid raylib's internal frame limiter. We control pacing in xshowpage(). */
   SetTargetFPS(0);
 
@@ -459,20 +702,84 @@ void got_platform_video_init(void) {
   UnloadImage(img);
   SetTextureFilter(g_frame_tex, TEXTURE_FILTER_POINT);
 
+  if (g_present_mode != GOT_PRESENT_CPU) video_load_palette_shader();
+
+  if (present_needs_rt()) {
+    g_rt = LoadRenderTexture(GOT_W, GOT_H);
+    SetTextureFilter(g_rt.texture, TEXTURE_FILTER_POINT);
+  }
+  g_present_direct = 0;
+  g_present_via_rt = 0;
+}
+
+/* GOT_PRESENT_STATS / GOT_RES_CACHE_STATS counters. Printed at exit, so
+   that every way out reports them: exit_code(), a closed window, and a
+   headless replay that ends from inside the game loop. */
+static void video_print_stats(void) {
+  const char* env = getenv("GOT_PRESENT_STATS");
+  if (env && env[0] == '1') {
+    fprintf(stderr, "Present: %lu frames direct, %lu via render target\n",
+            g_present_direct, g_present_via_rt);
+    {
+      int frames;
+      long bytes;
+      sprite_atlas_stats(&frames, &bytes);
+      fprintf(stderr, "Sprite atlas: %d frames, %ld KB\n", frames, bytes / 1024);
+    }
+    {
+      TILE_CACHE_STATS tc;
+      tile_cache_stats(&tc);
+      fprintf(stderr, "Tile layers: %ld screens from cache, %ld composed, "
+              "%ld cells patched\n", tc.hits, tc.misses, tc.patched);
+    }
+  }
+  env = getenv("GOT_RES_CACHE_STATS");
+  if (env && env[0] == '1') {
+    RES_CACHE_STATS st;
+    res_cache_stats(&st);
+    fprintf(stderr, "Resource cache: %ld hits, %ld misses, %ld evictions, "
+            "%d entries / %ld of %ld KB\n", st.hits, st.misses, st.evictions,
+            st.entries, st.bytes / 1024, st.budget / 1024);
+    {
+      RES_PREFETCH_STATS pf;
+      res_prefetch_stats(&pf);
+      fprintf(stderr, "Resource prefetch: %ld hits, %ld misses (%.0f%%), "
+              "%ld decoded ahead, %ld requests dropped\n", pf.hits, pf.misses,
+              pf.hits + pf.misses ? 100.0 * pf.hits / (pf.hits + pf.misses) : 0.0,
+              pf.queued, pf.dropped);
+    }
+  }
+}
+
+void got_platform_video_init(void) {
+  static int stats_registered;
+  int i;
+
+  if (g_video_ready) return;
+  if (!stats_registered) {
+    atexit(video_print_stats);
+    stats_registered = 1;
+  }
+
+  if (!g_headless) video_open_window();
+
   memset(g_full_pages, 0, sizeof(g_full_pages));
   memset(g_play_pages, 0, sizeof(g_play_pages));
   memset(g_stat_page, 0, sizeof(g_stat_page));
 
   memset(g_pal6, 0, sizeof(g_pal6));
   memset(g_pal8, 0, sizeof(g_pal8));
-  memset(g_pal_rgba, 0, sizeof(g_pal_rgba));
   for (i = 0; i < 256; i++) {
-    g_pal_rgba[i][3] = 255;
+    const uint8_t black[4] = { 0, 0, 0, 255 };
+    memcpy(&g_pal32[i], black, 4);
   }
+  mark_all_dirty();
+  g_tex_layout = -1;
+  g_pal_dirty = 1;
 
-  g_last_time_s = GetTime();
-  g_tick_accum_s = 0.0;
-  g_frame_next_s = 0.0;
+  /* Each game session starts from virtual time 0 so timer/music state is
+     reproducible from run to run. */
+  got_clock_reset();
   g_present_next_s = 0.0;
   g_video_ready = 1;
 }
@@ -480,8 +787,17 @@ void got_platform_video_init(void) {
 void got_platform_video_shutdown(void) {
   if (!g_video_ready) return;
 
+  if (g_headless) {
+    g_video_ready = 0;
+    return;
+  }
+
+  if (g_present_mode != GOT_PRESENT_CPU) video_unload_palette_shader();
   UnloadTexture(g_frame_tex);
-  UnloadRenderTexture(g_rt);
+  if (g_rt.id) {
+    UnloadRenderTexture(g_rt);
+    memset(&g_rt, 0, sizeof(g_rt));
+  }
   CloseWindow();
   g_video_ready = 0;
 }
@@ -492,7 +808,12 @@ static void got_platform_tick_120hz(void) {
   magic_cnt++;
   extra_cnt++;
   FX_ServicePC();
+  /* Stamp this tick's OPL writes before MU_Service() issues them. */
+  got_adlib_tick();
   MU_Service();
+  /* No audio device drains the mixer headless; keep sample playback state
+     (sound_playing() etc.) moving in step with the virtual clock. */
+  if (g_headless) got_platform_audio_tick();
 }
 
 static uint8_t g_kb_down[100];
@@ -720,13 +1041,17 @@ static void apply_gamepad_state(void) {
   }
 }
 
-void got_platform_pump(void) {
+static void platform_pump(int idle) {
+  GOT_REPLAY_PUMP rp;
+  char before[GOT_REPLAY_MAX_KEYS];
+  int ticks, replaying, i;
+
   /* raylib updates keyboard/gamepad state when PollInputEvents() runs.
      Most of the game calls xshowpage() every frame (EndDrawing() does this),
      but some screens spin in wait loops without drawing (e.g. story_wait()).
      If we don't poll here, IsKeyDown()/WindowShouldClose() never change and
      those wait loops look like "hangs". */
-  if (g_video_ready) {
+  if (g_video_ready && !g_headless) {
     PollInputEvents();
   }
 
@@ -753,21 +1078,45 @@ void got_platform_pump(void) {
   }
 #endif
 
-  double now = GetTime();
-  double dt = now - g_last_time_s;
+  /* 120Hz ticks come from the virtual clock, which only moves on frame
+     boundaries and delay(), so every run sees the same tick sequence. Calls
+     from game-side wait loops that stopped presenting let realtime mode catch
+     up with the wall clock instead (see got_clock_idle()); a replay repeats
+     the recorded catch-up. */
+  rp.idle_ms = 0;
+  rp.item_cycle = 0;
+  rp.nkeys = 0;
+  replaying = got_replay_next(&rp);
+  if (replaying) got_clock_advance_ms(rp.idle_ms);
+  else if (idle) rp.idle_ms = got_clock_idle();
+  ticks = got_clock_take_ticks();
+  while (ticks-- > 0) {
+    got_platform_tick_120hz();
+  }
 
-  if (dt < 0.0) dt = 0.0;
-  /* Cap dt to prevent a burst of ticks after long gaps (e.g. first call when
-     g_last_time_s is still 0, or after loading screens/window creation). */
-  if (dt > 0.1) dt = 0.1;
-  g_last_time_s = now;
+  /* A replay stands in for the devices (see got_replay.h). */
+  if (replaying) {
+    for (i = 0; i < rp.nkeys; i++) {
+      key_flag[rp.keys[i] & 0x7f] = (rp.keys[i] & 0x80) ? 1 : 0;
+    }
+    g_item_cycle_dir = rp.item_cycle;
+#ifndef __EMSCRIPTEN__
+    /* Closing the window abandons the playback. */
+    if (g_video_ready && !g_headless && WindowShouldClose()) {
+      got_replay_finish();
+      exit(got_replay_status());
+    }
+#endif
+    return;
+  }
 
-  g_tick_accum_s += dt;
-  while (g_tick_accum_s >= (1.0 / 120.0)) {
-    g_tick_accum_s -= (1.0 / 120.0);
-    got_platform_tick_120hz();
+  /* Headless input only comes from the game side (demo playback). */
+  if (g_headless) {
+    got_replay_put(&rp);
+    return;
   }
 
+  memcpy(before, (const void*)key_flag, sizeof(before));
   apply_keyboard_state();
   apply_gamepad_state();
   {
@@ -795,44 +1144,44 @@ void got_platform_pump(void) {
 #ifndef __EMSCRIPTEN__
   if (WindowShouldClose()) key_flag[ESC] = 1;
 #endif
+
+  if (got_replay_mode() == GOT_REPLAY_RECORD) {
+    for (i = 1; i < GOT_REPLAY_MAX_KEYS; i++) {
+      if ((key_flag[i] != 0) != (before[i] != 0)) {
+        rp.keys[rp.nkeys++] = (uint8_t)(i | (key_flag[i] ? 0x80 : 0));
+      }
+    }
+    rp.item_cycle = g_item_cycle_dir;
+    got_replay_put(&rp);
+  }
+}
+
+void got_platform_pump(void) {
+  platform_pump(1);
 }
 
 static void got_platform_wait_for_frame(void) {
-  /* Web note: Avoid using raylib's internal WaitTime/nanosleep pacing. We do
-     our own, and on web we keep it deterministic using emscripten_get_now(). */
-#ifdef __EMSCRIPTEN__
-  /* Run game logic at DOS-ish vblank cadence. We'll drop/skip presents to fit
-     a 60Hz browser display later. */
-  const double frame_dt = 1.0 / 70.0;
-  double now = emscripten_get_now() / 1000.0;
-#else
-  const double frame_dt = 1.0 / 70.0;
-  double now = GetTime();
-#endif
+  double remain_s;
 
-  if (g_frame_next_s <= 0.0) {
-    g_frame_next_s = now;
-  }
-  if (g_frame_next_s < now - frame_dt * 2) {
-    /* Don't accumulate more than ~2 frames of debt.  Large gaps happen
-       during level loading; without this cap the subsequent scroll/
-       transition frames would burn through the debt instantly, making
-       the animation invisible. */
-    g_frame_next_s = now;
-  }
-  g_frame_next_s += frame_dt;
+  /* Advance virtual time by one 70Hz frame. Its 120Hz ticks are delivered by
+     the pump at the end, after any realtime wait. */
+  got_clock_end_frame();
+
+  /* Web note: Avoid using raylib's internal WaitTime/nanosleep pacing. We do
+     our own, and on web we keep it deterministic using emscripten_get_now().
+     Free-running clock: never wait. */
+  remain_s = got_clock_remaining_s();
 
 #ifdef __EMSCRIPTEN__
   {
     /* Browser-friendly wait:
        Yield once per frame (Asyncify) instead of looping and yielding many
        times. Too many short sleeps can cause severe stutter. */
-    double remain_s = g_frame_next_s - now;
     if (remain_s > 0.0) {
       double remain_ms = remain_s * 1000.0;
 
       /* Pump once before yielding so key edges are responsive even during waits. */
-      got_platform_pump();
+      platform_pump(0);
 
       if (remain_ms > 2.0) {
         /* Sleep most of the remaining time, then finish with a short spin to
@@ -842,31 +1191,85 @@ static void got_platform_wait_for_frame(void) {
         if (sleep_ms > 0) emscripten_sleep((unsigned)sleep_ms);
 
         /* Finish the last ~1ms with a short spin/pump. */
-        while ((now = emscripten_get_now() / 1000.0) < g_frame_next_s) {
-          got_platform_pump();
+        while (got_clock_remaining_s() > 0.0) {
+          platform_pump(0);
         }
       } else {
         /* If we're within ~2ms, just yield and keep going. */
         emscripten_sleep(0);
       }
-    } else {
+    } else if (got_clock_mode() == GOT_CLOCK_REALTIME) {
       /* Already late; at least yield once so the browser can paint. */
       emscripten_sleep(0);
     }
   }
 #else
-  while ((now = GetTime()) < g_frame_next_s) {
-    got_platform_pump();
-    if ((g_frame_next_s - now) > 0.002) {
-      delay(1);
+  while (remain_s > 0.0) {
+    platform_pump(0);
+    if (remain_s > 0.002) {
+      got_clock_sleep_ms(1);
     }
+    remain_s = got_clock_remaining_s();
   }
 #endif
+
+  platform_pump(0);
 }
 
-static void upload_composited_rgba(unsigned int pagebase) {
-  int x, y;
-  uint8_t* outp = g_frame_rgba;
+/* First dirty cell .. last dirty cell of a row mask, in pixels. */
+static void dirty_span(uint32_t m, int* out_x0, int* out_w) {
+  int c0 = 0, c1 = DIRTY_COLS - 1;
+  while (!(m & (1u << c0))) c0++;
+  while (!(m & (1u << c1))) c1--;
+  *out_x0 = c0 * DIRTY_CELL;
+  *out_w = (c1 + 1 - c0) * DIRTY_CELL;
+}
+
+/* Upload the dirty cells of src into the textures at rows tex_y.., then clear
+   src's mask. One UpdateTextureRec per cell row and texture, spanning its
+   first to last dirty cell. After a palette change (all) the RGBA texture
+   needs every cell; the index texture never does. */
+static void upload_surf_dirty(Surf8 src, int tex_y, int all) {
+  static uint32_t rect_px[GOT_W * DIRTY_CELL];
+  static uint8_t rect_idx[GOT_W * DIRTY_CELL];
+  int cpu = present_uses_cpu();
+  int gpu = present_uses_gpu();
+  int cy;
+  for (cy = 0; cy < src.h / DIRTY_CELL; cy++) {
+    uint32_t m = src.dirty[cy];
+    uint32_t m_rgba = all ? DIRTY_ROW_ALL : m;
+    const uint8_t* rows = src.pix + cy * DIRTY_CELL * src.stride;
+    int x0, w, row;
+    Rectangle r;
+    src.dirty[cy] = 0;
+    r.y = (float)(tex_y + cy * DIRTY_CELL);
+    r.height = (float)DIRTY_CELL;
+    if (cpu && m_rgba) {
+      dirty_span(m_rgba, &x0, &w);
+      for (row = 0; row < DIRTY_CELL; row++) {
+        pal_expand(rect_px + row * w, rows + row * src.stride + x0, w);
+      }
+      r.x = (float)x0;
+      r.width = (float)w;
+      UpdateTextureRec(g_frame_tex, r, rect_px);
+    }
+    if (gpu && m) {
+      dirty_span(m, &x0, &w);
+      for (row = 0; row < DIRTY_CELL; row++) {
+        memcpy(rect_idx + row * w, rows + row * src.stride + x0, (size_t)w);
+      }
+      r.x = (float)x0;
+      r.width = (float)w;
+      UpdateTextureRec(g_idx_tex, r, rect_idx);
+    }
+  }
+}
+
+/* Compose the whole 320x240 index frame for pagebase into g_frame_idx and
+   upload it to every texture in use. */
+static void upload_full_frame(unsigned int pagebase) {
+  int y;
+  uint8_t* outp = g_frame_idx;
 
   if (!g_split_mode) {
     /* Handle smooth hardware-style scrolling (story sequences).
@@ -879,18 +1282,11 @@ static void upload_composited_rgba(unsigned int pagebase) {
       int pg  = src_line / GOT_H;
       int row = src_line % GOT_H;
       Surf8 src;
-      const uint8_t* inrow;
       if (pg < 0) pg = 0;
       if (pg > 2) pg = 2;
       src = surf_full_idx(pg);
-      inrow = src.pix + row * src.stride;
-      for (x = 0; x < GOT_W; x++) {
-        uint8_t idx = inrow[x];
-        *outp++ = g_pal_rgba[idx][0];
-        *outp++ = g_pal_rgba[idx][1];
-        *outp++ = g_pal_rgba[idx][2];
-        *outp++ = 255;
-      }
+      memcpy(outp, src.pix + row * src.stride, GOT_W);
+      outp += GOT_W;
     }
   }
   else {
@@ -906,64 +1302,203 @@ static void upload_composited_rgba(unsigned int pagebase) {
     else if (off == 80) dy = 1;
 
     {
+      /* Shifted rows are one in-range span plus index-0 padding (what
+         get_pixel() returns off-surface), so no per-pixel clamps. */
       Surf8 top = surf_play_idx(base_idx);
       Surf8 st = surf_stat();
-      for (y = 0; y < GOT_H; y++) {
-        for (x = 0; x < GOT_W; x++) {
-          uint8_t idx;
-          if (y < GOT_PLAY_H) {
-            idx = get_pixel(top, x + dx, y + dy);
-          }
-          else {
-            idx = st.pix[(y - GOT_PLAY_H) * st.stride + x];
-          }
-          *outp++ = g_pal_rgba[idx][0];
-          *outp++ = g_pal_rgba[idx][1];
-          *outp++ = g_pal_rgba[idx][2];
-          *outp++ = 255;
+      for (y = 0; y < GOT_PLAY_H; y++, outp += GOT_W) {
+        int sy = y + dy;
+        const uint8_t* row;
+        if (sy < 0 || sy >= top.h) {
+          memset(outp, 0, GOT_W);
+          continue;
         }
+        row = top.pix + sy * top.stride;
+        if (dx > 0) {
+          memcpy(outp, row + dx, (size_t)(GOT_W - dx));
+          memset(outp + GOT_W - dx, 0, (size_t)dx);
+        }
+        else if (dx < 0) {
+          memset(outp, 0, (size_t)-dx);
+          memcpy(outp - dx, row, (size_t)(GOT_W + dx));
+        }
+        else {
+          memcpy(outp, row, GOT_W);
+        }
+      }
+      for (y = 0; y < GOT_STAT_H; y++, outp += GOT_W) {
+        memcpy(outp, st.pix + y * st.stride, GOT_W);
       }
     }
   }
 
-  UpdateTexture(g_frame_tex, g_frame_rgba);
+  if (present_uses_cpu()) {
+    pal_expand(g_frame_px, g_frame_idx, GOT_W * GOT_H);
+    UpdateTexture(g_frame_tex, g_frame_px);
+  }
+  if (present_uses_gpu()) UpdateTexture(g_idx_tex, g_frame_idx);
+}
+
+static void upload_frame_textures(unsigned int pagebase) {
+  int layout = g_split_mode ? 1 : 0;
+  int all = g_pal_dirty;
+  int shown, i, r;
+
+  if (g_pal_dirty) {
+    if (present_uses_cpu()) pal_expand_set_palette(g_pal32);
+    if (present_uses_gpu()) UpdateTexture(g_pal_tex, g_pal32);
+  }
+
+  if (layout != g_tex_layout) {
+    mark_all_dirty();
+    g_tex_layout = layout;
+  }
+
+  if (!g_split_mode) {
+    int start_line = (int)pagebase / 80;
+    if (start_line < 0 || start_line % GOT_H != 0 || start_line / GOT_H > 2) {
+      /* Mid-scroll: the texture mixes two pages, so it matches no surface. */
+      upload_full_frame(pagebase);
+      mark_all_dirty();
+      g_pal_dirty = 0;
+      return;
+    }
+    shown = start_line / GOT_H;
+    /* Siblings may now differ from the texture wherever the shown page did. */
+    for (i = 0; i < 3; i++) {
+      if (i == shown) continue;
+      for (r = 0; r < DIRTY_ROWS_FULL; r++) g_dirty_full[i][r] |= g_dirty_full[shown][r];
+    }
+    upload_surf_dirty(surf_full_idx(shown), 0, all);
+  }
+  else {
+    int base_idx = nearest_play_page_idx(pagebase);
+    unsigned int bases[3] = { PAGE0, PAGE1, PAGE2 };
+    if (pagebase != bases[base_idx]) {
+      /* Split-screen scroll offset: shifted view of the page. */
+      upload_full_frame(pagebase);
+      mark_all_dirty();
+      g_pal_dirty = 0;
+      return;
+    }
+    shown = base_idx;
+    for (i = 0; i < 3; i++) {
+      if (i == shown) continue;
+      for (r = 0; r < DIRTY_ROWS_PLAY; r++) g_dirty_play[i][r] |= g_dirty_play[shown][r];
+    }
+    upload_surf_dirty(surf_play_idx(shown), 0, all);
+    upload_surf_dirty(surf_stat(), GOT_PLAY_H, all);
+  }
+  g_pal_dirty = 0;
+}
+
+/* Draw the uploaded frame into dst of the current target (backbuffer or a
+   render texture), through the palette shader for the GPU path. */
+static void draw_frame(Rectangle dst, int gpu) {
+  Rectangle src;
+  Vector2 origin;
+  src.x = 0.0f;
+  src.y = 0.0f;
+  src.width = (float)GOT_W;
+  src.height = (float)GOT_H;
+  origin.x = 0.0f;
+  origin.y = 0.0f;
+  if (gpu) {
+    BeginShaderMode(g_pal_shader);
+    SetShaderValueTexture(g_pal_shader, g_pal_shader_loc, g_pal_tex);
+    DrawTexturePro(g_idx_tex, src, dst, origin, 0.0f, WHITE);
+    EndShaderMode();
+  }
+  else {
+    DrawTexturePro(g_frame_tex, src, dst, origin, 0.0f, WHITE);
+  }
+}
+
+static void draw_frame_to(RenderTexture2D rt, int gpu) {
+  Rectangle dst;
+  dst.x = 0.0f;
+  dst.y = 0.0f;
+  dst.width = (float)GOT_W;
+  dst.height = (float)GOT_H;
+  BeginTextureMode(rt);
+  ClearBackground(BLACK);
+  draw_frame(dst, gpu);
+  EndTextureMode();
+}
+
+/* Read both renders back and compare them. The first few mismatching frames
+   are reported with their first differing pixel. */
+static void check_frame(void) {
+  Image cpu = LoadImageFromTexture(g_rt_check.texture);
+  Image gpu = LoadImageFromTexture(g_rt.texture);
+  const uint8_t* a = (const uint8_t*)cpu.data;
+  const uint8_t* b = (const uint8_t*)gpu.data;
+
+  g_check_frames++;
+  if (a && b && memcmp(a, b, (size_t)GOT_W * GOT_H * 4) != 0) {
+    if (g_check_bad < 8) {
+      int i = 0;
+      while (memcmp(a + i * 4, b + i * 4, 4) == 0) i++;
+      /* Render textures read back bottom-up. */
+      fprintf(stderr,
+              "Present check: frame %lu differs at (%d,%d): "
+              "cpu %02x%02x%02x gpu %02x%02x%02x\n",
+              g_check_frames - 1, i % GOT_W, GOT_H - 1 - i / GOT_W,
+              a[i * 4], a[i * 4 + 1], a[i * 4 + 2],
+              b[i * 4], b[i * 4 + 1], b[i * 4 + 2]);
+    }
+    g_check_bad++;
+  }
+  UnloadImage(cpu);
+  UnloadImage(gpu);
 }
 
 static void present_page(unsigned int pagebase) {
   int dx = 0, dy = 0, s = 1;
-  Rectangle src;
+  int gpu = present_uses_gpu();
+  int via_rt = present_needs_rt();
   Rectangle dst;
 
   if (!g_video_ready) got_platform_video_init();
 
-  got_platform_pump();
+  platform_pump(0);
 
-  upload_composited_rgba(pagebase);
+  if (g_headless) return;
 
-  BeginTextureMode(g_rt);
-  ClearBackground(BLACK);
-  DrawTexture(g_frame_tex, 0, 0, WHITE);
-  EndTextureMode();
+  upload_frame_textures(pagebase);
+
+  if (via_rt) {
+    draw_frame_to(g_rt, gpu);
+    if (g_present_mode == GOT_PRESENT_CHECK) {
+      draw_frame_to(g_rt_check, 0);
+      check_frame();
+    }
+  }
 
   BeginDrawing();
   ClearBackground(BLACK);
 
   compute_viewport(&dx, &dy, &s);
-  src.x = 0.0f;
-  src.y = 0.0f;
-  src.width = (float)g_rt.texture.width;
-  src.height = (float)-g_rt.texture.height; /* flip */
-
   dst.x = (float)dx;
   dst.y = (float)dy;
   dst.width = (float)(GOT_W * s);
   dst.height = (float)(GOT_H * s);
 
-  {
+  if (via_rt) {
+    Rectangle src;
     Vector2 origin;
+    src.x = 0.0f;
+    src.y = 0.0f;
+    src.width = (float)g_rt.texture.width;
+    src.height = (float)-g_rt.texture.height; /* flip */
     origin.x = 0.0f;
     origin.y = 0.0f;
     DrawTexturePro(g_rt.texture, src, dst, origin, 0.0f, WHITE);
+    g_present_via_rt++;
+  }
+  else {
+    draw_frame(dst, gpu);
+    g_present_direct++;
   }
   EndDrawing();
 }
@@ -1022,6 +1557,99 @@ void GOT_GFXCALL xfillrectangle(int StartX, int StartY, int EndX, int EndY,
       row[x] = (uint8_t)Color;
     }
   }
+  mark_dirty(s, StartX, StartY, EndX, EndY);
+}
+
+void got_platform_page_put(unsigned int pagebase, const uint8_t* pix) {
+  Surf8 s = resolve_surf(pagebase);
+  int w = s.w < 320 ? s.w : 320;
+  int h = s.h < 192 ? s.h : 192;
+  int y;
+  for (y = 0; y < h; y++) {
+    memcpy(s.pix + y * s.stride, pix + y * 320, (size_t)w);
+  }
+  mark_dirty(s, 0, 0, w, h);
+}
+
+/* Savestate layout: this header, then the pages of the current layout. */
+typedef struct {
+  int32_t split;
+  uint32_t last_show_pagebase;
+  uint8_t palloop, palcnt1, palcnt2, pad;
+  uint8_t pal6[256][3];
+  uint8_t pal8[256][3];
+  uint32_t pal32[256];
+} VideoState;
+
+long got_platform_video_state_size(void) {
+  return (long)(sizeof(VideoState) +
+                (g_split_mode ? sizeof(g_play_pages) + sizeof(g_stat_page) : sizeof(g_full_pages)));
+}
+
+void got_platform_video_save(void* dst) {
+  VideoState* v = (VideoState*)dst;
+  uint8_t* p = (uint8_t*)(v + 1);
+
+  memset(v, 0, sizeof(*v));
+  v->split = g_split_mode;
+  v->last_show_pagebase = g_last_show_pagebase;
+  v->palloop = g_palloop;
+  v->palcnt1 = g_palcnt1;
+  v->palcnt2 = g_palcnt2;
+  memcpy(v->pal6, g_pal6, sizeof(g_pal6));
+  memcpy(v->pal8, g_pal8, sizeof(g_pal8));
+  memcpy(v->pal32, g_pal32, sizeof(g_pal32));
+  if (g_split_mode) {
+    memcpy(p, g_play_pages, sizeof(g_play_pages));
+    memcpy(p + sizeof(g_play_pages), g_stat_page, sizeof(g_stat_page));
+  } else {
+    memcpy(p, g_full_pages, sizeof(g_full_pages));
+  }
+}
+
+void got_platform_video_restore(const void* src) {
+  const VideoState* v = (const VideoState*)src;
+  const uint8_t* p = (const uint8_t*)(v + 1);
+
+  if (v->split != g_split_mode) return;
+  g_last_show_pagebase = v->last_show_pagebase;
+  g_palloop = v->palloop;
+  g_palcnt1 = v->palcnt1;
+  g_palcnt2 = v->palcnt2;
+  memcpy(g_pal6, v->pal6, sizeof(g_pal6));
+  memcpy(g_pal8, v->pal8, sizeof(g_pal8));
+  memcpy(g_pal32, v->pal32, sizeof(g_pal32));
+  if (g_split_mode) {
+    memcpy(g_play_pages, p, sizeof(g_play_pages));
+    memcpy(g_stat_page, p + sizeof(g_play_pages), sizeof(g_stat_page));
+  } else {
+    memcpy(g_full_pages, p, sizeof(g_full_pages));
+  }
+  mark_all_dirty();
+  g_pal_dirty = 1;
+}
+
+int got_platform_rewind_held(void) {
+  if (g_headless || !g_video_ready) return 0;
+  if (IsKeyDown(KEY_F12)) return 1;
+  return got_platform_gamepad_is_available(0) && got_platform_gamepad_button_down(0, 15);
+}
+
+void got_platform_show_paced(void) {
+  static double next_s = 0.0;
+  double now;
+
+  present_page(g_last_show_pagebase);
+  now = got_clock_wall_s();
+  if (next_s < now - 0.1) next_s = now; /* first step, or after a stall */
+  next_s += 1.0 / 70.0;
+  while (got_clock_wall_s() < next_s) {
+#ifdef __EMSCRIPTEN__
+    emscripten_sleep(1);
+#else
+    got_clock_sleep_ms(1);
+#endif
+  }
 }
 
 void GOT_GFXCALL xpset(int X, int Y, unsigned int PageBase, int Color) {
@@ -1083,6 +1711,13 @@ void GOT_GFXCALL xput(int x,int y,unsigned int pagebase,char *buff) {
   /* DOS Mode X: offset = y*80 + x/4, truncating x to 4-pixel boundary. */
   x &= ~3;
   /* DOS semantics (src/utility/g_asm.asm xput_plane): treat 0 and 15 as transparent. */
+  if (wbytes == 4 && h == 16) {
+    const SpriteFrame* f = sprite_atlas_planar(planes);
+    if (f) {
+      draw_sprite_to_surf(dst, x, y, f);
+      return;
+    }
+  }
   draw_planar_masked_to_surf(dst, x, y, planes, wbytes, h);
 }
 
@@ -1096,7 +1731,15 @@ void GOT_GFXCALL xfput(int x,int y,unsigned int pagebase,char far *buff) {
   const uint8_t* planes = b + 6; /* fixed 16x16 tile format */
   /* DOS Mode X: offset = y*80 + x/4, truncating x to 4-pixel boundary. */
   x &= ~3;
-  /* DOS semantics (src/utility/g_asm.asm xfput_plane): treat 0 and 15 as transparent. */
+  /* DOS semantics (src/utility/g_asm.asm xfput_plane): treat 0 and 15 as transparent.
+     Drawn from the sprite atlas, converted the first time this tile is seen. */
+  {
+    const SpriteFrame* f = sprite_atlas_planar(planes);
+    if (f) {
+      draw_sprite_to_surf(dst, x, y, f);
+      return;
+    }
+  }
   draw_planar_masked_to_surf(dst, x, y, planes, 4, 16);
 }
 
@@ -1178,6 +1821,7 @@ void GOT_GFXCALL xcopys2d(int SourceStartX, int SourceStartY,
     memcpy(dst.pix + dy * dst.stride + DestStartX,
            (uint8_t*)SourcePtr + sy * SourceBitmapWidth + SourceStartX,
            (size_t)w);
+    mark_dirty(dst, DestStartX, dy, DestStartX + w, dy + 1);
   }
 }
 
@@ -1189,6 +1833,10 @@ void xddfast(int source_x,int source_y, int width, int height,
 }
 
 int xsetpal(unsigned char color, unsigned char R,unsigned char G,unsigned char B) {
+  if (g_pal6[color][0] == R && g_pal6[color][1] == G && g_pal6[color][2] == B) {
+    return 0;
+  }
+  g_pal_dirty = 1;
   g_pal6[color][0] = R;
   g_pal6[color][1] = G;
   g_pal6[color][2] = B;
@@ -1196,10 +1844,14 @@ int xsetpal(unsigned char color, unsigned char R,unsigned char G,unsigned char B
   g_pal8[color][1] = (uint8_t)((int)G * 255 / 63);
   g_pal8[color][2] = (uint8_t)((int)B * 255 / 63);
 
-  g_pal_rgba[color][0] = g_pal8[color][0];
-  g_pal_rgba[color][1] = g_pal8[color][1];
-  g_pal_rgba[color][2] = g_pal8[color][2];
-  g_pal_rgba[color][3] = 255;
+  {
+    uint8_t rgba[4];
+    rgba[0] = g_pal8[color][0];
+    rgba[1] = g_pal8[color][1];
+    rgba[2] = g_pal8[color][2];
+    rgba[3] = 255;
+    memcpy(&g_pal32[color], rgba, 4);
+  }
   return 0;
 }
 
@@ -1299,11 +1951,18 @@ static void draw_actor_one(ACTOR* a, Surf8 dst, int page_i) {
   mi = &a->pic[dir][fr];
   if (!mi->alignments[0]) return;
 
-  /* In the native build, our make_mask() implementation stores a pointer to
-     planar pixels in mask_ptr (repurposed) and we ignore the original mask. */
+  /* In the native build, make_mask() points the alignments at a sprite atlas
+     entry (image_ptr is its index) and we ignore the original mask. The
+     reference/ episode sources still hand out planar pixels in mask_ptr. */
   {
-    const uint8_t* planes = (const uint8_t*)mi->alignments[0]->mask_ptr;
-    draw_planar_masked_to_surf(dst, a->x, a->y, planes, 4, 16);
+    const ALIGNED_MASK_IMAGE* ami = mi->alignments[0];
+    const SpriteFrame* f = sprite_atlas_frame(ami->image_ptr);
+    if (f && (const void*)ami == (const void*)&f->mask) {
+      draw_sprite_to_surf(dst, a->x, a->y, f);
+    }
+    else {
+      draw_planar_masked_to_surf(dst, a->x, a->y, (const uint8_t*)ami->mask_ptr, 4, 16);
+    }
   }
 
   a->last_x[page_i] = a->x;
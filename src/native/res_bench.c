@@ -0,0 +1,86 @@
+#include "res_bench.h"
+#include "got_clock.h"
+#include "res_int.h"
+
+#include <stdio.h>
+#include <string.h>
+
+enum {
+  BENCH_QUERIES = RES_MAX_ENTRIES * 3
+};
+
+static char g_queries[BENCH_QUERIES][10];
+static int g_query_count;
+
+static void add_query(const char* name, int mode) {
+  char* q = g_queries[g_query_count++];
+  int i;
+  strncpy(q, name, 9);
+  q[9] = 0;
+  for (i = 0; q[i]; i++) {
+    if (mode == 1 && q[i] >= 'A' && q[i] <= 'Z') q[i] = (char)(q[i] + ('a' - 'A'));
+  }
+  /* Same length and prefix, last character changed: the worst kind of miss
+     for the scan, which has to compare against every entry. */
+  if (mode == 2 && i > 0) q[i - 1] = '~';
+}
+
+static double time_lookups(int (*find)(const char*), int rounds, long* sum) {
+  double t0 = got_clock_wall_s();
+  long s = 0;
+  int r, i;
+  for (r = 0; r < rounds; r++) {
+    for (i = 0; i < g_query_count; i++) s += find(g_queries[i]);
+  }
+  *sum = s;
+  return got_clock_wall_s() - t0;
+}
+
+int res_find_bench(int rounds) {
+  static char lzss_buff[65000];
+  const char* file = "GOTRES.DAT";
+  double t_scan, t_index, lookups;
+  long sum_scan, sum_index;
+  int i, ret, entries = 0, mismatches = 0;
+
+  if (rounds <= 0) rounds = 2000;
+
+  res_init(lzss_buff);
+  ret = res_open(file);
+  if (ret < 0) {
+    printf("res_find: %s: %s\n", file, res_error(ret));
+    return 1;
+  }
+  g_query_count = 0;
+  for (i = 0; i < RES_MAX_ENTRIES; i++) {
+    if (!res_header[i].name[0]) continue;
+    entries++;
+    add_query(res_header[i].name, 0);
+    add_query(res_header[i].name, 1);
+    add_query(res_header[i].name, 2);
+  }
+  for (i = 0; i < g_query_count; i++) {
+    int a = res_find_name_scan(g_queries[i]);
+    int b = res_find_name(g_queries[i]);
+    if (a != b) {
+      if (mismatches++ < 8) printf("res_find: \"%s\": scan %d, index %d\n", g_queries[i], a, b);
+    }
+  }
+  if (mismatches || g_query_count == 0) {
+    res_abort();
+    printf("res_find: %d mismatches over %d queries\n", mismatches, g_query_count);
+    return 1;
+  }
+
+  t_scan = time_lookups(res_find_name_scan, rounds, &sum_scan);
+  t_index = time_lookups(res_find_name, rounds, &sum_index);
+  res_abort();
+
+  lookups = (double)g_query_count * rounds / 1e6;
+  printf("res_find: %d entries, %d queries (stored, lower-case, miss) x %d rounds\n",
+         entries, g_query_count, rounds);
+  printf("  scan   %8.2f ms  %8.2f M lookups/s\n", t_scan * 1000.0, lookups / t_scan);
+  printf("  index  %8.2f ms  %8.2f M lookups/s  (%.1fx scan)\n", t_index * 1000.0,
+         lookups / t_index, t_scan / t_index);
+  return sum_scan == sum_index ? 0 : 1;
+}
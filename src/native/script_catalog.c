@@ -0,0 +1,202 @@
+#include "script_catalog.h"
+#include "res_man.h"
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+  CATALOG_AREAS = 3,
+  /* read_script_file() reads lines into 255-byte buffers. */
+  CATALOG_LINE_MAX = 255
+};
+
+typedef struct {
+  uint32_t offset, length, original_size; /* the SPEAKn entry it was built from */
+  char* text;
+  ScriptCatalog cat;
+  ScriptEntry* entries;
+  ScriptLabel* labels;
+  int nlabels;
+  int* hash; /* entry + 1, 0 = empty */
+  int hash_size;
+} CatalogArea;
+
+static CatalogArea g_areas[CATALOG_AREAS];
+
+/* get_line() (game/script.c): the line at *pos up to CR, LF dropped; *pos
+   moves past the CR. */
+static void next_line(const char* text, long size, long* pos, char* out) {
+  long p = *pos;
+  int n = 0;
+
+  while (p < size && text[p] != 13) {
+    if (text[p] != 10 && n < CATALOG_LINE_MAX - 1) out[n++] = text[p];
+    p++;
+  }
+  out[n] = 0;
+  *pos = p < size ? p + 1 : p;
+}
+
+/* Whether the line is `|` followed by ltoa(*index). */
+static int header_index(const char* line, long* index) {
+  char s[24];
+
+  if (line[0] != '|' || !(isdigit((unsigned char)line[1]) || line[1] == '-')) return 0;
+  *index = atol(line + 1);
+  snprintf(s, sizeof(s), "%ld", *index);
+  return strcmp(s, line + 1) == 0;
+}
+
+/* The label read_script_file() takes from this line, if any. */
+static int line_label(const char* line, char* name) {
+  char t[CATALOG_LINE_MAX];
+  int i, p = 0, quote = 0, len = (int)strlen(line);
+
+  if (len < 2) return 0;
+  for (i = 0; i < len; i++) {
+    char ch = line[i];
+    if (ch == 34) quote ^= 1;
+    else if ((ch == 39 || ch == 96) && !quote) break;
+    if (!quote) ch = (char)toupper((unsigned char)ch);
+    if (quote || (unsigned char)ch > 32) t[p++] = ch;
+  }
+  t[p] = 0;
+  if (p == 0 || p >= 10 || t[p - 1] != ':') return 0;
+  t[p - 1] = 0;
+  strcpy(name, t);
+  return 1;
+}
+
+static void free_area(CatalogArea* a) {
+  free(a->text);
+  free(a->entries);
+  free(a->labels);
+  free(a->hash);
+  memset(a, 0, sizeof(*a));
+}
+
+static int add_label(CatalogArea* a, int* cap, const char* name, int line) {
+  if (a->nlabels == *cap) {
+    ScriptLabel* l;
+    *cap = *cap ? *cap * 2 : 64;
+    l = (ScriptLabel*)realloc(a->labels, (size_t)*cap * sizeof(ScriptLabel));
+    if (!l) return 0;
+    a->labels = l;
+  }
+  strcpy(a->labels[a->nlabels].name, name);
+  a->labels[a->nlabels].line = line;
+  a->nlabels++;
+  return 1;
+}
+
+/* Range, lines and labels of the script whose body starts at e->start. */
+static int scan_body(CatalogArea* a, ScriptEntry* e, int* label_cap) {
+  char line[CATALOG_LINE_MAX], name[CATALOG_LINE_MAX];
+  long pos = e->start, at;
+
+  e->first_label = a->nlabels;
+  e->end = a->cat.size;
+  while (pos < a->cat.size) {
+    at = pos;
+    next_line(a->text, a->cat.size, &pos, line);
+    if (strcmp(line, "|STOP") == 0) {
+      e->end = at;
+      e->stopped = 1;
+      break;
+    }
+    if (line_label(line, name) && !add_label(a, label_cap, name, e->lines)) return 0;
+    e->lines++;
+  }
+  e->labels = a->nlabels - e->first_label;
+  return 1;
+}
+
+static int build_area(CatalogArea* a) {
+  char line[CATALOG_LINE_MAX];
+  long pos = 0, index;
+  int cap = 0, label_cap = 0, i;
+
+  while (pos < a->cat.size) {
+    ScriptEntry* e;
+    next_line(a->text, a->cat.size, &pos, line);
+    if (strcmp(line, "|EOF") == 0) break;
+    if (!header_index(line, &index)) continue;
+    if (a->cat.count == cap) {
+      cap = cap ? cap * 2 : 64;
+      e = (ScriptEntry*)realloc(a->entries, (size_t)cap * sizeof(ScriptEntry));
+      if (!e) return 0;
+      a->entries = e;
+    }
+    e = &a->entries[a->cat.count++];
+    memset(e, 0, sizeof(*e));
+    e->index = index;
+    e->start = pos;
+    if (!scan_body(a, e, &label_cap)) return 0;
+  }
+
+  a->hash_size = 64;
+  while (a->hash_size < a->cat.count * 2) a->hash_size *= 2;
+  a->hash = (int*)calloc((size_t)a->hash_size, sizeof(int));
+  if (!a->hash) return 0;
+  for (i = 0; i < a->cat.count; i++) {
+    uint32_t h = (uint32_t)a->entries[i].index * 2654435761u & (uint32_t)(a->hash_size - 1);
+    while (a->hash[h] && a->entries[a->hash[h] - 1].index != a->entries[i].index) {
+      h = (h + 1) & (uint32_t)(a->hash_size - 1);
+    }
+    if (!a->hash[h]) a->hash[h] = i + 1; /* the first |N wins */
+  }
+  a->cat.text = a->text;
+  a->cat.entries = a->entries;
+  a->cat.labels = a->labels;
+  return 1;
+}
+
+const ScriptCatalog* script_catalog_area(int area) {
+  CatalogArea* a;
+  char name[9];
+  int num;
+
+  if (area < 1 || area > CATALOG_AREAS) return NULL;
+  a = &g_areas[area - 1];
+  snprintf(name, sizeof(name), "SPEAK%d", area);
+  num = res_find_name(name);
+  if (num < 0) return NULL;
+  if (a->text && a->offset == res_header[num].offset && a->length == res_header[num].length &&
+      a->original_size == res_header[num].original_size) {
+    return &a->cat;
+  }
+
+  free_area(a);
+  a->text = (char*)res_falloc_read(name);
+  if (!a->text) return NULL;
+  a->offset = res_header[num].offset;
+  a->length = res_header[num].length;
+  a->original_size = res_header[num].original_size;
+  a->cat.size = (long)res_header[num].original_size;
+  if (!build_area(a)) {
+    free_area(a);
+    return NULL;
+  }
+  return &a->cat;
+}
+
+const ScriptEntry* script_catalog_find(const ScriptCatalog* cat, long index) {
+  const CatalogArea* a = NULL;
+  uint32_t h;
+  int i;
+
+  for (i = 0; i < CATALOG_AREAS; i++) {
+    if (cat == &g_areas[i].cat) a = &g_areas[i];
+  }
+  if (!a || !a->hash) return NULL;
+  h = (uint32_t)index * 2654435761u & (uint32_t)(a->hash_size - 1);
+  while (a->hash[h]) {
+    const ScriptEntry* e = &a->entries[a->hash[h] - 1];
+    if (e->index == index) return e;
+    h = (h + 1) & (uint32_t)(a->hash_size - 1);
+  }
+  return NULL;
+}
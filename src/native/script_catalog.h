@@ -0,0 +1,58 @@
+#ifndef SCRIPT_CATALOG_H
+#define SCRIPT_CATALOG_H
+
+/* SPEAK script catalogue.
+
+   SPEAK1..3 hold the dialog scripts of an area as text: a `|N` line opens
+   script N, `|STOP` closes it and `|EOF` ends the list. Finding a script
+   used to mean reading the whole entry and comparing lines until `|N`
+   turned up. The catalogue reads each SPEAKn once per archive and keeps
+   the text with an index over it: every script's byte range, line count
+   and line labels, and a hash from script number to entry.
+
+   Lookups follow read_script_file() (game/script.c): lines end at CR, LF
+   is dropped, a header matches only when it reads exactly `|` followed
+   by ltoa(N), the first match wins, headers after `|EOF` don't count,
+   and a script runs to the first `|STOP` line after its header. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  char name[9];
+  int line; /* line within the script, 0 = the one after the header */
+} ScriptLabel;
+
+typedef struct {
+  long index;      /* the N of `|N` */
+  long start;      /* first byte after the `|N` line */
+  long end;        /* first byte of the `|STOP` line, or the text size */
+  int stopped;     /* 0 when no `|STOP` follows (the script can't run) */
+  int lines;       /* lines in [start, end) */
+  int first_label; /* into ScriptCatalog::labels */
+  int labels;
+} ScriptEntry;
+
+typedef struct {
+  const char* text; /* the whole SPEAKn entry */
+  long size;
+  const ScriptEntry* entries; /* file order, up to `|EOF` */
+  int count;
+  const ScriptLabel* labels;
+} ScriptCatalog;
+
+/* Catalogue of SPEAK<area> (1..3) in the open archive, built the first
+   time it is asked for and again only when the entry changes. NULL if the
+   archive has no such entry or it can't be read. Stays valid after the
+   archive is closed, until the next call for the same area. */
+const ScriptCatalog* script_catalog_area(int area);
+
+/* The script read_script_file() runs for `index`, or NULL. */
+const ScriptEntry* script_catalog_find(const ScriptCatalog* cat, long index);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* SCRIPT_CATALOG_H */
@@ -0,0 +1,158 @@
+#include "sprite_atlas.h"
+#include "res_man.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+  ATLAS_BLOCK = 256,
+  ATLAS_BLOCKS = SPRITE_ATLAS_MAX_FRAMES / ATLAS_BLOCK,
+  /* Open-addressed index over the frames' pixels, at most half full. */
+  ATLAS_HASH_SIZE = SPRITE_ATLAS_MAX_FRAMES * 2,
+  /* ACTOR### layout: 16 actor frames, 4 shot frames, then ACTOR_NFO. */
+  ATLAS_ENTRY_FRAMES = 20,
+  ATLAS_ENTRY_BYTES = 5200,
+  /* Planar frames recently converted, direct-mapped by source address. */
+  ATLAS_PLANAR_CACHE = 512,
+  ATLAS_PLANAR_BYTES = SPRITE_W * SPRITE_H,
+  /* Planar tiles stop here, so they can't take the space actor frames
+     need; make_mask() has no planar fallback. */
+  ATLAS_PLANAR_LIMIT = SPRITE_ATLAS_MAX_FRAMES - SPRITE_ATLAS_ACTOR_RESERVE
+};
+
+typedef struct {
+  const uint8_t* src;
+  const SpriteFrame* frame;
+  uint8_t planes[ATLAS_PLANAR_BYTES]; /* what src held when converted */
+} PlanarEntry;
+
+static SpriteFrame* g_blocks[ATLAS_BLOCKS];
+static int g_frames;
+static uint16_t g_hash[ATLAS_HASH_SIZE]; /* frame index + 1, 0 = empty */
+static PlanarEntry g_planar[ATLAS_PLANAR_CACHE];
+
+static uint32_t frame_hash(const uint8_t* p) {
+  uint32_t h = 2166136261u;
+  int i;
+  for (i = 0; i < SPRITE_W * SPRITE_H; i++) {
+    h = (h ^ p[i]) * 16777619u;
+  }
+  return h;
+}
+
+static SpriteFrame* frame_at(int index) {
+  return &g_blocks[index / ATLAS_BLOCK][index % ATLAS_BLOCK];
+}
+
+static void build_runs(SpriteFrame* f) {
+  int x, y, x0 = SPRITE_W, y0 = SPRITE_H, x1 = 0, y1 = 0;
+
+  for (y = 0; y < SPRITE_H; y++) {
+    const uint8_t* row = f->pix[y];
+    int n = 0;
+    x = 0;
+    while (x < SPRITE_W) {
+      int start;
+      while (x < SPRITE_W && (row[x] == 0 || row[x] == 15)) x++;
+      if (x == SPRITE_W) break;
+      start = x;
+      while (x < SPRITE_W && row[x] != 0 && row[x] != 15) x++;
+      f->run[y][n].x = (uint8_t)start;
+      f->run[y][n].len = (uint8_t)(x - start);
+      n++;
+      if (start < x0) x0 = start;
+      if (x > x1) x1 = x;
+    }
+    f->runs[y] = (uint8_t)n;
+    if (n) {
+      if (y < y0) y0 = y;
+      y1 = y + 1;
+    }
+  }
+  if (x1 <= x0) x0 = x1 = y0 = y1 = 0;
+  f->x0 = (uint8_t)x0;
+  f->y0 = (uint8_t)y0;
+  f->x1 = (uint8_t)x1;
+  f->y1 = (uint8_t)y1;
+}
+
+/* The entry for these pixels, added if new and fewer than `limit` frames
+   are held. */
+static SpriteFrame* atlas_add(const uint8_t* pixels, int limit) {
+  uint32_t i = frame_hash(pixels) & (ATLAS_HASH_SIZE - 1);
+  SpriteFrame* f;
+
+  while (g_hash[i]) {
+    f = frame_at(g_hash[i] - 1);
+    if (memcmp(f->pix, pixels, sizeof(f->pix)) == 0) return f;
+    i = (i + 1) & (ATLAS_HASH_SIZE - 1);
+  }
+  if (g_frames >= limit) return NULL;
+  if (!g_blocks[g_frames / ATLAS_BLOCK]) {
+    g_blocks[g_frames / ATLAS_BLOCK] =
+        (SpriteFrame*)calloc(ATLAS_BLOCK, sizeof(SpriteFrame));
+    if (!g_blocks[g_frames / ATLAS_BLOCK]) return NULL;
+  }
+  f = frame_at(g_frames);
+  memcpy(f->pix, pixels, sizeof(f->pix));
+  build_runs(f);
+  f->mask.image_width = SPRITE_W;
+  f->mask.image_ptr = (unsigned int)g_frames;
+  f->mask.mask_ptr = (char*)f->pix;
+  g_frames++;
+  g_hash[i] = (uint16_t)g_frames;
+  return f;
+}
+
+SpriteFrame* sprite_atlas_add(const uint8_t* pixels) {
+  return atlas_add(pixels, SPRITE_ATLAS_MAX_FRAMES);
+}
+
+const SpriteFrame* sprite_atlas_frame(unsigned int index) {
+  if (index >= (unsigned int)g_frames) return NULL;
+  return frame_at((int)index);
+}
+
+const SpriteFrame* sprite_atlas_planar(const uint8_t* planes) {
+  PlanarEntry* e = &g_planar[((uintptr_t)planes * 2654435761u >> 8) % ATLAS_PLANAR_CACHE];
+  uint8_t pix[SPRITE_H][SPRITE_W];
+  int p, row, bx;
+
+  if (e->src == planes && e->frame &&
+      memcmp(e->planes, planes, ATLAS_PLANAR_BYTES) == 0) {
+    return e->frame;
+  }
+  /* 4 planes of 4x16 bytes; plane p holds columns p, p+4, p+8, p+12. */
+  for (p = 0; p < 4; p++) {
+    for (row = 0; row < SPRITE_H; row++) {
+      for (bx = 0; bx < SPRITE_W / 4; bx++) {
+        pix[row][bx * 4 + p] = planes[p * (SPRITE_W / 4) * SPRITE_H + row * (SPRITE_W / 4) + bx];
+      }
+    }
+  }
+  e->src = planes;
+  e->frame = atlas_add(&pix[0][0], ATLAS_PLANAR_LIMIT);
+  memcpy(e->planes, planes, ATLAS_PLANAR_BYTES);
+  return e->frame;
+}
+
+int sprite_atlas_build(void) {
+  static char buf[ATLAS_ENTRY_BYTES];
+  int i, f;
+
+  for (i = 0; i < RES_MAX_ENTRIES; i++) {
+    if (!res_header[i].length || strncmp(res_header[i].name, "ACTOR", 5) != 0) continue;
+    if (res_header[i].original_size != ATLAS_ENTRY_BYTES) continue;
+    if (res_read(res_header[i].name, buf) != ATLAS_ENTRY_BYTES) continue;
+    for (f = 0; f < ATLAS_ENTRY_FRAMES; f++) {
+      sprite_atlas_add((const uint8_t*)buf + f * SPRITE_W * SPRITE_H);
+    }
+  }
+  return g_frames;
+}
+
+void sprite_atlas_stats(int* out_frames, long* out_bytes) {
+  int blocks = (g_frames + ATLAS_BLOCK - 1) / ATLAS_BLOCK;
+  *out_frames = g_frames;
+  *out_bytes = (long)blocks * ATLAS_BLOCK * (long)sizeof(SpriteFrame) + (long)sizeof(g_hash);
+}
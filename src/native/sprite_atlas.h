@@ -0,0 +1,84 @@
+#ifndef SPRITE_ATLAS_H
+#define SPRITE_ATLAS_H
+
+#include <stdint.h>
+
+/* Sprite atlas.
+
+   Every 16x16 frame the game masks for an actor (make_mask() in
+   game/image.c) is kept once, in chunky order, with the runs of opaque
+   pixels on each row precomputed (0 and 15 are transparent, as in the
+   original asm). sprite_atlas_build() adds every frame of every ACTOR###
+   entry at startup; anything else is added the first time it is masked.
+   16x16 xfput()/xput() tiles arrive in Mode X planar form and are
+   converted the first time they are drawn (sprite_atlas_planar()).
+
+   Identical frames share one entry, so reloading actors on every screen
+   allocates nothing and the atlas is bounded by the distinct frames the
+   game draws (at most SPRITE_ATLAS_MAX_FRAMES). Frames live in fixed
+   blocks that never move; an entry's index and address stay valid for
+   the whole run. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+  SPRITE_W = 16,
+  SPRITE_H = 16,
+  /* Opaque runs a 16-pixel row can hold at most. */
+  SPRITE_ROW_RUNS = SPRITE_W / 2,
+  SPRITE_ATLAS_MAX_FRAMES = 8192,
+  /* Frames only sprite_atlas_add() may fill; planar tiles leave them. */
+  SPRITE_ATLAS_ACTOR_RESERVE = 1024
+};
+
+typedef struct {
+  uint8_t x;
+  uint8_t len;
+} SpriteRun;
+
+/* Same layout as ALIGNED_MASK_IMAGE (game_define.h) in the native build. */
+typedef struct {
+  int image_width;
+  unsigned int image_ptr;
+  char* mask_ptr;
+} SpriteMaskImage;
+
+typedef struct {
+  /* What make_mask() hands out in MASK_IMAGE.alignments[]: image_ptr is
+     this frame's index, mask_ptr its chunky pixels. */
+  SpriteMaskImage mask;
+  uint8_t pix[SPRITE_H][SPRITE_W];
+  uint8_t runs[SPRITE_H];
+  SpriteRun run[SPRITE_H][SPRITE_ROW_RUNS];
+  /* Bounding box of the opaque pixels, [x0,x1) x [y0,y1); empty when
+     x0 == x1. */
+  uint8_t x0, y0, x1, y1;
+} SpriteFrame;
+
+/* Adds all 20 frames (16 actor, 4 shot) of every ACTOR### entry in the
+   open archive. Returns the number of distinct frames held. */
+int sprite_atlas_build(void);
+
+/* The entry for this 16x16 chunky frame, added if new. NULL only when the
+   atlas is full (SPRITE_ATLAS_MAX_FRAMES distinct frames). */
+SpriteFrame* sprite_atlas_add(const uint8_t* pixels);
+
+const SpriteFrame* sprite_atlas_frame(unsigned int index);
+
+/* The entry for a 16x16 Mode X planar frame (4 planes of 4x16 bytes, the
+   xfput() layout), converted and added the first time it is seen. Repeat
+   calls with the same, unchanged buffer skip the conversion. NULL when a
+   new frame would go into SPRITE_ATLAS_ACTOR_RESERVE; callers then draw
+   from the planes. */
+const SpriteFrame* sprite_atlas_planar(const uint8_t* planes);
+
+/* Distinct frames held, and the bytes allocated for them. */
+void sprite_atlas_stats(int* out_frames, long* out_bytes);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* SPRITE_ATLAS_H */
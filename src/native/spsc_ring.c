@@ -0,0 +1,63 @@
+#include "spsc_ring.h"
+
+#include <string.h>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <windows.h>
+#endif
+
+/* GCC/Clang (and Emscripten) get real acquire/release atomics. MSVC's C mode
+   has no usable <stdatomic.h>, so use interlocked ops there; they are full
+   barriers, which is stronger than needed but correct on x86 and ARM64. */
+#if defined(__GNUC__) || defined(__clang__)
+#define RING_LOAD_ACQ(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define RING_STORE_REL(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define RING_LOAD_SC(p) __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define RING_STORE_SC(p, v) __atomic_store_n((p), (v), __ATOMIC_SEQ_CST)
+#elif defined(_MSC_VER)
+#define RING_LOAD_ACQ(p) ((uint32_t)InterlockedOr((volatile LONG*)(p), 0))
+#define RING_STORE_REL(p, v) InterlockedExchange((volatile LONG*)(p), (LONG)(v))
+#define RING_LOAD_SC(p) RING_LOAD_ACQ(p)
+#define RING_STORE_SC(p, v) RING_STORE_REL(p, v)
+#else
+#error "spsc_ring.c needs GCC/Clang __atomic builtins or MSVC interlocked ops"
+#endif
+
+void spsc_init(SpscRing* r, void* slots, uint32_t item_size, uint32_t capacity) {
+  memset(r, 0, sizeof(*r));
+  r->slots = (uint8_t*)slots;
+  r->item_size = item_size;
+  r->mask = capacity - 1u;
+}
+
+int spsc_push(SpscRing* r, const void* item) {
+  uint32_t tail = r->tail; /* only we write it */
+  uint32_t head = RING_LOAD_ACQ(&r->head);
+  if (tail - head > r->mask) return 0;
+  memcpy(r->slots + (size_t)(tail & r->mask) * r->item_size, item, r->item_size);
+  RING_STORE_REL(&r->tail, tail + 1u);
+  return 1;
+}
+
+int spsc_pop(SpscRing* r, void* item) {
+  uint32_t head = r->head; /* only we write it */
+  uint32_t tail = RING_LOAD_ACQ(&r->tail);
+  if (head == tail) return 0;
+  memcpy(item, r->slots + (size_t)(head & r->mask) * r->item_size, r->item_size);
+  RING_STORE_REL(&r->head, head + 1u);
+  return 1;
+}
+
+uint32_t spsc_count(const SpscRing* r) {
+  uint32_t tail = RING_LOAD_ACQ(&r->tail);
+  uint32_t head = RING_LOAD_ACQ(&r->head);
+  return tail - head;
+}
+
+uint32_t spsc_atomic_load(const volatile uint32_t* p) {
+  return RING_LOAD_SC(p);
+}
+
+void spsc_atomic_store(volatile uint32_t* p, uint32_t v) {
+  RING_STORE_SC(p, v);
+}
@@ -0,0 +1,53 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdint.h>
+
+/* Wait-free single-producer/single-consumer ring of fixed-size items.
+
+   Used to hand work from the game thread to the audio callback thread (and
+   back) without locks: the producer only writes `tail`, the consumer only
+   writes `head`, and each side publishes its index with a release store after
+   copying the item. Push/pop never block; push fails when the ring is full.
+
+   The slot storage is supplied by the caller; capacity must be a power of
+   two. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  uint8_t* slots;
+  uint32_t item_size;
+  uint32_t mask;
+  /* Free-running counters; index = counter & mask. Kept on separate cache
+     lines so the two threads don't false-share. */
+  uint8_t pad0[64];
+  volatile uint32_t head; /* next item to pop; consumer-owned */
+  uint8_t pad1[64];
+  volatile uint32_t tail; /* next slot to fill; producer-owned */
+  uint8_t pad2[64];
+} SpscRing;
+
+void spsc_init(SpscRing* r, void* slots, uint32_t item_size, uint32_t capacity);
+
+/* Producer side. Returns 0 (and copies nothing) when the ring is full. */
+int spsc_push(SpscRing* r, const void* item);
+
+/* Consumer side. Returns 0 when the ring is empty. */
+int spsc_pop(SpscRing* r, void* item);
+
+/* Items currently queued (exact from either side for its own view). */
+uint32_t spsc_count(const SpscRing* r);
+
+/* Sequentially consistent load/store of a shared flag or counter, for the
+   small amount of state that sits next to a ring. */
+uint32_t spsc_atomic_load(const volatile uint32_t* p);
+void spsc_atomic_store(volatile uint32_t* p, uint32_t v);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* SPSC_RING_H */
@@ -0,0 +1,144 @@
+#include "tile_cache.h"
+#include "sprite_atlas.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+  TILE_COLS = TILE_LAYER_W / 16,
+  TILE_ROWS = TILE_LAYER_H / 16,
+  TILE_CELLS = TILE_COLS * TILE_ROWS,
+  /* bg_pics: 6-byte header, then 16x16 planar pixels. */
+  TILE_BYTES = 262
+};
+
+typedef struct {
+  const char* tiles;
+  int bg_color;
+  int fill_empty;
+  uint32_t hash;
+  char icons[TILE_CELLS];
+  unsigned long used;
+  uint8_t* pix; /* NULL until the slot is first filled */
+} TileLayer;
+
+static TileLayer g_layers[TILE_CACHE_LAYERS];
+static unsigned long g_clock;
+static TILE_CACHE_STATS g_stats;
+
+static uint32_t icons_hash(const char* icons) {
+  uint32_t h = 2166136261u;
+  int i;
+  for (i = 0; i < TILE_CELLS; i++) {
+    h = (h ^ (uint8_t)icons[i]) * 16777619u;
+  }
+  return h;
+}
+
+/* Masked 16x16 tile at cell (cx, cy); 0 and 15 are transparent. */
+static void put_tile(uint8_t* pix, int cx, int cy, const char* tile) {
+  const uint8_t* planes = (const uint8_t*)tile + 6;
+  const SpriteFrame* f = sprite_atlas_planar(planes);
+  uint8_t* d = pix + cy * 16 * TILE_LAYER_W + cx * 16;
+  int row, i;
+
+  if (f) {
+    for (row = f->y0; row < f->y1; row++) {
+      const SpriteRun* r = f->run[row];
+      for (i = 0; i < f->runs[row]; i++) {
+        memcpy(d + row * TILE_LAYER_W + r[i].x, &f->pix[row][r[i].x], r[i].len);
+      }
+    }
+    return;
+  }
+  /* Atlas full: straight from the planes. */
+  for (i = 0; i < 256; i++) {
+    uint8_t v = planes[i];
+    int p = i / 64, y = (i % 64) / 4, x = (i % 4) * 4 + p;
+    if (v != 0 && v != 15) d[y * TILE_LAYER_W + x] = v;
+  }
+}
+
+/* One cell exactly as build_screen() leaves it. */
+static void compose_cell(const TileLayer* l, int cx, int cy, int icon) {
+  uint8_t* d = l->pix + cy * 16 * TILE_LAYER_W + cx * 16;
+  int row;
+
+  for (row = 0; row < 16; row++) {
+    memset(d + row * TILE_LAYER_W, 0, 16);
+  }
+  if (!l->fill_empty && icon == 0) return;
+  put_tile(l->pix, cx, cy, l->tiles + l->bg_color * TILE_BYTES);
+  put_tile(l->pix, cx, cy, l->tiles + icon * TILE_BYTES);
+}
+
+static TileLayer* find_layer(const char* tiles, int bg_color, const char* icons,
+                             int fill_empty, uint32_t hash) {
+  int i;
+  for (i = 0; i < TILE_CACHE_LAYERS; i++) {
+    TileLayer* l = &g_layers[i];
+    if (l->used && l->hash == hash && l->tiles == tiles && l->bg_color == bg_color &&
+        l->fill_empty == fill_empty && memcmp(l->icons, icons, TILE_CELLS) == 0) {
+      return l;
+    }
+  }
+  return NULL;
+}
+
+const uint8_t* tile_cache_layer(const char* tiles, int bg_color, const char* icons,
+                                int fill_empty) {
+  uint32_t hash = icons_hash(icons);
+  TileLayer* l = find_layer(tiles, bg_color, icons, fill_empty, hash);
+  int i;
+
+  if (l) {
+    l->used = ++g_clock;
+    g_stats.hits++;
+    return l->pix;
+  }
+  g_stats.misses++;
+
+  l = &g_layers[0];
+  for (i = 1; i < TILE_CACHE_LAYERS; i++) {
+    if (g_layers[i].used < l->used) l = &g_layers[i];
+  }
+  if (!l->pix) {
+    l->pix = (uint8_t*)malloc(TILE_LAYER_W * TILE_LAYER_H);
+    if (!l->pix) return NULL;
+  }
+  l->tiles = tiles;
+  l->bg_color = bg_color;
+  l->fill_empty = fill_empty;
+  l->hash = hash;
+  memcpy(l->icons, icons, TILE_CELLS);
+  for (i = 0; i < TILE_CELLS; i++) {
+    compose_cell(l, i % TILE_COLS, i / TILE_COLS, (uint8_t)icons[i]);
+  }
+  l->used = ++g_clock;
+  return l->pix;
+}
+
+void tile_cache_set_cell(const char* tiles, int bg_color, const char* icons,
+                         int fill_empty, int x, int y, int tile) {
+  TileLayer* l;
+
+  if ((unsigned)x >= TILE_COLS || (unsigned)y >= TILE_ROWS) return;
+  l = find_layer(tiles, bg_color, icons, fill_empty, icons_hash(icons));
+  if (!l) return;
+  l->icons[y * TILE_COLS + x] = (char)tile;
+  l->hash = icons_hash(l->icons);
+  compose_cell(l, x, y, tile & 0xff);
+  g_stats.patched++;
+}
+
+void tile_cache_flush(void) {
+  int i;
+  for (i = 0; i < TILE_CACHE_LAYERS; i++) {
+    g_layers[i].used = 0;
+    g_layers[i].tiles = NULL;
+  }
+}
+
+void tile_cache_stats(TILE_CACHE_STATS* out) {
+  *out = g_stats;
+}
@@ -0,0 +1,53 @@
+#ifndef TILE_CACHE_H
+#define TILE_CACHE_H
+
+#include <stdint.h>
+
+/* Composed screen tile layers.
+
+   build_screen() (game/back.c) draws the 20x12 icon grid of a screen as the
+   bg_color tile with the icon over it, two xfput() calls per cell. Here the
+   result is kept as a 320x192 chunky image, keyed by the tile set, the
+   background colour and the icon grid (hashed, then compared in full), so
+   a screen that was built before is one copy into the page. place_tile()
+   and erase_door() patch the one cell they change instead of dropping the
+   layer. Layers are replaced least recently used first. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+  TILE_LAYER_W = 320,
+  TILE_LAYER_H = 192,
+  TILE_CACHE_LAYERS = 16
+};
+
+typedef struct {
+  long hits;
+  long misses;
+  long patched; /* cells redrawn in place */
+} TILE_CACHE_STATS;
+
+/* The layer build_screen() would draw for these icons (LEVEL::icon, 12x20)
+   over tile set `tiles` (bg_pics, 262 bytes a tile). Cells with icon 0 are
+   left at 0 unless fill_empty is set (episode 2 fills every cell). NULL if
+   no memory could be had. */
+const uint8_t* tile_cache_layer(const char* tiles, int bg_color, const char* icons,
+                                int fill_empty);
+
+/* Cell (x, y) of the cached layer for `icons` now shows `tile`. Call before
+   icons[y][x] itself is changed. */
+void tile_cache_set_cell(const char* tiles, int bg_color, const char* icons,
+                         int fill_empty, int x, int y, int tile);
+
+/* Forgets every layer (the tile set is about to be freed). */
+void tile_cache_flush(void);
+
+void tile_cache_stats(TILE_CACHE_STATS* out);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* TILE_CACHE_H */
@@ -1,113 +1,407 @@
+#include <stdlib.h>
+#include <string.h>
+#include <mem.h>
+
+#include "modern.h"
+
+#ifndef modern
+#include <alloc.h>
+#endif
+
 #include "lzss.h"
 
-int lzss_read_uint16le(const char far* src, long* size, unsigned int* value);
+long lzss_decode(const char far* src, long in_size, char far* dst, long out_size) {
+  const unsigned char far* in;
+  const unsigned char far* in_end;
+  unsigned char far* out;
+  unsigned char far* to;
+  const unsigned char far* from;
+  unsigned int flags, control, count, offset, span, left;
+  long written;
+  int b;
+
+  in = (const unsigned char far*)src;
+  in_end = in + in_size;
+  out = (unsigned char far*)dst;
+  written = 0;
 
-int lzss_read_uint16le(const char far* src, long* size, unsigned int* value) {
-  if (*size < 2) {
-    return 0;
+  // Bulk loop: while a whole group (flag byte plus eight back-references)
+  // is left in the input and eight maximal matches plus 8 bytes of slack
+  // fit in the output, nothing needs a bounds check. Matches are copied
+  // 8 bytes at a time and may scribble up to 7 bytes past their end,
+  // which the following output overwrites.
+  while (in_end - in >= 17 && out_size - written >= 8 * 17 + 8) {
+    flags = *in++;
+    if (flags == 0xFF) {
+      _fmemcpy(out + written, in, 8);
+      in += 8;
+      written += 8;
+      continue;
+    }
+    for (b = 0; b < 8; b++, flags >>= 1) {
+      if (flags & 1) {
+        out[written++] = *in++;
+        continue;
+      }
+      control = (unsigned int)in[0] | ((unsigned int)in[1] << 8);
+      in += 2;
+      count = (control >> 12) + 2;
+      offset = control & 0xFFF;
+      if (offset == 0 || (long)offset > written) {
+        return written;
+      }
+      to = out + written;
+      from = to - offset;
+      written += count;
+      if (offset >= 8) {
+        // Every 8-byte chunk reads only bytes already final.
+        for (left = 0; left < count; left += 8) {
+          _fmemcpy(to + left, from + left, 8);
+        }
+      }
+      else if (offset == 1) {
+        _fmemset(to, *from, 8);
+        _fmemset(to + 8, *from, 8);
+        if (count > 16) {
+          to[16] = *from;
+        }
+      }
+      else {
+        // Short period: replicate it, doubling the span each copy.
+        span = offset;
+        while (count > span) {
+          _fmemcpy(to, from, span);
+          to += span;
+          count -= span;
+          span <<= 1;
+        }
+        _fmemcpy(to, from, count);
+      }
+    }
   }
 
-  // Cast to unsigned to avoid sign-extension when `char` is signed.
-  *value = (unsigned int)(unsigned char)src[0]
-    | ((unsigned int)(unsigned char)src[1] << 8);
-  *size -= 2;
+  // Tail: everything checked, nothing written past out_size.
+  while (written < out_size) {
+    if (in >= in_end) {
+      break;
+    }
+    flags = *in++;
+
+    // A flag byte of 0xFF means eight literals in a row.
+    if (flags == 0xFF && in_end - in >= 8 && out_size - written >= 8) {
+      _fmemcpy(out + written, in, 8);
+      in += 8;
+      written += 8;
+      continue;
+    }
+
+    for (b = 0; b < 8 && written < out_size; b++, flags >>= 1) {
+      if (flags & 1) {
+        if (in >= in_end) {
+          return written;
+        }
+        out[written++] = *in++;
+        continue;
+      }
+
+      // Back-reference: UINT16LE, upper four bits + 2 = count,
+      // lower 12 bits = how far back into the output to copy from.
+      if (in_end - in < 2) {
+        return written;
+      }
+      control = (unsigned int)in[0] | ((unsigned int)in[1] << 8);
+      in += 2;
+      count = (control >> 12) + 2;
+      offset = control & 0xFFF;
+      if (offset == 0 || (long)offset > written) {
+        return written;
+      }
+      if ((long)count > out_size - written) {
+        count = (unsigned int)(out_size - written);
+      }
 
-  return 1;
+      from = out + written - offset;
+      if (offset >= count) {
+        _fmemcpy(out + written, from, count);
+      }
+      else if (offset == 1) {
+        _fmemset(out + written, *from, count);
+      }
+      else {
+        // The copy overlaps its own output, repeating the last `offset`
+        // bytes. Each pass copies everything from `from` so far, doubling
+        // the span, so no single copy overlaps.
+        to = out + written;
+        left = count;
+        span = offset;
+        while (left > span) {
+          _fmemcpy(to, from, span);
+          to += span;
+          left -= span;
+          span <<= 1;
+        }
+        _fmemcpy(to, from, left);
+      }
+      written += count;
+    }
+  }
+  return written;
 }
 
 long lzss_decompress(char far* src, char far* dst, long size) {
-  char data, x;
-  unsigned int decompressed_size, ignored, written, control
-  , upper_four_bits, count, offset;
-  long remaining, i, b, j;
-
-  remaining = size;
-  written = 0;
-  i = 0;
+  unsigned int decompressed_size;
 
   // Each file's data begins with a UINT16LE value holding the
-  // decompressed size, in bytes,
-  if (!lzss_read_uint16le(src, &remaining, &decompressed_size)) {
+  // decompressed size, in bytes, followed by another UINT16LE value
+  // of unknown purpose which should be ignored (it is always 0x0001).
+  if (size < 4) {
+    return 0;
+  }
+  decompressed_size = (unsigned int)(unsigned char)src[0]
+    | ((unsigned int)(unsigned char)src[1] << 8);
+
+  lzss_decode(src + 4, size - 4, dst, (long)decompressed_size);
+  return (long)decompressed_size;
+}
+
+// Match finder for the compressors: hash chains over the 2-byte prefix
+// every match (2..17 bytes, up to 0xFFF back) starts with. head[] holds the
+// newest position per hash, prev[] links each position in the window to
+// the previous one with the same hash, so candidates come nearest first.
+#define LZSS_WINDOW    0xFFF
+#define LZSS_MAX_LEN   17
+#define LZSS_HASH_SIZE 4096
+#define LZSS_NIL       0xFFFFu
+
+typedef struct {
+  unsigned int head[LZSS_HASH_SIZE];
+  unsigned int prev[LZSS_WINDOW + 1];
+} LZSS_CHAINS;
+
+static unsigned int lzss_hash(const unsigned char far* p) {
+  return (((unsigned int)p[0] << 4) ^ p[1]) & (LZSS_HASH_SIZE - 1);
+}
+
+static void lzss_chains_init(LZSS_CHAINS far* c) {
+  int i;
+
+  for (i = 0; i < LZSS_HASH_SIZE; i++) {
+    c->head[i] = LZSS_NIL;
+  }
+}
+
+static void lzss_chains_insert(LZSS_CHAINS far* c, const unsigned char far* src,
+                               long pos, long size) {
+  unsigned int h;
+
+  if (pos + 1 >= size) {
+    return;
+  }
+  h = lzss_hash(src + pos);
+  c->prev[(unsigned int)pos & LZSS_WINDOW] = c->head[h];
+  c->head[h] = (unsigned int)pos;
+}
+
+// Longest match at pos, nearest first on ties (what the original backward
+// scan picked). Returns its length, 0 or 1 meaning no usable match.
+static unsigned int lzss_chains_find(const LZSS_CHAINS far* c,
+                                     const unsigned char far* src, long pos,
+                                     long size, unsigned int* best_off) {
+  unsigned int best_len, len, limit, cand;
+
+  best_len = 0;
+  *best_off = 0;
+  if (pos + 1 >= size) {
     return 0;
   }
-  src += 2;
+  limit = LZSS_MAX_LEN;
+  if (size - pos < LZSS_MAX_LEN) {
+    limit = (unsigned int)(size - pos);
+  }
+  cand = c->head[lzss_hash(src + pos)];
+  while (cand != LZSS_NIL && pos - (long)cand <= LZSS_WINDOW) {
+    len = 0;
+    while (len < limit && src[cand + len] == src[pos + len]) {
+      len++;
+    }
+    if (len > best_len) {
+      best_len = len;
+      *best_off = (unsigned int)(pos - (long)cand);
+      if (best_len == limit) {
+        break;
+      }
+    }
+    cand = c->prev[cand & LZSS_WINDOW];
+  }
+  return best_len;
+}
+
+// Appends one token: a literal when len < 2, else a back-reference.
+static void lzss_put(unsigned char far** out, unsigned char far** flags_ptr,
+                     int* bit, const unsigned char far* src, long pos,
+                     unsigned int len, unsigned int off) {
+  unsigned int control;
+
+  if (*bit == 8) {
+    *flags_ptr = (*out)++;
+    **flags_ptr = 0;
+    *bit = 0;
+  }
+  if (len >= 2) {
+    // Back-reference: control word packs (len-2) into upper 4 bits and offset into lower 12 bits.
+    control = ((len - 2) << 12) | (off & 0x0FFF);
+    *(*out)++ = (unsigned char)(control & 0xFF);
+    *(*out)++ = (unsigned char)((control >> 8) & 0xFF);
+  }
+  else {
+    **flags_ptr |= (unsigned char)(1U << *bit);
+    *(*out)++ = src[pos];
+  }
+  (*bit)++;
+}
 
-  // followed by another UINT16LE value of unknown purpose
-  // which should be ignored (the value is always 0x0001.)
-  if (!lzss_read_uint16le(src, &remaining, &ignored)) {
+static unsigned char far* lzss_put_header(long origsize, char far* dst) {
+  unsigned char far* out;
+
+  // Header: decompressed size (uint16le), then a constant 0x0001.
+  out = (unsigned char far*)dst;
+  out[0] = (unsigned char)(origsize & 0xFF);
+  out[1] = (unsigned char)((origsize >> 8) & 0xFF);
+  out[2] = 0x01;
+  out[3] = 0x00;
+  return out + 4;
+}
+
+long lzss_compress(long origsize, char far* src, char far* dst) {
+  const unsigned char far* in;
+  unsigned char far* out;
+  unsigned char far* flags_ptr;
+  LZSS_CHAINS far* chains;
+  unsigned int len, off;
+  long pos;
+  int bit;
+
+  if (origsize < 0 || origsize > 0xFFFF) {
     return 0;
   }
-  src += 2;
+  chains = (LZSS_CHAINS far*)farmalloc(sizeof(LZSS_CHAINS));
+  if (!chains) {
+    return lzss_compress_scan(origsize, src, dst);
+  }
+  lzss_chains_init(chains);
 
-  // The rest of the data decompresses as follows:
+  in = (const unsigned char far*)src;
+  out = lzss_put_header(origsize, dst);
+  flags_ptr = out;
+  bit = 8;
 
-  // If the amount of data decompressed matches the target size, finish. Otherwise:
-  while (written < decompressed_size) {
-    if (remaining <= 0) {
-      break;
+  // Greedy: the longest match at each position, or a literal. Output is
+  // byte-identical to lzss_compress_scan().
+  pos = 0;
+  while (pos < origsize) {
+    len = lzss_chains_find(chains, in, pos, origsize, &off);
+    if (len < 2) {
+      len = 1;
     }
+    lzss_put(&out, &flags_ptr, &bit, in, pos, len, off);
+    while (len--) {
+      lzss_chains_insert(chains, in, pos++, origsize);
+    }
+  }
 
-    // Read a byte from the input data
-    data = *src;
-    src += 1;
-    remaining -= 1;
+  farfree(chains);
+  return (long)(out - (unsigned char far*)dst);
+}
 
+#ifdef modern
+long lzss_compress_best(long origsize, char far* src, char far* dst) {
+  const unsigned char far* in;
+  unsigned char far* out;
+  unsigned char far* flags_ptr;
+  LZSS_CHAINS* chains;
+  unsigned char* max_len;
+  unsigned short* max_off;
+  unsigned char* step;
+  uint32_t* cost;
+  unsigned int len, off, l;
+  long pos, n;
+  int bit;
 
-    // For each bit in the previous byte, from the least significant to the most:
-    for (b = 0; b < 8; b += 1) {
-      if (written >= decompressed_size) {
-        break;
+  if (origsize < 0 || origsize > 0xFFFF) {
+    return 0;
+  }
+  n = origsize;
+  chains = (LZSS_CHAINS*)malloc(sizeof(LZSS_CHAINS));
+  max_len = (unsigned char*)malloc((size_t)n + 1);
+  max_off = (unsigned short*)malloc(((size_t)n + 1) * sizeof(unsigned short));
+  step = (unsigned char*)malloc((size_t)n + 1);
+  cost = (uint32_t*)malloc(((size_t)n + 1) * sizeof(uint32_t));
+  if (!chains || !max_len || !max_off || !step || !cost) {
+    free(chains);
+    free(max_len);
+    free(max_off);
+    free(step);
+    free(cost);
+    return lzss_compress(origsize, src, dst);
+  }
+  lzss_chains_init(chains);
+  in = (const unsigned char far*)src;
+
+  // Longest match at every position. A match can be cut to any shorter
+  // length at the same offset, and all offsets cost the same.
+  for (pos = 0; pos < n; pos++) {
+    // Inside a long match the same offset usually still gives a full
+    // length one; any offset will do here, so skip the chain walk then.
+    len = 0;
+    if (pos > 0 && max_len[pos - 1] == LZSS_MAX_LEN && n - pos >= LZSS_MAX_LEN) {
+      off = max_off[pos - 1];
+      while (len < LZSS_MAX_LEN && in[pos - off + len] == in[pos + len]) {
+        len++;
       }
+    }
+    if (len < LZSS_MAX_LEN) {
+      len = lzss_chains_find(chains, in, pos, n, &off);
+    }
+    max_len[pos] = (unsigned char)len;
+    max_off[pos] = (unsigned short)off;
+    lzss_chains_insert(chains, in, pos, n);
+  }
 
-      // If the bit is 1, copy a byte unchanged from the input data to the output
-      if (((data >> b) & 0x1)) {
-        if (remaining <= 0) {
-          return 0;
-        }
-        dst[written++] = *src;
-        src += 1;
-        remaining -= 1;
-      }
-      // Otherwise the bit is zero:
-      else {
-        // Read a UINT16LE
-        if (!lzss_read_uint16le(src, &remaining, &control)) {
-          return 0;
-        }
-        src += 2;
-
-        i += 2;
-
-        // Add two to the upper (most significant) four bits, and
-        // treat this value as the LZSS "count"
-        upper_four_bits = control >> 12;
-        count = upper_four_bits + 2;
-
-        // Take the lower 12 bits and treat the value as the LZSS "offset"
-        offset = control & 0xFFF;
-
-        // Look back "offset" bytes into the newly decompressed data
-
-        /**
-         * Copy "count" bytes from here to the end of the newly decompressed data.
-         * Take note that as each byte is copied to its destination, that new byte
-         * may later become a source byte in this same copy operation. For example,
-         * if "offset" is 1 (i.e. look back one byte) and the counter is 15, then
-         * the last byte will be copied 17 times (15 + 2 = 17). This is because as
-         * each byte is copied, it becomes the source byte for the next copy cycle.
-         */
-        for (j = 0; j < count; j += 1) {
-          x = dst[written - offset];
-          dst[written++] = x;
-        }
+  // Cheapest encoding of each suffix, in bits: a literal is 1 flag bit + 8,
+  // a back-reference 1 + 16.
+  cost[n] = 0;
+  for (pos = n - 1; pos >= 0; pos--) {
+    cost[pos] = cost[pos + 1] + 9;
+    step[pos] = 1;
+    for (l = 2; l <= max_len[pos]; l++) {
+      if (cost[pos + l] + 17 < cost[pos]) {
+        cost[pos] = cost[pos + l] + 17;
+        step[pos] = (unsigned char)l;
       }
     }
   }
 
-  return (long)decompressed_size;
+  out = lzss_put_header(origsize, dst);
+  flags_ptr = out;
+  bit = 8;
+  for (pos = 0; pos < n; pos += step[pos]) {
+    lzss_put(&out, &flags_ptr, &bit, in, pos, step[pos], max_off[pos]);
+  }
+
+  free(chains);
+  free(max_len);
+  free(max_off);
+  free(step);
+  free(cost);
+  return (long)(out - (unsigned char far*)dst);
+}
+#else
+long lzss_compress_best(long origsize, char far* src, char far* dst) {
+  return lzss_compress(origsize, src, dst);
 }
+#endif
 
-long lzss_compress(long origsize, char far* src, char far* dst) {
+long lzss_compress_scan(long origsize, char far* src, char far* dst) {
   long pos;
   unsigned char* out;
   unsigned char* flags_ptr;
@@ -3,7 +3,41 @@
 
 #include "modern.h"
 
+/**
+ * Decodes a raw LZSS stream (no size header), as stored in GOTRES.DAT
+ * entries after their 4-byte header and in GRAPHICS.GOT chunks. Stops at
+ * @ref out_size bytes, at the end of the input, or at a back-reference
+ * that points before the start of the output.
+ * @returns The number of bytes written to @ref dst.
+ */
+long lzss_decode(const char far* src, long in_size, char far* dst, long out_size);
+
+/**
+ * Decodes a GOTRES.DAT entry: a UINT16LE decompressed size, a UINT16LE
+ * 0x0001, then the LZSS stream.
+ * @returns The decompressed size from the header, or 0 if @ref len is too
+ * short to hold one.
+ */
 long lzss_decompress(char far* src, char far* dst, long len);
+/**
+ * Compresses @ref origsize (at most 0xFFFF) bytes into a GOTRES.DAT entry,
+ * taking the longest match at each position. Matches are found through
+ * hash chains; the output is byte-identical to @ref lzss_compress_scan.
+ * @returns The compressed size, header included.
+ */
 long lzss_compress(long origsize, char far* src, char far* dst);
 
+/**
+ * As @ref lzss_compress, but picks the sequence of literals and matches
+ * with the fewest bits (optimal parse). Native builds only; on DOS, and
+ * if memory runs out, this is @ref lzss_compress.
+ */
+long lzss_compress_best(long origsize, char far* src, char far* dst);
+
+/**
+ * The original brute-force compressor, searching the whole window backward
+ * from every position. Used when the hash chains can't be allocated.
+ */
+long lzss_compress_scan(long origsize, char far* src, char far* dst);
+
 #endif
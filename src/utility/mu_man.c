@@ -3,29 +3,11 @@
 #include "adlib.h"
 #include <alloc.h>
 
-typedef struct {
-  // Number of ticks to wait *after* the data has been sent
-  unsigned char delay;
-  // OPL register to write to
-  unsigned char opl_register;
-  // Value to write
-  unsigned char opl_value;
-} fm_music_note;
-
-typedef struct {
-  // The original memory buffer including the header information
-  char far*          origin;
-  // The offset to start playing when looping
-  fm_music_note far* loop_offset;
-  // The total length of the music
-  long               length;
-  // The pointer to the initial note memory buffer
-  fm_music_note far* notes;
-} fm_music;
+#ifdef modern
+#include "adlib_native.h"
+#endif
 
 void      MU_StopInternal(void);
-fm_music* MU_ConvertOpl(char far* buffer, long length);
-void      MU_FreeFMMusic(fm_music* m);
 
 long               MU_TicksElapsed = 0;
 unsigned char      MU_IsPlaying = 0;
@@ -33,6 +15,8 @@ fm_music*          MU_FMMusic = 0;
 fm_music_note far* MU_FMNote = 0;
 long               MU_DataLeft = 0;
 long               MU_NextEventTime = 0;
+// Native: a pre-rendered copy plays through the mixer; MU_Service() idles.
+unsigned char      MU_Streaming = 0;
 
 void MU_MusicOff(void) {
   MU_StopInternal();
@@ -41,6 +25,9 @@ void MU_MusicOff(void) {
 void MU_MusicOn(void) {
   if (MU_FMMusic) {
     MU_IsPlaying = 1;
+#ifdef modern
+    got_adlib_music_pause(0);
+#endif
   }
 }
 
@@ -69,11 +56,18 @@ void MU_StartMusic(char far* buffer, long length) {
   MU_DataLeft = m->length;
   MU_NextEventTime = 0;
   MU_TicksElapsed = 0;
+#ifdef modern
+  MU_Streaming = (unsigned char)got_adlib_music_start(buffer, length);
+  if (MU_Streaming) {
+    // Key off whatever the emulator was playing; it stays silent meanwhile.
+    SB_AL_ResetChannels();
+  }
+#endif
   MU_IsPlaying = 1;
 }
 
 void MU_Service(void) {
-  if (!MU_IsPlaying) {
+  if (!MU_IsPlaying || MU_Streaming) {
     return;
   }
 
@@ -132,7 +126,36 @@ void MU_FreeFMMusic(fm_music* m) {
   free(m);
 }
 
+void MU_GetPosition(mu_position* out) {
+  out->ticks_elapsed = MU_TicksElapsed;
+  out->next_event_time = MU_NextEventTime;
+  out->data_left = MU_DataLeft;
+  out->note = MU_FMMusic ? (long)(MU_FMNote - MU_FMMusic->notes) : 0;
+  out->playing = MU_IsPlaying;
+}
+
+void MU_SetPosition(const mu_position* pos) {
+  if (!MU_FMMusic) {
+    return;
+  }
+  if (pos->note < 0 || pos->note * (long)sizeof(fm_music_note) > MU_FMMusic->length) {
+    return;
+  }
+  if (pos->playing && !MU_IsPlaying) {
+    MU_MusicOn();
+  } else if (!pos->playing && MU_IsPlaying) {
+    MU_MusicOff();
+  }
+  MU_FMNote = MU_FMMusic->notes + pos->note;
+  MU_DataLeft = pos->data_left;
+  MU_NextEventTime = pos->next_event_time;
+  MU_TicksElapsed = pos->ticks_elapsed;
+}
+
 void MU_StopInternal(void) {
   MU_IsPlaying = 0;
   SB_AL_ResetChannels();
+#ifdef modern
+  got_adlib_music_pause(1);
+#endif
 }
@@ -3,6 +3,35 @@
 
 #include "modern.h"
 
+typedef struct {
+  // Number of ticks to wait *after* the data has been sent
+  unsigned char delay;
+  // OPL register to write to
+  unsigned char opl_register;
+  // Value to write
+  unsigned char opl_value;
+} fm_music_note;
+
+typedef struct {
+  // The original memory buffer including the header information
+  char far*          origin;
+  // The offset to start playing when looping
+  fm_music_note far* loop_offset;
+  // The total length of the music
+  long               length;
+  // The pointer to the initial note memory buffer
+  fm_music_note far* notes;
+} fm_music;
+
+typedef struct {
+  long          ticks_elapsed;
+  long          next_event_time;
+  long          data_left;
+  // Notes from the start of the song, so the position outlives the parse
+  long          note;
+  unsigned char playing;
+} mu_position;
+
 /**
  * Turns off any music that is playing.
  */
@@ -33,4 +62,33 @@ void MU_StartMusic(char far* buffer, long length);
  */
 void MU_Service(void);
 
+/**
+ * Parses a song resource into its note stream and loop point.
+ * The returned structure points into @ref buffer, which must outlive it.
+ * @param buffer A memory buffer to music data.
+ * @param length The total length of the memory buffer.
+ * @returns The parsed song, or 0 when out of memory. Release it with
+ * @ref MU_FreeFMMusic.
+ */
+fm_music* MU_ConvertOpl(char far* buffer, long length);
+
+/**
+ * Releases a song returned by @ref MU_ConvertOpl (but not its buffer).
+ * @param m The song to release.
+ */
+void MU_FreeFMMusic(fm_music* m);
+
+/**
+ * Reads the sequencer's position in the current song (savestates).
+ * @param out Where to store the position.
+ */
+void MU_GetPosition(mu_position* out);
+
+/**
+ * Moves the sequencer to a position read from the song playing now,
+ * turning music on or off to match. Does nothing without a song.
+ * @param pos A position from @ref MU_GetPosition.
+ */
+void MU_SetPosition(const mu_position* pos);
+
 #endif
@@ -28,8 +28,10 @@ void print_options(void) {
   printf("                     (P)ack\r\n");
   printf("                     (R)ename res_oldname res_newname\r\n");
   printf("                     (B)reakout path\r\n");
+  printf("                     (M)ake list_file|path [encode_flag [threads]]\r\n");
   printf("                     (L)ist\r\n\r\n");
 
+  printf("encode_flag: 0 = stored, 1 = LZSS, 2 = smallest LZSS\r\n\r\n");
   printf("EXAMPLE: RES RESFILE.000 A GRAPHICS.DAT GRPDATA 1\r\n\r\n");
 }
 
@@ -40,6 +42,7 @@ int main(int argc, char *argv[]) {
   char fname[128];
   char path[256];
   FILE* fp;
+  FILE* lp;
   char ch;
   char fpath[21];
 
@@ -221,6 +224,26 @@ int main(int argc, char *argv[]) {
     }
     exit(0);
   }
+  else if (!strcmpi(argv[2], "M")) {
+    if (argc < 4) {
+      print_options();
+      if (fb) {
+        farfree(fb);
+      }
+      exit(0);
+    }
+    printf("\r\nBuilding Resource File: %s from %s...", filename, argv[3]);
+    ret = res_build(filename, argv[3], argc > 4 ? atoi(argv[4]) : 1,
+                    argc > 5 ? atoi(argv[5]) : 0);
+    printf("%s\r\n\r\n", res_error(ret));
+    if (ret >= 0) {
+      res_close();
+    }
+    if (fb) {
+      farfree(fb);
+    }
+    exit(0);
+  }
   else if (!strcmpi(argv[2], "B")) {
     printf("\r\nOpening Resource File: %s...", filename);
     ret = res_open(filename);
@@ -248,6 +271,9 @@ int main(int argc, char *argv[]) {
       }
       exit(0);
     }
+    strcpy(path, fpath);
+    strcat(path, "REPACK.LST");
+    lp = fopen(path, "wt");
     strcpy(path, "DEL ");
     strcat(path, fpath);
     strcat(path, filename);
@@ -286,10 +312,18 @@ int main(int argc, char *argv[]) {
           strcat(path, " 0\n");
         }
         fputs(path, fp);
+        if (lp) {
+          // Same entries for RES filename M REPACK.LST.
+          fprintf(lp, "%s%s.DAT %s %d\n", fpath, fname, fname,
+                  res_header[i].key ? 1 : 0);
+        }
       }
     }
     printf("\r\n\r\nDone.\r\n\r\n");
     fclose(fp);
+    if (lp) {
+      fclose(lp);
+    }
     res_close();
     if (fb) {
       farfree(fb);
@@ -1,12 +1,16 @@
 #include <stdio.h>
 
 #include "res_man.h"
+#include "res_int.h"
 
 int res_abort(void) {
   if (!res_active) {
     return RES_NOT_ACTIVE;
   }
 
+  res_prefetch_flush();
+  res_map_close();
+  res_cache_flush();
   if (res_fp) {
     if (!fclose(res_fp)) {
       return 1;
@@ -9,6 +9,7 @@
 #endif
 
 #include "res_man.h"
+#include "res_int.h"
 
 int res_add_file(const char* fname, const char* name, int encode_flag) {
   int  num, ret;
@@ -54,7 +55,9 @@ int res_add_file(const char* fname, const char* name, int encode_flag) {
     res_header[num].key = 0;
   }
 
+  res_index_remove(num);
   strncpy(res_header[num].name, name, 9);
+  res_index_add(num);
 
   total = 0;
   if (!encode_flag) {
@@ -98,7 +101,7 @@ int res_add_file(const char* fname, const char* name, int encode_flag) {
       }
       return RES_CANT_READ;
     }
-    size = res_encode(fb, size);
+    size = (encode_flag == 2) ? res_encode_best(fb, size) : res_encode(fb, size);
     total = size;
     fbp = res_lzss_buff;
     while (1) {
@@ -0,0 +1,500 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "modern.h"
+
+#ifdef modern
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#else
+#include <alloc.h>
+#include <dir.h>
+#endif
+
+#include "res_man.h"
+#include "res_int.h"
+#include "lzss.h"
+
+// Bytes the entry table takes at the top of an archive (what res_wentries()
+// writes).
+#ifdef modern
+#define RES_TABLE_SIZE (23l * RES_MAX_ENTRIES)
+#define RES_BUILD_MAX_THREADS 64
+#else
+#define RES_TABLE_SIZE ((long)RES_MAX_ENTRIES * sizeof(RES_HEADER))
+#endif
+
+typedef struct {
+  char src[128];
+  char name[9];
+  int  encode_flag;
+
+  char far* data;     // what goes into the archive
+  long size;          // source bytes
+  long length;        // archive bytes
+  int  err;
+} RES_BUILD_ITEM;
+
+static RES_BUILD_ITEM far* build_items;
+static int build_count;
+
+static int build_add(const char* src, const char* name, int encode_flag) {
+  RES_BUILD_ITEM far* it;
+  int i;
+
+  if (!*name) {
+    return RES_CANT_FIND;
+  }
+  for (i = 0; i < build_count; i++) {
+    if (!strcmpi(build_items[i].name, name)) {
+      return RES_ALREADY_EXISTS;
+    }
+  }
+  if (build_count >= RES_MAX_ENTRIES) {
+    return RES_FULL;
+  }
+  it = &build_items[build_count++];
+  memset(it, 0, sizeof(RES_BUILD_ITEM));
+  strncpy(it->src, src, sizeof(it->src) - 1);
+  strncpy(it->name, name, 8);
+  it->encode_flag = encode_flag;
+  return 1;
+}
+
+// One "src_filename res_name [encode_flag]" per line; blank lines and lines
+// starting with ';' or '#' are skipped.
+static int build_read_list(FILE* fp, int encode_flag) {
+  char line[256];
+  char src[128];
+  char name[16];
+  int  flag, n, ret;
+
+  while (fgets(line, sizeof(line), fp)) {
+    n = sscanf(line, "%127s %15s %d", src, name, &flag);
+    if (n < 1 || src[0] == ';' || src[0] == '#') {
+      continue;
+    }
+    if (n < 2) {
+      printf("\r\nBad line: %s", line);
+      return RES_CANT_READ;
+    }
+    name[8] = 0;
+    ret = build_add(src, name, n == 3 ? flag : encode_flag);
+    if (ret < 0) {
+      printf("\r\n%s: ", name);
+      return ret;
+    }
+  }
+  return 1;
+}
+
+// Every *.DAT file in dir (what the B command extracts), named after the
+// file without its extension.
+static int build_dat_name(const char* file, char* name) {
+  const char* dot = strrchr(file, '.');
+  int n;
+
+  if (!dot || strcmpi(dot, ".DAT")) {
+    return 0;
+  }
+  n = (int)(dot - file);
+  if (n < 1 || n > 8) {
+    return 0;
+  }
+  memcpy(name, file, n);
+  name[n] = 0;
+  strupr(name);
+  return 1;
+}
+
+static int build_add_file(const char* dir, const char* file, int encode_flag) {
+  char src[128];
+  char name[16];
+  int  ret;
+
+  if (!build_dat_name(file, name)) {
+    return 1;
+  }
+  strcpy(src, dir);
+#ifdef modern
+  strcat(src, "/");
+#else
+  strcat(src, "\\");
+#endif
+  strncat(src, file, sizeof(src) - strlen(src) - 1);
+  ret = build_add(src, name, encode_flag);
+  if (ret < 0) {
+    printf("\r\n%s: ", name);
+  }
+  return ret;
+}
+
+static int build_read_dir(const char* dir, int encode_flag) {
+  int ret = 1;
+#ifdef modern
+#ifdef _WIN32
+  WIN32_FIND_DATAA fd;
+  HANDLE h;
+  char pattern[140];
+
+  strcpy(pattern, dir);
+  strcat(pattern, "\\*.DAT");
+  h = FindFirstFileA(pattern, &fd);
+  if (h == INVALID_HANDLE_VALUE) {
+    return RES_CANT_OPEN_SRC;
+  }
+  do {
+    if (!(fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+      ret = build_add_file(dir, fd.cFileName, encode_flag);
+    }
+  } while (ret >= 0 && FindNextFileA(h, &fd));
+  FindClose(h);
+#else
+  DIR* d;
+  struct dirent* e;
+
+  d = opendir(dir);
+  if (!d) {
+    return RES_CANT_OPEN_SRC;
+  }
+  while (ret >= 0 && (e = readdir(d)) != NULL) {
+    ret = build_add_file(dir, e->d_name, encode_flag);
+  }
+  closedir(d);
+#endif
+#else
+  struct ffblk fb;
+  char pattern[140];
+  int  done;
+
+  strcpy(pattern, dir);
+  strcat(pattern, "\\*.DAT");
+  done = findfirst(pattern, &fb, 0);
+  while (ret >= 0 && !done) {
+    ret = build_add_file(dir, fb.ff_name, encode_flag);
+    done = findnext(&fb);
+  }
+#endif
+  return ret;
+}
+
+#ifdef modern
+static int build_by_name(const void* a, const void* b) {
+  return strcmpi(((const RES_BUILD_ITEM*)a)->name, ((const RES_BUILD_ITEM*)b)->name);
+}
+#endif
+
+// Whole-buffer file I/O. DOS stdio only takes near buffers, so go a byte at
+// a time there like res_add_file() does.
+static int build_fread(char far* buff, long len, FILE* fp) {
+#ifdef modern
+  return (long)fread(buff, 1, len, fp) == len;
+#else
+  int ch;
+
+  while (len--) {
+    if ((ch = fgetc(fp)) == EOF) {
+      return 0;
+    }
+    *buff++ = (char)ch;
+  }
+  return 1;
+#endif
+}
+
+static int build_fwrite(const char far* buff, long len, FILE* fp) {
+#ifdef modern
+  return (long)fwrite(buff, 1, len, fp) == len;
+#else
+  while (len--) {
+    if (fputc(*buff++, fp) == EOF) {
+      return 0;
+    }
+  }
+  return 1;
+#endif
+}
+
+// Reads one source file and encodes it into it->data. Touches nothing but
+// the item, so items can be built on any thread.
+static void build_item(RES_BUILD_ITEM far* it) {
+  FILE* fp;
+  char far* src;
+  long size;
+
+  fp = fopen(it->src, "rb");
+  if (!fp) {
+    it->err = RES_CANT_OPEN_SRC;
+    return;
+  }
+  fseek(fp, 0l, SEEK_END);
+  size = ftell(fp);
+  fseek(fp, 0l, SEEK_SET);
+  if (size <= 0) {
+    fclose(fp);
+    it->err = RES_CANT_READ;
+    return;
+  }
+#ifdef modern
+  if (it->encode_flag && size > 0xFFFFl) {
+#else
+  if (size > 0xFFFFl) {
+#endif
+    fclose(fp);
+    it->err = RES_SRC_TOO_LARGE;
+    return;
+  }
+  src = farmalloc(size);
+  if (!src) {
+    fclose(fp);
+    it->err = RES_OUT_OF_MEMORY;
+    return;
+  }
+  if (!build_fread(src, size, fp)) {
+    fclose(fp);
+    farfree(src);
+    it->err = RES_CANT_READ;
+    return;
+  }
+  fclose(fp);
+  it->size = size;
+
+  if (!it->encode_flag) {
+    it->data = src;
+    it->length = size;
+    return;
+  }
+  // Worst case: every token a literal, plus a flag byte per 8 and the header.
+  it->data = farmalloc(4 + size + (size + 7) / 8);
+  if (!it->data) {
+    farfree(src);
+    it->err = RES_OUT_OF_MEMORY;
+    return;
+  }
+  if (it->encode_flag == 2) {
+    it->length = lzss_compress_best(size, src, it->data);
+  }
+  else {
+    it->length = lzss_compress(size, src, it->data);
+  }
+  farfree(src);
+  if (it->length <= 0) {
+    it->err = RES_SRC_TOO_LARGE;
+  }
+}
+
+#ifdef modern
+static volatile long build_next;
+
+static long build_take(void) {
+#ifdef _WIN32
+  return InterlockedIncrement(&build_next) - 1;
+#else
+  return __atomic_fetch_add(&build_next, 1, __ATOMIC_RELAXED);
+#endif
+}
+
+#ifdef _WIN32
+static DWORD WINAPI build_worker(LPVOID arg)
+#else
+static void* build_worker(void* arg)
+#endif
+{
+  long i;
+
+  (void)arg;
+  while ((i = build_take()) < build_count) {
+    build_item(&build_items[i]);
+  }
+  return 0;
+}
+
+static int build_cpu_count(void) {
+#ifdef _WIN32
+  SYSTEM_INFO si;
+  GetSystemInfo(&si);
+  return (int)si.dwNumberOfProcessors;
+#else
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (int)n : 1;
+#endif
+}
+
+static void build_all(int threads) {
+  int i;
+
+  if (threads <= 0) {
+    threads = build_cpu_count();
+  }
+  if (threads > RES_BUILD_MAX_THREADS) {
+    threads = RES_BUILD_MAX_THREADS;
+  }
+  if (threads > build_count) {
+    threads = build_count;
+  }
+  build_next = 0;
+  if (threads > 1) {
+#ifdef _WIN32
+    HANDLE th[RES_BUILD_MAX_THREADS];
+    for (i = 0; i < threads; i++) {
+      th[i] = CreateThread(NULL, 0, build_worker, NULL, 0, NULL);
+    }
+    for (i = 0; i < threads; i++) {
+      if (th[i]) {
+        WaitForSingleObject(th[i], INFINITE);
+        CloseHandle(th[i]);
+      }
+    }
+#else
+    pthread_t th[RES_BUILD_MAX_THREADS];
+    int ok[RES_BUILD_MAX_THREADS];
+    for (i = 0; i < threads; i++) {
+      ok[i] = pthread_create(&th[i], NULL, build_worker, NULL) == 0;
+    }
+    for (i = 0; i < threads; i++) {
+      if (ok[i]) {
+        pthread_join(th[i], NULL);
+      }
+    }
+#endif
+  }
+  // Anything a thread that failed to start would have taken.
+  build_worker(NULL);
+}
+#endif
+
+static void build_free(void) {
+  int i;
+
+  for (i = 0; i < build_count; i++) {
+    if (build_items[i].data) {
+      farfree(build_items[i].data);
+    }
+  }
+  farfree(build_items);
+  build_items = 0;
+  build_count = 0;
+}
+
+static int build_write(RES_BUILD_ITEM far* it, int num, FILE* fp, long* offset) {
+  char name[16];
+
+  if (it->err < 0) {
+    printf("\r\n%s: ", it->src);
+    return it->err;
+  }
+  if (!build_fwrite(it->data, it->length, fp)) {
+    return RES_CANT_WRITE;
+  }
+  farfree(it->data);
+  it->data = 0;
+
+  strcpy(res_header[num].name, it->name);
+  res_header[num].offset = *offset;
+  res_header[num].length = it->length;
+  res_header[num].original_size = it->size;
+  res_header[num].key = it->encode_flag ? 1 : 0;
+  *offset += it->length;
+
+  strcpy(name, it->name);
+  while (strlen(name) < 8) {
+    strcat(name, " ");
+  }
+  printf("\r\nAdding: %s  Size:%.6ld -> %.6ld", name, it->size, it->length);
+  return 1;
+}
+
+int res_build(const char* filename, const char* source, int encode_flag, int threads) {
+  FILE* fp;
+  long offset;
+  int  num, ret, from_dir;
+
+  if (!res_active) {
+    return RES_NOT_ACTIVE;
+  }
+  if (res_fp) {
+    return RES_ALREADY_OPEN;
+  }
+
+  build_items = (RES_BUILD_ITEM far*)farmalloc(RES_MAX_ENTRIES * sizeof(RES_BUILD_ITEM));
+  if (!build_items) {
+    return RES_OUT_OF_MEMORY;
+  }
+  build_count = 0;
+  ret = 1;
+  fp = fopen(source, "rt");
+  if (fp) {
+    // A directory opens too on some systems; it just reads as empty.
+    ret = build_read_list(fp, encode_flag);
+    fclose(fp);
+  }
+  from_dir = ret >= 0 && build_count == 0;
+  if (from_dir) {
+    ret = build_read_dir(source, encode_flag);
+  }
+  if (ret >= 0 && build_count == 0) {
+    ret = RES_CANT_FIND;
+  }
+  if (ret < 0) {
+    build_free();
+    return ret;
+  }
+#ifdef modern
+  if (from_dir) {
+    qsort(build_items, build_count, sizeof(RES_BUILD_ITEM), build_by_name);
+  }
+#endif
+
+  fp = fopen("res_@@@@.tmp", "wb");
+  if (!fp) {
+    build_free();
+    return RES_CANT_OPEN_DST;
+  }
+  memset(&res_header, 0, RES_MAX_ENTRIES * sizeof(RES_HEADER));
+
+  // Everything is encoded up front (in parallel where there are threads),
+  // then laid out back to back behind the entry table. DOS has neither
+  // threads nor the memory, so it encodes and writes one entry at a time.
+  offset = RES_TABLE_SIZE;
+  ret = fseek(fp, offset, SEEK_SET) ? RES_CANT_SEEK : 1;
+#ifdef modern
+  build_all(threads);
+#else
+  (void)threads;
+#endif
+  for (num = 0; ret >= 0 && num < build_count; num++) {
+#ifndef modern
+    build_item(&build_items[num]);
+#endif
+    ret = build_write(&build_items[num], num, fp, &offset);
+  }
+  build_free();
+
+  if (ret >= 0) {
+    res_fp = fp;
+    if (fseek(fp, 0l, SEEK_SET)) {
+      ret = RES_CANT_SEEK;
+    }
+    else if (!res_wentries()) {
+      ret = RES_CANT_WRITE;
+    }
+    res_fp = 0;
+  }
+  if (fclose(fp) && ret >= 0) {
+    ret = RES_CANT_WRITE;
+  }
+  if (ret < 0) {
+    unlink("res_@@@@.tmp");
+    return ret;
+  }
+  unlink(filename);
+  rename("res_@@@@.tmp", filename);
+  printf("\r\n");
+  return res_open(filename);
+}
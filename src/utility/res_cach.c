@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mem.h>
+
+#include "modern.h"
+
+#ifndef modern
+#include <alloc.h>
+#endif
+
+#include "res_man.h"
+#include "res_int.h"
+
+/*
+ * Decoded payloads, most recently used first. A node is keyed by its entry
+ * number and remembers the offset/length it was decoded from, so a slot that
+ * has since been deleted, rewritten or packed simply stops matching.
+ */
+typedef struct RES_CACHE_NODE {
+  struct RES_CACHE_NODE far* prev;
+  struct RES_CACHE_NODE far* next;
+  int num;
+  uint32_t offset;
+  uint32_t length;
+  long size;
+} RES_CACHE_NODE;
+
+#ifdef modern
+#define RES_CACHE_DEFAULT_BUDGET (1024l * 1024l)
+#else
+#define RES_CACHE_DEFAULT_BUDGET 0l
+#endif
+
+static RES_CACHE_NODE far* res_cache_slot[RES_MAX_ENTRIES];
+static RES_CACHE_NODE far* res_cache_head;
+static RES_CACHE_NODE far* res_cache_tail;
+static RES_CACHE_STATS res_cache_counts = { 0, 0, 0, 0, 0, RES_CACHE_DEFAULT_BUDGET };
+
+static void res_cache_unlink(RES_CACHE_NODE far* node) {
+  if (node->prev) {
+    node->prev->next = node->next;
+  }
+  else {
+    res_cache_head = node->next;
+  }
+  if (node->next) {
+    node->next->prev = node->prev;
+  }
+  else {
+    res_cache_tail = node->prev;
+  }
+  node->prev = 0;
+  node->next = 0;
+}
+
+static void res_cache_push_front(RES_CACHE_NODE far* node) {
+  node->next = res_cache_head;
+  node->prev = 0;
+  if (res_cache_head) {
+    res_cache_head->prev = node;
+  }
+  else {
+    res_cache_tail = node;
+  }
+  res_cache_head = node;
+}
+
+static void res_cache_drop(RES_CACHE_NODE far* node) {
+  res_cache_unlink(node);
+  res_cache_slot[node->num] = 0;
+  res_cache_counts.bytes -= node->size;
+  res_cache_counts.entries--;
+  farfree(node);
+}
+
+/* Evicts least recently used payloads until `size` more bytes fit. */
+static void res_cache_trim(long size) {
+  while (res_cache_tail &&
+         res_cache_counts.bytes + size > res_cache_counts.budget) {
+    res_cache_drop(res_cache_tail);
+    res_cache_counts.evictions++;
+  }
+}
+
+long res_cache_get(int num, char far* buff) {
+  RES_CACHE_NODE far* node;
+
+  if (res_cache_counts.budget <= 0) {
+    return -1;
+  }
+  node = res_cache_slot[num];
+  if (node && (node->offset != res_header[num].offset ||
+               node->length != res_header[num].length)) {
+    res_cache_drop(node);
+    node = 0;
+  }
+  if (!node) {
+    res_cache_counts.misses++;
+    return -1;
+  }
+  res_cache_counts.hits++;
+  if (node != res_cache_head) {
+    res_cache_unlink(node);
+    res_cache_push_front(node);
+  }
+  _fmemcpy(buff, (char far*)(node + 1), (size_t)node->size);
+  return node->size;
+}
+
+void res_cache_put(int num, const char far* data, long size) {
+  RES_CACHE_NODE far* node;
+
+  if (size <= 0 || size > res_cache_counts.budget) {
+    return;
+  }
+  if (res_cache_slot[num]) {
+    res_cache_drop(res_cache_slot[num]);
+  }
+  res_cache_trim(size);
+  node = (RES_CACHE_NODE far*)farmalloc(sizeof(RES_CACHE_NODE) + size);
+  if (!node) {
+    return;
+  }
+  node->num = num;
+  node->offset = res_header[num].offset;
+  node->length = res_header[num].length;
+  node->size = size;
+  _fmemcpy((char far*)(node + 1), data, (size_t)size);
+  res_cache_push_front(node);
+  res_cache_slot[num] = node;
+  res_cache_counts.bytes += size;
+  res_cache_counts.entries++;
+}
+
+void res_cache_flush(void) {
+  while (res_cache_head) {
+    res_cache_drop(res_cache_head);
+  }
+}
+
+void res_cache_budget(long bytes) {
+  if (bytes < 0) {
+    bytes = 0;
+  }
+  res_cache_counts.budget = bytes;
+  res_cache_trim(0);
+}
+
+void res_cache_stats(RES_CACHE_STATS* stats) {
+  *stats = res_cache_counts;
+}
@@ -2,6 +2,7 @@
 #include <string.h>
 
 #include "res_man.h"
+#include "res_int.h"
 
 int res_delete_file(const char* name) {
   int num;
@@ -17,6 +18,7 @@ int res_delete_file(const char* name) {
   if (num < 0) {
     return RES_ENTRY_NOT_FOUND;
   }
+  res_index_remove(num);
   memset(&res_header[num], 0, sizeof(RES_HEADER));
   res_changed = 1;
   return 1;
@@ -7,6 +7,10 @@ long res_encode(char far* buff, long length) {
   return lzss_compress(length, buff, res_lzss_buff);
 }
 
+long res_encode_best(char far* buff, long length) {
+  return lzss_compress_best(length, buff, res_lzss_buff);
+}
+
 long res_decode(char far* buff, long len) {
   return lzss_decompress(res_lzss_buff, buff, len);
 }
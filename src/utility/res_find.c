@@ -2,8 +2,122 @@
 #include <string.h>
 
 #include "res_man.h"
+#include "res_int.h"
+
+/*
+ * Name index: open addressing with linear probing over a table twice the
+ * size of res_header, so it is never more than half full. A slot holds
+ * the entry number + 1, 0 when free. Removal shifts the rest of the probe
+ * run back instead of leaving tombstones, so churn from add/delete/rename
+ * never lengthens lookups.
+ */
+#define RES_INDEX_SLOTS (RES_MAX_ENTRIES * 2)
+#define RES_INDEX_MASK  (RES_INDEX_SLOTS - 1)
+
+static short res_index[RES_INDEX_SLOTS];
+
+/* Case-folded like strcmpi, over at most the 9 bytes an entry name holds. */
+static unsigned res_index_hash(const char* name) {
+  unsigned h = 0;
+  int i;
+  unsigned char c;
+
+  for (i = 0; i < 9 && name[i]; i++) {
+    c = (unsigned char)name[i];
+    if (c >= 'A' && c <= 'Z') {
+      c += 'a' - 'A';
+    }
+    h = h * 31 + c;
+  }
+  return h ^ (h >> 9);
+}
+
+void res_index_add(int num) {
+  unsigned slot;
+
+  if (!res_header[num].name[0]) {
+    return;
+  }
+  slot = res_index_hash(res_header[num].name) & RES_INDEX_MASK;
+  while (res_index[slot]) {
+    slot = (slot + 1) & RES_INDEX_MASK;
+  }
+  res_index[slot] = (short)(num + 1);
+}
+
+void res_index_remove(int num) {
+  unsigned slot, next, home;
+
+  if (!res_header[num].name[0]) {
+    return;
+  }
+  slot = res_index_hash(res_header[num].name) & RES_INDEX_MASK;
+  while (res_index[slot] != num + 1) {
+    if (!res_index[slot]) {
+      return;
+    }
+    slot = (slot + 1) & RES_INDEX_MASK;
+  }
+
+  /* Pull later members of the run back over the hole when their home
+     slot does not lie cyclically in (slot, next]. */
+  next = slot;
+  while (1) {
+    res_index[slot] = 0;
+    while (1) {
+      next = (next + 1) & RES_INDEX_MASK;
+      if (!res_index[next]) {
+        return;
+      }
+      home = res_index_hash(res_header[res_index[next] - 1].name) & RES_INDEX_MASK;
+      if (((next - home) & RES_INDEX_MASK) >= ((next - slot) & RES_INDEX_MASK)) {
+        break;
+      }
+    }
+    res_index[slot] = res_index[next];
+    slot = next;
+  }
+}
+
+void res_index_build(void) {
+  int i;
+
+  memset(res_index, 0, sizeof(res_index));
+  for (i = 0; i < RES_MAX_ENTRIES; i++) {
+    res_index_add(i);
+  }
+}
 
 int res_find_name(const char* name) {
+  unsigned slot;
+  int num, found;
+
+  if (!res_active) {
+    return RES_NOT_ACTIVE;
+  }
+  if (!res_fp) {
+    return RES_NOT_OPEN;
+  }
+
+  /* Empty entries are not indexed; an empty name matches the first one. */
+  if (!name[0]) {
+    return res_find_name_scan(name);
+  }
+
+  /* Duplicate names resolve to the lowest entry, as the scan did. */
+  found = RES_ENTRY_NOT_FOUND;
+  slot = res_index_hash(name) & RES_INDEX_MASK;
+  while (res_index[slot]) {
+    num = res_index[slot] - 1;
+    if ((found < 0 || num < found) && !strcmpi(name, res_header[num].name)) {
+      found = num;
+    }
+    slot = (slot + 1) & RES_INDEX_MASK;
+  }
+  return found;
+}
+
+int res_find_name_scan(const char* name) {
   int i;
 
   if (!res_active) {
@@ -32,6 +32,10 @@ int res_open(const char* filename) {
     fclose(res_fp);
     return RES_CANT_READ;
   }
+  res_index_build();
+  res_map_open();
+  res_cache_flush();
+  res_prefetch_flush();
   res_changed = 0;
   return 1;
 }
@@ -40,6 +44,9 @@ int res_close(void) {
   if (!res_active) {
     return RES_NOT_ACTIVE;
   }
+  res_prefetch_flush();
+  res_map_close();
+  res_cache_flush();
   if (res_changed) {
     if (fseek(res_fp, 0l, SEEK_SET)) {
       return RES_CANT_SEEK;
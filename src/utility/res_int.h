@@ -13,4 +13,59 @@ int res_rentries(void);
  */
 int res_wentries(void);
 
+/**
+ * Rebuilds the name index @ref res_find_name uses from @ref res_header.
+ * Called whenever the whole entry table is read or rearranged.
+ */
+void res_index_build(void);
+
+/**
+ * Adds entry @ref num to the name index under its current name.
+ * Entries with an empty name are not indexed.
+ */
+void res_index_add(int num);
+
+/**
+ * Removes entry @ref num from the name index. Must be called while the
+ * entry still holds the name it was indexed under.
+ */
+void res_index_remove(int num);
+
+/**
+ * The original linear strcmpi scan over @ref res_header. Returns the same
+ * results as @ref res_find_name; kept as its reference and for benchmarks.
+ */
+int res_find_name_scan(const char* name);
+
+/**
+ * Maps the open @ref res_fp archive into memory (mmap, a file mapping on
+ * Windows, a whole-file load on the web). Leaves the archive unmapped if
+ * that fails, or on DOS; every reader falls back to @ref res_fp then.
+ */
+void res_map_open(void);
+
+/**
+ * Releases the mapping made by @ref res_map_open, if any.
+ */
+void res_map_close(void);
+
+/**
+ * Returns the stored (possibly compressed) bytes of entry @ref num inside
+ * the mapping, or 0 when the archive is not mapped or the entry was
+ * appended after it was.
+ */
+const char far* res_map_entry(int num);
+
+/**
+ * Copies the cached decoded payload of entry @ref num into @ref buff.
+ * @returns The payload size, or -1 on a miss.
+ */
+long res_cache_get(int num, char far* buff);
+
+/**
+ * Caches @ref size decoded bytes of entry @ref num, evicting least recently
+ * used payloads as needed. Payloads larger than the budget are not kept.
+ */
+void res_cache_put(int num, const char far* data, long size);
+
 #endif
@@ -155,6 +155,15 @@ int res_create(const char* filename);
  */
 long res_encode(char far* buff, long length);
 
+/**
+ * Compresses the data in @ref buff using LZSS with the smallest possible
+ * output (see lzss_compress_best). Slower than @ref res_encode.
+ * @param buff A memory location with data to compress.
+ * @param length How many bytes long @ref buff is.
+ * @returns The total number of bytes the compressed size is.
+ */
+long res_encode_best(char far* buff, long length);
+
 /**
  * Decompresses the data in @ref buff with LZSS.
  * @param buff A memory location with data to decompress.
@@ -185,7 +194,8 @@ int res_find_empty(void);
  * @param name The name of the resource.
  * @param buff The memory location with the data for the resource.
  * @param length The total number of bytes of data to write.
- * @param encode_flag 1 when the data should be compressed with LZSS, otherwise 0.
+ * @param encode_flag 1 when the data should be compressed with LZSS, 2 to
+ * compress it as small as possible (@ref res_encode_best), otherwise 0.
  * @returns 1 if the entry was successfully written, otherwise returns an enumeration.
  * Use the `RES_*` constants, or @ref res_error to determine a text description.
  */
@@ -202,6 +212,24 @@ int res_write(const char* name, char far* buff, long length, int encode_flag);
  */
 long res_read(const char* name, char far* buff);
 
+/**
+ * Gets the contents of a resource without copying them when possible.
+ * When the archive is memory-mapped and the entry is stored uncompressed,
+ * @ref data is pointed straight into the mapping: the bytes are read-only
+ * and stay valid until the archive is closed. Otherwise the entry is read
+ * into @ref buff as by @ref res_read (compressed entries decode directly
+ * from the mapping) and @ref data is set to @ref buff.
+ * @param name The name of the resource.
+ * @param buff Where to read the resource if it can't be borrowed, or 0 to
+ * accept only a borrowed view.
+ * @param data Receives a pointer to the resource contents.
+ * @returns When the value is >= 0, the size of the resource, otherwise
+ * returns an enumeration (RES_CANT_READ when @ref buff is 0 and the entry
+ * can't be borrowed). Use the `RES_*` constants, or @ref res_error to
+ * determine a text description.
+ */
+long res_view(const char* name, char far* buff, const char far** data);
+
 /**
  * Allocates a new block of memory the size of the given resource entry,
  * and reads it into the memory block.
@@ -214,7 +242,8 @@ void far* res_falloc_read(const char* name);
  * Adds a file from disk to the resource archive.
  * @param fname The name of the file to read from on disk.
  * @param name The name of the resource entry to create in the archive.
- * @param encode_flag 1 when the data should be compressed with LZSS, otherwise 0.
+ * @param encode_flag 1 when the data should be compressed with LZSS, 2 to
+ * compress it as small as possible (@ref res_encode_best), otherwise 0.
  * @returns Returns 1 upon success, otherwise returns an enumeration.
  * Use the `RES_*` constants, or @ref res_error to determine a text
  * description.
@@ -251,6 +280,25 @@ int res_delete_file(const char* name);
  */
 int res_pack(const char* filename);
 
+/**
+ * Builds a new resource archive from a list of files in one pass. Every
+ * entry is read and encoded up front (on all cores where threads exist),
+ * then written back to back and the entry table written once. Any existing
+ * archive of that name is replaced. Upon success the new archive is opened.
+ * @param filename The resource archive to create.
+ * @param source Either a list file with one `src_filename res_name
+ * [encode_flag]` per line, or a directory whose *.DAT files become
+ * entries named after the file (what the B command of the res tool
+ * extracts).
+ * @param encode_flag The encoding for entries that don't give one, as for
+ * @ref res_add_file.
+ * @param threads Worker threads to encode with, or 0 for one per core.
+ * @returns Returns 1 upon success, otherwise returns an enumeration.
+ * Use the `RES_*` constants, or @ref res_error to determine a text
+ * description.
+ */
+int res_build(const char* filename, const char* source, int encode_flag, int threads);
+
 /**
  * Updates the existing file in the resource archive with the contents on disk.
  * @param fname The name of the file on disk to load from.
@@ -278,6 +326,103 @@ int res_rename_file(const char* oldname, const char* newname);
  */
 char* res_error(int num);
 
+/**
+ * Counters for the decoded-resource cache behind @ref res_read.
+ */
+typedef struct {
+  /**
+   * Reads served from the cache, and reads that had to decode.
+   */
+  long hits;
+  long misses;
+  /**
+   * Payloads dropped to stay within @ref budget.
+   */
+  long evictions;
+  /**
+   * Bytes and payloads currently held.
+   */
+  long bytes;
+  int  entries;
+  /**
+   * The memory budget in bytes; 0 disables the cache.
+   */
+  long budget;
+} RES_CACHE_STATS;
+
+/**
+ * Sets the memory budget of the decoded-resource cache. @ref res_read keeps
+ * the payloads of recently read entries (except stored entries it can copy
+ * straight from the mapped archive) and evicts the least recently used ones
+ * to stay within it. The default is 1 MB natively and 0 (off) on DOS.
+ * @param bytes The budget in bytes; 0 disables the cache and frees it.
+ */
+void res_cache_budget(long bytes);
+
+/**
+ * Frees every cached payload. Opening or closing an archive does this.
+ */
+void res_cache_flush(void);
+
+/**
+ * Copies out the cache counters. They accumulate for the whole run.
+ * @param stats Receives the counters.
+ */
+void res_cache_stats(RES_CACHE_STATS* stats);
+
+/**
+ * Counters for @ref res_prefetch and @ref res_prefetch_read.
+ */
+typedef struct {
+  /**
+   * Reads that found their entry already decoded in the background, and
+   * reads that had to go through @ref res_read.
+   */
+  long hits;
+  long misses;
+  /**
+   * Entries handed to the background decoder.
+   */
+  long queued;
+  /**
+   * Requests ignored because the previous batch was still decoding.
+   */
+  long dropped;
+} RES_PREFETCH_STATS;
+
+/**
+ * Starts decoding the named entries on a background thread, for a later
+ * @ref res_prefetch_read. Entries from an earlier call that are not named
+ * again are dropped. Does nothing while the previous batch is still being
+ * decoded, when the archive is not mapped, or where there are no threads
+ * (DOS, the web).
+ * @param names The entries to decode; unknown names are skipped.
+ * @param count The number of names.
+ * @returns The number of entries queued.
+ */
+int res_prefetch(const char* const* names, int count);
+
+/**
+ * As @ref res_read, but takes the payload from @ref res_prefetch when it
+ * has been decoded already.
+ * @param name The name of the resource to read.
+ * @param buff The memory buffer to receive the decoded payload.
+ * @returns The payload size, otherwise an enumeration.
+ */
+long res_prefetch_read(const char* name, char far* buff);
+
+/**
+ * Waits for the background decoder and frees every prefetched payload.
+ * Opening or closing an archive does this.
+ */
+void res_prefetch_flush(void);
+
+/**
+ * Copies out the prefetch counters. They accumulate for the whole run.
+ * @param stats Receives the counters.
+ */
+void res_prefetch_stats(RES_PREFETCH_STATS* stats);
+
 // TODO these are not actively being used in the codebase.
 // long res_read_element(const char* name, char far* buff, long offset, long size);
 // long res_length(char *name);
@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "modern.h"
+
+#ifdef modern
+#if defined(__EMSCRIPTEN__)
+/* The web build's files live in memory already; just load the archive. */
+#elif defined(_WIN32)
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#endif
+
+#include "res_man.h"
+#include "res_int.h"
+
+#ifdef modern
+
+static char* res_map_base;
+static long res_map_size;
+#if defined(_WIN32) && !defined(__EMSCRIPTEN__)
+static HANDLE res_map_handle;
+#endif
+
+void res_map_open(void) {
+  long size;
+
+  res_map_close();
+  if (fseek(res_fp, 0l, SEEK_END)) {
+    return;
+  }
+  size = ftell(res_fp);
+  if (size <= 0) {
+    return;
+  }
+
+#if defined(__EMSCRIPTEN__)
+  res_map_base = (char*)malloc((size_t)size);
+  if (!res_map_base) {
+    return;
+  }
+  if (fseek(res_fp, 0l, SEEK_SET) ||
+      fread(res_map_base, 1, (size_t)size, res_fp) != (size_t)size) {
+    free(res_map_base);
+    res_map_base = 0;
+    return;
+  }
+#elif defined(_WIN32)
+  res_map_handle = CreateFileMappingA((HANDLE)_get_osfhandle(_fileno(res_fp)),
+                                      NULL, PAGE_READONLY, 0, 0, NULL);
+  if (!res_map_handle) {
+    return;
+  }
+  res_map_base = (char*)MapViewOfFile(res_map_handle, FILE_MAP_READ, 0, 0,
+                                      (SIZE_T)size);
+  if (!res_map_base) {
+    CloseHandle(res_map_handle);
+    res_map_handle = 0;
+    return;
+  }
+#else
+  {
+    void* p = mmap(NULL, (size_t)size, PROT_READ, MAP_PRIVATE, fileno(res_fp), 0);
+    if (p == MAP_FAILED) {
+      return;
+    }
+    res_map_base = (char*)p;
+  }
+#endif
+  res_map_size = size;
+}
+
+void res_map_close(void) {
+  if (!res_map_base) {
+    return;
+  }
+#if defined(__EMSCRIPTEN__)
+  free(res_map_base);
+#elif defined(_WIN32)
+  UnmapViewOfFile(res_map_base);
+  CloseHandle(res_map_handle);
+  res_map_handle = 0;
+#else
+  munmap(res_map_base, (size_t)res_map_size);
+#endif
+  res_map_base = 0;
+  res_map_size = 0;
+}
+
+const char far* res_map_entry(int num) {
+  /* Entries appended since the archive was mapped lie past its end. */
+  if (!res_map_base ||
+      res_header[num].offset > (uint32_t)res_map_size ||
+      res_header[num].length > (uint32_t)res_map_size - res_header[num].offset) {
+    return 0;
+  }
+  return res_map_base + res_header[num].offset;
+}
+
+#else
+
+void res_map_open(void) {
+}
+
+void res_map_close(void) {
+}
+
+const char far* res_map_entry(int num) {
+  num = num;
+  return 0;
+}
+
+#endif
@@ -10,6 +10,7 @@
 #endif
 
 #include "res_man.h"
+#include "res_int.h"
 
 int res_pack(const char* filename) {
   int  num, new_num, nb;
@@ -77,6 +78,7 @@ int res_pack(const char* filename) {
     memset(&res_header[new_num], 0, sizeof(RES_HEADER));
     new_num++;
   }
+  res_index_build();
   res_encrypt((char far*)&res_header, RES_MAX_ENTRIES * sizeof(RES_HEADER), 128);
 
   fseek(fp, 0l, SEEK_SET);
@@ -86,6 +88,8 @@ int res_pack(const char* filename) {
     return RES_CANT_WRITE;
   }
   fclose(fp);
+  res_prefetch_flush();
+  res_map_close();
   fclose(res_fp);
   unlink(filename);
   rename("res_@@@@.tmp", filename);
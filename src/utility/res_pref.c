@@ -0,0 +1,277 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "modern.h"
+
+#ifndef modern
+#include <alloc.h>
+#endif
+
+// Background decoding needs threads and the mapped archive; elsewhere
+// res_prefetch() does nothing and res_prefetch_read() is res_read().
+#if defined(modern) && !defined(__EMSCRIPTEN__)
+#define RES_PREFETCH_THREAD 1
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+#endif
+
+#include "res_man.h"
+#include "res_int.h"
+#include "lzss.h"
+
+static RES_PREFETCH_STATS res_prefetch_counts;
+
+#ifdef RES_PREFETCH_THREAD
+
+#if defined(__GNUC__) || defined(__clang__)
+#define PF_LOAD(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define PF_STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#else
+#define PF_LOAD(p) ((long)InterlockedOr((volatile LONG*)(p), 0))
+#define PF_STORE(p, v) InterlockedExchange((volatile LONG*)(p), (LONG)(v))
+#endif
+
+#define RES_PREFETCH_SLOTS 32
+
+/*
+ * A slot is set up on the game thread (entry, source bytes in the mapping,
+ * output buffer), decoded by the worker, which then sets ready. The game
+ * thread only touches a slot's data once ready is set, and only reassigns
+ * slots while no worker is running.
+ */
+typedef struct {
+  int num;
+  uint32_t offset;
+  uint32_t length;
+  uint16_t key;
+  long size;
+  const char far* src;
+  char far* data;
+  volatile long ready;
+} RES_PREFETCH_SLOT;
+
+static RES_PREFETCH_SLOT res_prefetch_slot[RES_PREFETCH_SLOTS];
+static int res_prefetch_inited;
+static volatile long res_prefetch_busy;
+static int res_prefetch_started;
+#ifdef _WIN32
+static HANDLE res_prefetch_th;
+#else
+static pthread_t res_prefetch_th;
+#endif
+
+static void res_prefetch_init(void) {
+  int i;
+
+  if (res_prefetch_inited) {
+    return;
+  }
+  for (i = 0; i < RES_PREFETCH_SLOTS; i++) {
+    res_prefetch_slot[i].num = -1;
+  }
+  res_prefetch_inited = 1;
+}
+
+static void res_prefetch_decode(RES_PREFETCH_SLOT* s) {
+  if (!s->key) {
+    memcpy(s->data, s->src, (size_t)s->size);
+  }
+  else if (s->length < 4 ||
+           lzss_decode(s->src + 4, (long)s->length - 4, s->data, s->size) != s->size) {
+    // Leave it to res_read() to deal with.
+    return;
+  }
+  PF_STORE(&s->ready, 1);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI res_prefetch_worker(LPVOID arg)
+#else
+static void* res_prefetch_worker(void* arg)
+#endif
+{
+  int i;
+
+  (void)arg;
+  for (i = 0; i < RES_PREFETCH_SLOTS; i++) {
+    if (res_prefetch_slot[i].num >= 0 && !PF_LOAD(&res_prefetch_slot[i].ready)) {
+      res_prefetch_decode(&res_prefetch_slot[i]);
+    }
+  }
+  PF_STORE(&res_prefetch_busy, 0);
+  return 0;
+}
+
+// Waits for the worker, if one was started, and reaps it.
+static void res_prefetch_join(void) {
+  if (!res_prefetch_started) {
+    return;
+  }
+#ifdef _WIN32
+  WaitForSingleObject(res_prefetch_th, INFINITE);
+  CloseHandle(res_prefetch_th);
+#else
+  pthread_join(res_prefetch_th, NULL);
+#endif
+  res_prefetch_started = 0;
+}
+
+static void res_prefetch_free(RES_PREFETCH_SLOT* s) {
+  if (s->data) {
+    farfree(s->data);
+  }
+  s->num = -1;
+  s->data = 0;
+  s->ready = 0;
+}
+
+static int res_prefetch_matches(const RES_PREFETCH_SLOT* s, int num) {
+  return s->num == num && s->offset == res_header[num].offset &&
+         s->length == res_header[num].length;
+}
+
+int res_prefetch(const char* const* names, int count) {
+  char wanted[RES_MAX_ENTRIES];
+  int  i, num, queued;
+  RES_PREFETCH_SLOT* s;
+
+  if (!res_active || !res_fp) {
+    return 0;
+  }
+  res_prefetch_init();
+  if (PF_LOAD(&res_prefetch_busy)) {
+    res_prefetch_counts.dropped++;
+    return 0;
+  }
+  res_prefetch_join();
+
+  memset(wanted, 0, sizeof(wanted));
+  for (i = 0; i < count; i++) {
+    num = res_find_name(names[i]);
+    if (num >= 0) {
+      wanted[num] = 1;
+    }
+  }
+  // Keep what is still wanted (and still current), free the rest.
+  for (i = 0; i < RES_PREFETCH_SLOTS; i++) {
+    s = &res_prefetch_slot[i];
+    if (s->num < 0) {
+      continue;
+    }
+    if (wanted[s->num] && res_prefetch_matches(s, s->num) && s->ready) {
+      wanted[s->num] = 0;
+    }
+    else {
+      res_prefetch_free(s);
+    }
+  }
+
+  queued = 0;
+  s = res_prefetch_slot;
+  for (num = 0; num < RES_MAX_ENTRIES; num++) {
+    if (!wanted[num]) {
+      continue;
+    }
+    while (s < res_prefetch_slot + RES_PREFETCH_SLOTS && s->num >= 0) {
+      s++;
+    }
+    if (s == res_prefetch_slot + RES_PREFETCH_SLOTS) {
+      break;
+    }
+    s->src = res_map_entry(num);
+    if (!s->src || !res_header[num].original_size) {
+      continue;
+    }
+    s->data = farmalloc(res_header[num].original_size);
+    if (!s->data) {
+      break;
+    }
+    s->num = num;
+    s->offset = res_header[num].offset;
+    s->length = res_header[num].length;
+    s->key = res_header[num].key;
+    s->size = (long)res_header[num].original_size;
+    s->ready = 0;
+    queued++;
+  }
+  if (!queued) {
+    return 0;
+  }
+
+  PF_STORE(&res_prefetch_busy, 1);
+#ifdef _WIN32
+  res_prefetch_th = CreateThread(NULL, 0, res_prefetch_worker, NULL, 0, NULL);
+  res_prefetch_started = res_prefetch_th != NULL;
+#else
+  res_prefetch_started =
+      pthread_create(&res_prefetch_th, NULL, res_prefetch_worker, NULL) == 0;
+#endif
+  if (!res_prefetch_started) {
+    PF_STORE(&res_prefetch_busy, 0);
+    for (i = 0; i < RES_PREFETCH_SLOTS; i++) {
+      if (!res_prefetch_slot[i].ready) {
+        res_prefetch_free(&res_prefetch_slot[i]);
+      }
+    }
+    return 0;
+  }
+  res_prefetch_counts.queued += queued;
+  return queued;
+}
+
+long res_prefetch_read(const char* name, char far* buff) {
+  int i, num;
+  RES_PREFETCH_SLOT* s;
+
+  if (res_active && res_fp && res_prefetch_inited) {
+    num = res_find_name(name);
+    for (i = 0; num >= 0 && i < RES_PREFETCH_SLOTS; i++) {
+      s = &res_prefetch_slot[i];
+      if (res_prefetch_matches(s, num) && PF_LOAD(&s->ready)) {
+        memcpy(buff, s->data, (size_t)s->size);
+        res_prefetch_counts.hits++;
+        return s->size;
+      }
+    }
+  }
+  res_prefetch_counts.misses++;
+  return res_read(name, buff);
+}
+
+void res_prefetch_flush(void) {
+  int i;
+
+  if (!res_prefetch_inited) {
+    return;
+  }
+  res_prefetch_join();
+  for (i = 0; i < RES_PREFETCH_SLOTS; i++) {
+    res_prefetch_free(&res_prefetch_slot[i]);
+  }
+}
+
+#else
+
+int res_prefetch(const char* const* names, int count) {
+  (void)names;
+  (void)count;
+  return 0;
+}
+
+long res_prefetch_read(const char* name, char far* buff) {
+  res_prefetch_counts.misses++;
+  return res_read(name, buff);
+}
+
+void res_prefetch_flush(void) {
+}
+
+#endif
+
+void res_prefetch_stats(RES_PREFETCH_STATS* stats) {
+  *stats = res_prefetch_counts;
+}
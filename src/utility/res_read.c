@@ -4,6 +4,8 @@
 #include <dos.h>
 
 #include "res_man.h"
+#include "res_int.h"
+#include "lzss.h"
 
 long res_read(const char* name, char far* buff) {
   int num, bytes;
@@ -11,6 +13,7 @@ long res_read(const char* name, char far* buff) {
   size_t total;
   char bf[256];
   char far* p;
+  const char far* src;
 
   if (!res_active) {
     return RES_NOT_ACTIVE;
@@ -24,6 +27,26 @@ long res_read(const char* name, char far* buff) {
     return RES_CANT_FIND;
   }
 
+  /* Stored entries in the mapped archive are a single copy. Anything else
+     comes from the decoded cache, or decodes straight from the mapping. */
+  #ifdef modern
+  src = res_map_entry(num);
+  if (src && !res_header[num].key) {
+    memcpy(buff, src, (size_t)res_header[num].length);
+    return res_header[num].original_size;
+  }
+  #endif
+  if (res_cache_get(num, buff) >= 0) {
+    return res_header[num].original_size;
+  }
+  #ifdef modern
+  if (src) {
+    lzss_decompress((char far*)src, buff, (long)res_header[num].length);
+    res_cache_put(num, buff, res_header[num].original_size);
+    return res_header[num].original_size;
+  }
+  #endif
+
   if (fseek(res_fp, res_header[num].offset, SEEK_SET)) {
     return RES_CANT_SEEK;
   }
@@ -56,5 +79,36 @@ long res_read(const char* name, char far* buff) {
   if (res_header[num].key) {
     res_decode(buff, len);
   }
+  if (total == len) {
+    res_cache_put(num, buff, res_header[num].original_size);
+  }
   return res_header[num].original_size;
 }
+
+long res_view(const char* name, char far* buff, const char far** data) {
+  int num;
+  const char far* src;
+
+  if (!res_active) {
+    return RES_NOT_ACTIVE;
+  }
+  if (!res_fp) {
+    return RES_NOT_OPEN;
+  }
+
+  num = res_find_name(name);
+  if (num < 0) {
+    return RES_CANT_FIND;
+  }
+
+  src = res_map_entry(num);
+  if (src && !res_header[num].key) {
+    *data = src;
+    return res_header[num].original_size;
+  }
+  if (!buff) {
+    return RES_CANT_READ;
+  }
+  *data = buff;
+  return res_read(name, buff);
+}
@@ -2,6 +2,7 @@
 #include <string.h>
 
 #include "res_man.h"
+#include "res_int.h"
 
 int res_rename_file(const char* oldname, const char* newname) {
   int num;
@@ -11,8 +12,10 @@ int res_rename_file(const char* oldname, const char* newname) {
     return RES_ENTRY_NOT_FOUND;
   }
 
+  res_index_remove(num);
   memset(res_header[num].name, 0, 9);
   strcpy(res_header[num].name, newname);
+  res_index_add(num);
   res_changed = 1;
   return 1;
 }
@@ -4,6 +4,7 @@
 #include <dos.h>
 
 #include "res_man.h"
+#include "res_int.h"
 
 int res_write(const char* name, char far* buff, long length, int encode_flag) {
   int num;
@@ -35,7 +36,7 @@ int res_write(const char* name, char far* buff, long length, int encode_flag) {
 
   if (encode_flag) {
     res_header[num].key = 1;
-    size = res_encode(buff, length);
+    size = (encode_flag == 2) ? res_encode_best(buff, length) : res_encode(buff, length);
     p = res_lzss_buff;
   }
   else {
@@ -43,7 +44,9 @@ int res_write(const char* name, char far* buff, long length, int encode_flag) {
     size = length;
     p = buff;
   }
+  res_index_remove(num);
   strncpy(res_header[num].name, name, 9);
+  res_index_add(num);
   res_header[num].length = size;
   res_header[num].original_size = length;
 